@@ -0,0 +1,72 @@
+// cint.c
+// controlador de interrupções dos terminais
+// simulador de computador
+// so24b
+
+#include "cint.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+// as interrupções controladas, na ordem dos dispositivos
+static irq_t irqs[] = { IRQ_TECLADO, IRQ_TELA };
+#define N_CINT_IRQ (sizeof(irqs) / sizeof(irqs[0]))
+
+struct cint_t {
+  // para cada interrupção, os terminais com pedido pendente (um bit cada)
+  int pendentes[N_CINT_IRQ];
+};
+
+cint_t *cint_cria(void)
+{
+  cint_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+
+  for (int i = 0; i < N_CINT_IRQ; i++) {
+    self->pendentes[i] = 0;
+  }
+
+  return self;
+}
+
+void cint_destroi(cint_t *self)
+{
+  free(self);
+}
+
+void cint_pede(cint_t *self, irq_t irq, int terminal)
+{
+  for (int i = 0; i < N_CINT_IRQ; i++) {
+    if (irqs[i] == irq) {
+      self->pendentes[i] |= 1 << terminal;
+      return;
+    }
+  }
+}
+
+bool cint_pendente(cint_t *self, irq_t *pirq)
+{
+  for (int i = 0; i < N_CINT_IRQ; i++) {
+    if (self->pendentes[i] != 0) {
+      *pirq = irqs[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+err_t cint_leitura(void *disp, int id, int *pvalor)
+{
+  cint_t *self = disp;
+  if (id < 0 || id >= N_CINT_IRQ) return ERR_DISP_INV;
+  *pvalor = self->pendentes[id];
+  return ERR_OK;
+}
+
+err_t cint_escrita(void *disp, int id, int valor)
+{
+  cint_t *self = disp;
+  if (id < 0 || id >= N_CINT_IRQ) return ERR_DISP_INV;
+  self->pendentes[id] &= ~valor;
+  return ERR_OK;
+}
@@ -0,0 +1,53 @@
+// cint.h
+// controlador de interrupções dos terminais
+// simulador de computador
+// so24b
+
+#ifndef CINT_H
+#define CINT_H
+
+// simulação de um controlador de interrupções
+//
+// os terminais avisam o controlador quando algo que interessa ao SO acontece:
+// - o teclado passou a ter caractere disponível (IRQ_TECLADO)
+// - a tela terminou de rolar ou de limpar e aceita caracteres (IRQ_TELA)
+// o controlador guarda, para cada uma dessas IRQ, quais terminais pediram a
+//   interrupção (um bit por terminal, o bit 0 é o terminal A), até que o SO
+//   reconheça o pedido
+// a unidade de controle pergunta ao controlador se tem interrupção pendente,
+//   e pede para a CPU atender
+//
+// implementa 2 dispositivos, acessados pelo controlador de E/S:
+// - 0: terminais com IRQ_TECLADO pendente
+// - 1: terminais com IRQ_TELA pendente
+// a leitura retorna os bits dos terminais com pedido pendente; a escrita
+//   reconhece os pedidos dos terminais com bit 1 no valor escrito (que deixam
+//   de estar pendentes)
+
+#include "err.h"
+#include "irq.h"
+
+#include <stdbool.h>
+
+typedef struct cint_t cint_t;
+
+// aloca e inicializa um controlador de interrupções, sem pedido pendente
+cint_t *cint_cria(void);
+// libera a memória ocupada pelo controlador
+void cint_destroi(cint_t *self);
+
+// registra um pedido da interrupção 'irq' (IRQ_TECLADO ou IRQ_TELA) pelo
+//   terminal 'terminal' (0 para o A)
+void cint_pede(cint_t *self, irq_t irq, int terminal);
+
+// retorna true se tem interrupção com pedido não reconhecido, e coloca qual
+//   em '*pirq'
+bool cint_pendente(cint_t *self, irq_t *pirq);
+
+// Funções para implementar o protocolo de acesso a um dispositivo pelo
+//   controlador de E/S
+// Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h
+err_t cint_leitura(void *disp, int id, int *pvalor);
+err_t cint_escrita(void *disp, int id, int valor);
+
+#endif // CINT_H
@@ -8,6 +8,7 @@
 #include "console.h"
 #include "terminal.h"
 #include "tela.h"
+#include "log.h"
 
 #include <string.h>
 #include <stdarg.h>
@@ -50,16 +51,15 @@ struct console_t {
   char txt_entrada[N_COL+1];
   char fila_de_comandos_externos[N_CMD_EXT];
   FILE *arquivo_de_log;
+  int nivel_log;
 };
 
 // CRIAÇÃO {{{1
 
-static console_t *console_global; // gambiarra para simplificar o uso de prints na console
 console_t *console_cria(void)
 {
   console_t *self = malloc(sizeof(*self));
   assert(self != NULL);
-  console_global = self;
 
   for (int t = 0; t < N_TERM; t++) {
     self->term[t] = terminal_cria(N_COL);
@@ -77,6 +77,7 @@ console_t *console_cria(void)
   strcpy(self->txt_entrada, "");
   self->fila_de_comandos_externos[0] = '\0';
   self->arquivo_de_log = fopen("log_da_console", "w");
+  self->nivel_log = LOG_RASTRO;
 
   tela_init();
 
@@ -124,7 +125,7 @@ static void insere_string_no_terminal(console_t *self, char id_terminal, char *s
   // insere caracteres no terminal (e espaço no final)
   terminal_t *terminal = console_terminal(self, id_terminal);
   if (terminal == NULL) {
-    console_printf("Terminal '%c' inválido\n", id_terminal);
+    console_printf(self, "Terminal '%c' inválido\n", id_terminal);
     return;
   }
   char *p = str;
@@ -139,7 +140,7 @@ static void limpa_saida_do_terminal(console_t *self, char id_terminal)
 {
   terminal_t *terminal = console_terminal(self, id_terminal);
   if (terminal == NULL) {
-    console_printf("Terminal '%c' inválido\n", id_terminal);
+    console_printf(self, "Terminal '%c' inválido\n", id_terminal);
     return;
   }
   terminal_limpa_saida(terminal);
@@ -181,12 +182,11 @@ void console_print_status(console_t *self, char *txt)
   sprintf(self->txt_status, "%-*s", N_COL, txt);
 }
 
-int console_printf(char *formato, ...)
+int console_printf(console_t *self, char *formato, ...)
 {
   // esta função usa número variável de argumentos, como o printf.
   // Se não sabe como é isso, dá uma olhada em:
   // https://www.geeksforgeeks.org/variadic-functions-in-c/
-  console_t *self = console_global; // gambiarra para simplificar o uso de prints na console
   char s[sizeof(self->txt_console)];
   va_list arg;
   va_start(arg, formato);
@@ -195,6 +195,16 @@ int console_printf(char *formato, ...)
   return r;
 }
 
+void console_define_nivel_log(console_t *self, int nivel)
+{
+  self->nivel_log = nivel;
+}
+
+int console_nivel_log(console_t *self)
+{
+  return self->nivel_log;
+}
+
 // ENTRADA {{{1
 
 static void insere_comando_externo(console_t *self, char c)
@@ -229,7 +239,7 @@ static void interpreta_linha_entrada(console_t *self)
   // F     fim da simulação
 
   char *linha = self->txt_entrada;
-  console_printf("CMD: '%s'", linha);
+  console_printf(self, "CMD: '%s'", linha);
   char cmd = toupper(linha[0]);
   int val;
   switch (cmd) {
@@ -250,7 +260,7 @@ static void interpreta_linha_entrada(console_t *self)
       insere_comando_externo(self, cmd);
       break;
     default:
-      console_printf("Comando '%c' não reconhecido", cmd);
+      console_printf(self, "Comando '%c' não reconhecido", cmd);
   }
   strcpy(self->txt_entrada, "");
 }
@@ -18,7 +18,13 @@ console_t *console_cria(void);
 void console_destroi(console_t *self);
 
 // imprime na área geral do console
-int console_printf(char *fmt, ...);
+int console_printf(console_t *self, char *fmt, ...);
+
+// define o nível de detalhe das mensagens de log mostradas (ver log.h)
+void console_define_nivel_log(console_t *self, int nivel);
+
+// retorna o nível de detalhe das mensagens de log mostradas
+int console_nivel_log(console_t *self);
 
 // imprime na linha de status
 void console_print_status(console_t *self, char *txt);
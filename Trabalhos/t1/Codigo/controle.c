@@ -4,6 +4,7 @@
 // so24b
 
 #include "controle.h"
+#include "log.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -14,6 +15,7 @@ struct controle_t {
   cpu_t *cpu;
   relogio_t *relogio;
   console_t *console;
+  cint_t *cint;
   enum { executando, passo, parado, fim } estado;
 };
 
@@ -22,7 +24,8 @@ static void controle_processa_comandos_da_console(controle_t *self);
 static void controle_atualiza_estado_na_console(controle_t *self);
 
 
-controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio)
+controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio,
+                          cint_t *cint)
 {
   controle_t *self = malloc(sizeof(*self));
   assert(self != NULL);
@@ -30,6 +33,7 @@ controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio)
   self->cpu = cpu;
   self->console = console;
   self->relogio = relogio;
+  self->cint = cint;
   self->estado = parado;
 
   return self;
@@ -50,13 +54,20 @@ void controle_laco(controle_t *self)
 
       if (self->estado == passo) self->estado = parado;
 
-      // enquanto não tem controlador de interrupção, fala direto com o relógio
+      // o relógio não passa pelo controlador de interrupções
       // o dispositivo 3 do relógio contém 1 se o timer expirou
       int tem_int;
       relogio_leitura(self->relogio, 3, &tem_int);
       if (tem_int != 0) {
         cpu_interrompe(self->cpu, IRQ_RELOGIO);
       }
+      // as interrupções dos terminais vêm do controlador de interrupções
+      // se a CPU não aceitar agora (já está atendendo outra), o pedido
+      //   continua pendente até o SO reconhecer
+      irq_t irq;
+      if (cint_pendente(self->cint, &irq)) {
+        cpu_interrompe(self->cpu, irq);
+      }
     }
     console_tictac(self->console);
 
@@ -64,8 +75,8 @@ void controle_laco(controle_t *self)
     controle_atualiza_estado_na_console(self);
   } while (self->estado != fim);
 
-  console_printf("Fim da execução.");
-  console_printf("relógio: %d\n", relogio_agora(self->relogio));
+  log_info(self->console, "Fim da execução.");
+  log_info(self->console, "relógio: %d\n", relogio_agora(self->relogio));
 }
  
 
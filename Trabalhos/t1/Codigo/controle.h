@@ -11,8 +11,10 @@ typedef struct controle_t controle_t;
 #include "cpu.h"
 #include "console.h"
 #include "relogio.h"
+#include "cint.h"
 
-controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio);
+controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio,
+                          cint_t *cint);
 void controle_destroi(controle_t *self);
 
 // o laço principal da simulação
@@ -33,6 +33,10 @@ struct cpu_t {
   // função e argumento para implementar instrução CHAMAC
   func_chamaC_t funcaoC;
   void *argC;
+  // onde o estado é salvo nas interrupções, e o banco de registradores de
+  //   sombra
+  cpu_salvamento_t salvamento;
+  cpu_estado_t banco;
 };
 
 // CRIAÇÃO {{{1
@@ -52,6 +56,8 @@ cpu_t *cpu_cria(mem_t *mem, es_t *es)
   self->complemento = 0;
   self->modo = usuario;
   self->funcaoC = NULL;
+  self->salvamento = CPU_SALVA_NA_MEMORIA;
+  memset(&self->banco, 0, sizeof(self->banco));
   // inicializa instruções privilegiadas
   memset(self->privilegiadas, 0, sizeof(self->privilegiadas));
   self->privilegiadas[PARA] = true;
@@ -77,6 +83,31 @@ void cpu_define_chamaC(cpu_t *self, func_chamaC_t funcaoC, void *argC)
   self->argC = argC;
 }
 
+// copia o estado salvo na memória para o banco, ou vice-versa
+static void copia_da_memoria(cpu_t *self, cpu_estado_t *estado);
+static void copia_para_memoria(cpu_t *self, cpu_estado_t *estado);
+
+void cpu_define_salvamento(cpu_t *self, cpu_salvamento_t onde)
+{
+  if (onde == self->salvamento) return;
+  // os acessos à memória alteram o erro, que não pode mudar aqui
+  err_t erro = self->erro;
+  int complemento = self->complemento;
+  if (onde == CPU_SALVA_NO_BANCO) {
+    copia_da_memoria(self, &self->banco);
+  } else {
+    copia_para_memoria(self, &self->banco);
+  }
+  self->erro = erro;
+  self->complemento = complemento;
+  self->salvamento = onde;
+}
+
+cpu_estado_t *cpu_estado_salvo(cpu_t *self)
+{
+  return &self->banco;
+}
+
 // IMPRESSÃO {{{1
 static void imprime_registradores(cpu_t *self, char *str)
 {
@@ -497,13 +528,21 @@ bool cpu_interrompe(cpu_t *self, irq_t irq)
   //   acesso (para quando existir proteção de memória)
   self->modo = supervisor;
 
-  // esta é uma CPU boazinha, salva todo o estado interno da CPU no início da memória
-  poe_mem(self, IRQ_END_PC,          self->PC);
-  poe_mem(self, IRQ_END_A,           self->A);
-  poe_mem(self, IRQ_END_X,           self->X);
-  poe_mem(self, IRQ_END_erro,        self->erro);
-  poe_mem(self, IRQ_END_complemento, self->complemento);
-  poe_mem(self, IRQ_END_modo,        usuario);
+  // esta é uma CPU boazinha, salva todo o estado interno da CPU no início da
+  //   memória ou no banco de sombra
+  cpu_estado_t estado = {
+    .PC = self->PC,
+    .A = self->A,
+    .X = self->X,
+    .erro = self->erro,
+    .complemento = self->complemento,
+    .modo = usuario,
+  };
+  if (self->salvamento == CPU_SALVA_NO_BANCO) {
+    self->banco = estado;
+  } else {
+    copia_para_memoria(self, &estado);
+  }
 
   // altera o estado da CPU para ela poder executar o tratador de interrupção
   // vai iniciar o tratamento da interrupção no endereço IRQ_END_TRATADOR,
@@ -522,16 +561,39 @@ static void cpu_desinterrompe(cpu_t *self)
   // a interrupção retornou
   // recupera o estado da CPU, para que volte a executar o que foi interrompido
   //   quando a interrupção foi atendida
-  pega_mem(self, IRQ_END_PC,          &self->PC);
-  pega_mem(self, IRQ_END_A,           &self->A);
-  pega_mem(self, IRQ_END_X,           &self->X);
-  // não dá para pegar o erro nem o modo diretamente porque eles não são int
-  int dado;
-  pega_mem(self, IRQ_END_erro,        &dado);
-  self->erro = dado;
-  pega_mem(self, IRQ_END_complemento, &self->complemento);
-  pega_mem(self, IRQ_END_modo,        &dado);
-  self->modo = dado;
+  cpu_estado_t estado;
+  if (self->salvamento == CPU_SALVA_NO_BANCO) {
+    estado = self->banco;
+  } else {
+    copia_da_memoria(self, &estado);
+  }
+  self->PC = estado.PC;
+  self->A = estado.A;
+  self->X = estado.X;
+  self->complemento = estado.complemento;
+  self->modo = estado.modo;
+  // coloca o erro por último, porque pode ser alterado por pega_mem
+  self->erro = estado.erro;
+}
+
+static void copia_da_memoria(cpu_t *self, cpu_estado_t *estado)
+{
+  pega_mem(self, IRQ_END_PC,          &estado->PC);
+  pega_mem(self, IRQ_END_A,           &estado->A);
+  pega_mem(self, IRQ_END_X,           &estado->X);
+  pega_mem(self, IRQ_END_erro,        &estado->erro);
+  pega_mem(self, IRQ_END_complemento, &estado->complemento);
+  pega_mem(self, IRQ_END_modo,        &estado->modo);
+}
+
+static void copia_para_memoria(cpu_t *self, cpu_estado_t *estado)
+{
+  poe_mem(self, IRQ_END_PC,          estado->PC);
+  poe_mem(self, IRQ_END_A,           estado->A);
+  poe_mem(self, IRQ_END_X,           estado->X);
+  poe_mem(self, IRQ_END_erro,        estado->erro);
+  poe_mem(self, IRQ_END_complemento, estado->complemento);
+  poe_mem(self, IRQ_END_modo,        estado->modo);
 }
 
 // vim: foldmethod=marker
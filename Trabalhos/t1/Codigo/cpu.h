@@ -16,6 +16,23 @@ typedef struct cpu_t cpu_t; // tipo opaco
 // os modos de execução da CPU -- normalmente seria interno a CPU.c, mas o SO vai precisar disso
 typedef enum { supervisor, usuario } cpu_modo_t;
 
+// o estado da CPU que é salvo quando ela aceita uma interrupção, e recuperado
+//   quando ela retorna (instrução RETI)
+typedef struct {
+  int PC;
+  int A;
+  int X;
+  int erro;
+  int complemento;
+  int modo;
+} cpu_estado_t;
+
+// onde a CPU salva o estado em uma interrupção
+typedef enum {
+  CPU_SALVA_NA_MEMORIA, // nos endereços IRQ_END_* da memória (o inicial)
+  CPU_SALVA_NO_BANCO,   // no banco de registradores de sombra da CPU
+} cpu_salvamento_t;
+
 // tipo da função a ser chamada quando executar a instrução CHAMAC
 typedef int (*func_chamaC_t)(void *argC, int reg_A);
 
@@ -34,12 +51,24 @@ void cpu_destroi(cpu_t *self);
 void cpu_executa_1(cpu_t *self);
 
 // implementa uma interrupção
-// passa para modo supervisor, salva o estado da CPU no início da memória,
+// passa para modo supervisor, salva o estado da CPU no início da memória (ou
+//   no banco de registradores de sombra, ver cpu_define_salvamento),
 //   altera A para identificar a requisição de interrupção, altera PC para
 //   o endereço do tratador de interrupção
 // retorna true se interrupção foi aceita ou false caso contrário
 bool cpu_interrompe(cpu_t *self, irq_t irq);
 
+// define onde a CPU salva o estado nas interrupções e de onde recupera no
+//   retorno; o estado que já está salvo é copiado para o novo lugar
+void cpu_define_salvamento(cpu_t *self, cpu_salvamento_t onde);
+
+// retorna o banco de registradores de sombra, com o estado salvo na última
+//   interrupção; o que for alterado nele é o que a CPU recupera no retorno
+// só vale quando a CPU salva no banco (CPU_SALVA_NO_BANCO); com isso, o SO
+//   troca o contexto de um processo com uma cópia de struct, sem acessar a
+//   memória
+cpu_estado_t *cpu_estado_salvo(cpu_t *self);
+
 // define a função a chamar quando executar a instrução CHAMAC
 // e o argumento a passar para ela (normalmente, um ponteiro para o SO)
 void cpu_define_chamaC(cpu_t *self, func_chamaC_t func, void *argC);
@@ -6,6 +6,7 @@
 ; chamadas de sistema (ver so.h)
 SO_LE          define 1
 SO_ESCR        define 2
+SO_ESCR_STR    define 10
 SO_CRIA_PROC   define 7
 SO_MATA_PROC   define 8
 SO_ESPERA_PROC define 9
@@ -67,15 +68,12 @@ msg_fim  string 'init terminando...'
 nao_morri string 'nao morri! '
 
 ; imprime a string que inicia em A (destroi X)
+; retorna em A o número de caracteres impressos ou o código de erro do SO
 impstr   espaco 1
          TRAX
-impstr1
-         CARGX 0
-         DESVZ impstrf
-         CHAMA impch
-         INCX
-         DESV impstr1
-impstrf  RET impstr
+         CARGI SO_ESCR_STR
+         CHAMAS
+         RET impstr
 
 ; função que chama o SO para imprimir o caractere em A
 ; retorna em A o código de erro do SO
@@ -14,7 +14,7 @@ typedef enum {
   IRQ_SISTEMA,       // chamada de sistema
   // interrupções geradas por dispositivos de E/S
   IRQ_RELOGIO,       // interrupção causada pelo relógio
-  // interrupções de E/S ainda não implementadas
+  // interrupções dos terminais, pelo controlador de interrupções (cint.h)
   IRQ_TECLADO,       // interrupção causada pelo teclado
   IRQ_TELA,          // interrupção causada pela tela
   N_IRQ              // número de interrupções
@@ -0,0 +1,23 @@
+// log.c
+// mensagens de log na console, com níveis de detalhe
+// simulador de computador
+// so24b
+
+#include "log.h"
+
+#include <string.h>
+
+static char *nomes[N_LOG_NIVEL] = {
+  [LOG_ERRO]   = "erro",
+  [LOG_INFO]   = "info",
+  [LOG_DEPURA] = "depura",
+  [LOG_RASTRO] = "rastro",
+};
+
+log_nivel_t log_nivel_do_nome(char *nome)
+{
+  for (log_nivel_t nivel = 0; nivel < N_LOG_NIVEL; nivel++) {
+    if (strcmp(nome, nomes[nivel]) == 0) return nivel;
+  }
+  return -1;
+}
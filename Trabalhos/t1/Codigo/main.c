@@ -9,12 +9,15 @@
 #include "relogio.h"
 #include "console.h"
 #include "terminal.h"
+#include "cint.h"
 #include "es.h"
 #include "dispositivos.h"
 #include "so.h"
+#include "log.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // constantes
 #define MEM_TAM 10000        // tamanho da memória principal
@@ -24,6 +27,7 @@ typedef struct {
   mem_t *mem;
   cpu_t *cpu;
   relogio_t *relogio;
+  cint_t *cint;
   console_t *console;
   es_t *es;
   controle_t *controle;
@@ -37,6 +41,13 @@ static void cria_hardware(hardware_t *hw)
   // cria dispositivos de E/S
   hw->console = console_cria();
   hw->relogio = relogio_cria();
+  hw->cint = cint_cria();
+
+  // os terminais avisam o controlador de interrupções quando têm algo a
+  //   entregar ou quando podem receber
+  for (int t = 0; t < 4; t++) {
+    terminal_define_cint(console_terminal(hw->console, 'A' + t), hw->cint, t);
+  }
 
   // cria o controlador de E/S e registra os dispositivos
   //   por exemplo, o dispositivo 8 do controlador de E/S (e da CPU) será o
@@ -72,13 +83,16 @@ static void cria_hardware(hardware_t *hw)
   es_registra_dispositivo(hw->es, D_RELOGIO_REAL      , hw->relogio, 1, relogio_leitura, NULL);
   es_registra_dispositivo(hw->es, D_RELOGIO_TIMER     , hw->relogio, 2, relogio_leitura, relogio_escrita);
   es_registra_dispositivo(hw->es, D_RELOGIO_INTERRUPCAO,hw->relogio, 3, relogio_leitura, relogio_escrita);
+  // lê e reconhece os pedidos de interrupção dos terminais
+  es_registra_dispositivo(hw->es, D_CINT_TECLADO      , hw->cint, 0, cint_leitura, cint_escrita);
+  es_registra_dispositivo(hw->es, D_CINT_TELA         , hw->cint, 1, cint_leitura, cint_escrita);
 
   // cria a unidade de execução e inicializa com a memória e o controlador de E/S
   hw->cpu = cpu_cria(hw->mem, hw->es);
 
-  // cria o controlador da CPU e inicializa com a unidade de execução, a console e
-  //   o relógio
-  hw->controle = controle_cria(hw->cpu, hw->console, hw->relogio);
+  // cria o controlador da CPU e inicializa com a unidade de execução, a console,
+  //   o relógio e o controlador de interrupções
+  hw->controle = controle_cria(hw->cpu, hw->console, hw->relogio, hw->cint);
 }
 
 static void destroi_hardware(hardware_t *hw)
@@ -87,17 +101,37 @@ static void destroi_hardware(hardware_t *hw)
   cpu_destroi(hw->cpu);
   es_destroi(hw->es);
   relogio_destroi(hw->relogio);
+  cint_destroi(hw->cint);
   console_destroi(hw->console);
   mem_destroi(hw->mem);
 }
 
-int main()
+// a única opção é '-l nível', para definir o nível de detalhe das mensagens
+//   na console
+static log_nivel_t verifica_args(int argc, char *argv[argc])
+{
+  if (argc == 1) return LOG_RASTRO;
+  log_nivel_t nivel = -1;
+  if (argc == 3 && strcmp(argv[1], "-l") == 0) {
+    nivel = log_nivel_do_nome(argv[2]);
+  }
+  if (nivel == -1) {
+    fprintf(stderr, "ERRO: chame como '%s [-l erro|info|depura|rastro]'\n", argv[0]);
+    exit(1);
+  }
+  return nivel;
+}
+
+int main(int argc, char *argv[argc])
 {
   hardware_t hw;
   so_t *so;
 
+  log_nivel_t nivel_log = verifica_args(argc, argv);
+
   // cria o hardware
   cria_hardware(&hw);
+  console_define_nivel_log(hw.console, nivel_log);
   // cria o sistema operacional
   so = so_cria(hw.cpu, hw.mem, hw.es, hw.console);
   
@@ -12,6 +12,7 @@ prog     string 'p1  (bastante CPU pouca E/S)
 ; chamadas de sistema (ver so.h)
 SO_LE          define 1
 SO_ESCR        define 2
+SO_ESCR_STR    define 10
 SO_CRIA_PROC   define 7
 SO_MATA_PROC   define 8
 SO_ESPERA_PROC define 9
@@ -65,15 +66,12 @@ cada     valor CADA
 ene      valor N
 
 ; imprime a string que inicia em A (destroi X)
+; retorna em A o número de caracteres impressos ou o código de erro do SO
 impstr   espaco 1
          trax
-impstr1
-         cargx 0
-         desvz impstrf
-         chama impch
-         incx
-         desv impstr1
-impstrf  ret impstr
+         cargi SO_ESCR_STR
+         chamas
+         ret impstr
 
 ; função que chama o SO para imprimir o caractere em A
 ; retorna em A o código de erro do SO
@@ -1,3 +1,5 @@
+#include "cpu.h"
+
 typedef enum {
     MORTO, 
     PRONTO, 
@@ -19,21 +21,21 @@ typedef struct porta_t {
     int teclado;
     int estadoTela;
     int tela;
+    struct processo_t *dono; // Processo que usa a porta (NULL se livre)
     struct porta_t *proxima; // Ponteiro para a próxima porta livre
 } porta_t;
 
 typedef struct processo_t {
     int pid;
-    int reg_PC;
-    int reg_A;
-    int reg_X;
-    int reg_erro;
-    int reg_complemento;
-    int modo;
+    cpu_estado_t regs; // estado da CPU do processo (PC, A, X, erro, complemento, modo)
     estado_t estado;
     motivo_bloqueio_t motivo_bloqueio; // Adicionado campo para motivo de bloqueio
     porta_t *porta;
     bool chamada_sistema; // Adicionada variável para diferenciar chamada de sistema
+    // transferência em andamento nas chamadas de E/S de vários caracteres
+    int es_ender; // endereço do próximo caractere na memória do processo
+    int es_resto; // caracteres que faltam (-1 se até o fim da string)
+    int es_feitos; // caracteres já transferidos
     double prioridade; // Adicionada variável para prioridade
     struct processo_t *prox_processo; // Adicionada variável para próximo processo na fila
 } processo_t;
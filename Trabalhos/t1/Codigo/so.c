@@ -10,6 +10,7 @@
 #include "programa.h"
 #include "instrucao.h"
 #include "processo.h"
+#include "log.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -22,8 +23,6 @@
 #define INTERVALO_INTERRUPCAO 30   
 #define MAX_PROCESSOS 10
 
-int PID_GERAL = 0; 
-
 struct so_t {
   cpu_t *cpu;
   mem_t *mem;
@@ -38,6 +37,7 @@ struct so_t {
   porta_t *portas_livres; // Lista de portas livres
   processo_t *fila_processos; // Fila de processos para round-robin
   int quantum; // Quantum para round-robin
+  int proximo_pid; // PID a dar ao próximo processo criado
 };
 
 static void muda_estado(processo_t *processo, estado_t estado){
@@ -51,6 +51,7 @@ static void inicializa_portas(so_t *self) {
         self->tabela_portas[i].teclado = D_TERM_A_TECLADO + (i * 4);
         self->tabela_portas[i].estadoTela = D_TERM_A_TELA_OK + (i * 4);
         self->tabela_portas[i].tela = D_TERM_A_TELA + (i * 4);
+        self->tabela_portas[i].dono = NULL;
         self->tabela_portas[i].proxima = (i < MAX_PROCESSOS - 1) ? &self->tabela_portas[i + 1] : NULL;
     }
     self->portas_livres = &self->tabela_portas[0];
@@ -69,25 +70,28 @@ static porta_t* atribuir_porta(so_t *self) {
 
 static void liberar_porta(so_t *self, porta_t *porta) {
     porta->ocupada = false;
+    porta->dono = NULL;
     porta->proxima = self->portas_livres;
     self->portas_livres = porta;
 }
 
 static void inicializa_processo(so_t *self, processo_t *processo, int ender) {
-    processo->pid = PID_GERAL++; 
-    processo->reg_PC = ender;
-    processo->reg_A = 0;
-    processo->reg_X = 0;
-    processo->reg_erro = 0;
-    processo->reg_complemento = 0;
-    processo->modo = usuario;
+    processo->pid = self->proximo_pid++;
+    processo->regs.PC = ender;
+    processo->regs.A = 0;
+    processo->regs.X = 0;
+    processo->regs.erro = 0;
+    processo->regs.complemento = 0;
+    processo->regs.modo = usuario;
     processo->porta = atribuir_porta(self);
     processo->prioridade = 0.5;
     processo->prox_processo = NULL; 
     if (processo->porta == NULL) {
-        console_printf("SO: Erro ao atribuir porta ao processo");
-        self->processo_corrente->reg_A = -1;
+        log_erro(self->console, "SO: Erro ao atribuir porta ao processo");
+        self->processo_corrente->regs.A = -1;
         self->erro_interno = true;
+    } else {
+        processo->porta->dono = processo;
     }
     muda_estado(processo, PRONTO);
 }
@@ -110,64 +114,17 @@ static int so_carrega_programa(so_t *self, char *nome_do_executavel);
 static bool copia_str_da_mem(int tam, char str[tam], mem_t *mem, int ender);
 
 // Função para salvar o estado do processador na tabela de processos
+// a CPU salva o estado no banco de registradores de sombra, basta copiar
 static bool salva_estado_processo(so_t *self) {
-    bool deu_erro = false;
-    if (mem_le(self->mem, IRQ_END_A, &self->processo_corrente->reg_A) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    if (mem_le(self->mem, IRQ_END_X, &self->processo_corrente->reg_X) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    if (mem_le(self->mem, IRQ_END_PC, &self->processo_corrente->reg_PC) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    if (mem_le(self->mem, IRQ_END_erro, &self->processo_corrente->reg_erro) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    if (mem_le(self->mem, IRQ_END_complemento, &self->processo_corrente->reg_complemento) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    if (mem_le(self->mem, IRQ_END_modo, &self->processo_corrente->modo) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    return deu_erro;
+    self->processo_corrente->regs = *cpu_estado_salvo(self->cpu);
+    return false;
 }
 
 
 // Função para recuperar o estado do processador a partir da tabela de processos
 static bool recupera_estado_processo(so_t *self) {
-    bool deu_erro = false;
-    if (mem_escreve(self->mem, IRQ_END_A, self->processo_corrente->reg_A) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    if (mem_escreve(self->mem, IRQ_END_X, self->processo_corrente->reg_X) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    if (mem_escreve(self->mem, IRQ_END_PC, self->processo_corrente->reg_PC) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    if (mem_escreve(self->mem, IRQ_END_erro, self->processo_corrente->reg_erro) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    if (mem_escreve(self->mem, IRQ_END_complemento, self->processo_corrente->reg_complemento) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    if (mem_escreve(self->mem, IRQ_END_modo, self->processo_corrente->modo) != ERR_OK)
-    {
-      deu_erro = true;
-    }
-    return deu_erro;
+    *cpu_estado_salvo(self->cpu) = self->processo_corrente->regs;
+    return false;
 }
 
 // CRIAÇÃO {{{1
@@ -184,21 +141,26 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, es_t *es, console_t *console)
   self->erro_interno = false;
   self->fila_processos = NULL; 
   self->quantum = QUANTUM; 
+  self->proximo_pid = 0;
 
   inicializa_portas(self);
 
   if(inicializa_tabela_processos(self) != ERR_OK){
-    console_printf("SO: Erro ao inicializar a tabela de processos");
+    log_erro(self->console, "SO: Erro ao inicializar a tabela de processos");
     self->erro_interno = true;
   }
 
+  // a CPU salva o estado nas interrupções no banco de registradores de sombra,
+  //   de onde o SO copia para o descritor do processo (e vice-versa)
+  cpu_define_salvamento(self->cpu, CPU_SALVA_NO_BANCO);
+
   // quando a CPU executar uma instrução CHAMAC, deve chamar a função
   //   so_trata_interrupcao, com primeiro argumento um ptr para o SO
   cpu_define_chamaC(self->cpu, so_trata_interrupcao, self);
 
   // coloca o tratador de interrupção na memória
   // quando a CPU aceita uma interrupção, passa para modo supervisor, 
-  //   salva seu estado à partir do endereço 0, e desvia para o endereço
+  //   salva seu estado no banco de sombra, e desvia para o endereço
   //   IRQ_END_TRATADOR
   // colocamos no endereço IRQ_END_TRATADOR o programa de tratamento
   //   de interrupção (escrito em asm). esse programa deve conter a 
@@ -206,13 +168,13 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, es_t *es, console_t *console)
   //   foi definido acima)
   int ender = so_carrega_programa(self, "trata_int.maq");
   if (ender != IRQ_END_TRATADOR) {
-    console_printf("SO: problema na carga do programa de tratamento de interrupção");
+    log_erro(self->console, "SO: problema na carga do programa de tratamento de interrupção");
     self->erro_interno = true;
   }
 
   // programa o relógio para gerar uma interrupção após INTERVALO_INTERRUPCAO
   if (es_escreve(self->es, D_RELOGIO_TIMER, INTERVALO_INTERRUPCAO) != ERR_OK) {
-    console_printf("SO: problema na programação do timer");
+    log_erro(self->console, "SO: problema na programação do timer");
     self->erro_interno = true;
   }
 
@@ -231,12 +193,11 @@ void so_destroi(so_t *self)
 // funções auxiliares para o tratamento de interrupção
 static void so_salva_estado_da_cpu(so_t *self);
 static void so_trata_irq(so_t *self, int irq);
-static void so_trata_pendencias(so_t *self);
 static void so_escalona(so_t *self);
 static int so_despacha(so_t *self);
 static void so_pendencia_de_escrita(so_t *self, processo_t *processo);
 static void so_pendencia_de_leitura(so_t *self, processo_t *processo);
-static void so_pendencia_de_espera(so_t *self, processo_t *processo);
+static void so_mata_processo(so_t *self, processo_t *processo);
 static void so_desbloqueia_processo(so_t *self, processo_t *processo);
 static void retira_processo_fila(so_t *self, processo_t *processo);
 static void adiciona_processo_fila(so_t *self, processo_t *processo);
@@ -263,13 +224,14 @@ static int so_trata_interrupcao(void *argC, int reg_A)
   so_t *self = argC;
   irq_t irq = reg_A;
   // esse print polui bastante, recomendo tirar quando estiver com mais confiança
-  console_printf("SO: recebi IRQ %d (%s)", irq, irq_nome(irq));
+  log_rastro(self->console, "SO: recebi IRQ %d (%s)", irq, irq_nome(irq));
   // salva o estado da cpu no descritor do processo que foi interrompido
   so_salva_estado_da_cpu(self);
   // faz o atendimento da interrupção
+  // não tem pendências a verificar a cada interrupção: um processo bloqueado
+  //   em E/S é desbloqueado pela interrupção do seu terminal, e um processo
+  //   esperando outro é desbloqueado na morte do esperado
   so_trata_irq(self, irq);
-  // faz o processamento independente da interrupção
-  so_trata_pendencias(self);
   // escolhe o próximo processo a executar
   so_escalona(self);
   // recupera o estado do processo escolhido
@@ -280,7 +242,7 @@ static void so_salva_estado_da_cpu(so_t *self)
 {
   // t1: salva os registradores que compõem o estado da cpu no descritor do
   // processo corrente. os valores dos registradores foram colocados pela
-  // CPU na memória, nos endereços IRQ_END_*
+  // CPU no banco de registradores de sombra (cpu_estado_salvo)
   // se não houver processo corrente, não faz nada
   bool deu_erro;
   if(self->processo_corrente == NULL || self->processo_corrente->estado != EXECUTANDO)
@@ -294,39 +256,20 @@ static void so_salva_estado_da_cpu(so_t *self)
 
   if(deu_erro)
   {
-    console_printf("SO: Erro ao salvar o estado da CPU");
+    log_erro(self->console, "SO: Erro ao salvar o estado da CPU");
     self->erro_interno = true;
   }
 }
 
-static void so_trata_pendencias(so_t *self) {
-    for (int i = 0; i < MAX_PROCESSOS; i++) {
-        processo_t *proc = &self->tabela_processos[i];
-        if (proc->estado == BLOQUEADO) {
-            switch (proc->motivo_bloqueio) {
-                case BLOQUEIO_ES:
-                    so_pendencia_de_escrita(self, proc);
-                    break;
-                case BLOQUEIO_LE:
-                    so_pendencia_de_leitura(self, proc);
-                    break;
-                case BLOQUEIO_ESPERA:
-                    so_pendencia_de_espera(self, proc);
-                    break;
-                default:
-                    console_printf("SO: motivo de bloqueio desconhecido");
-                    self->erro_interno = true;
-                    break;
-            }
-        }
-    }
-}
-
 static void so_escalona(so_t *self) {
     // Escolhe o próximo processo a executar, que passa a ser o processo
     // corrente; pode continuar sendo o mesmo de antes ou não
-    // Verifica se o processo corrente ainda está pronto para continuar
-    if (self->processo_corrente != NULL && self->processo_corrente->estado == PRONTO) {
+    // Verifica se o processo corrente ainda pode continuar: ele está
+    // EXECUTANDO se foi interrompido sem bloquear nem morrer, ou PRONTO se
+    // acabou de ser escolhido pela preempção do relógio
+    if (self->processo_corrente != NULL
+        && (self->processo_corrente->estado == PRONTO
+            || self->processo_corrente->estado == EXECUTANDO)) {
         return; // O processo corrente continua sendo executado
     }
 
@@ -383,17 +326,23 @@ static void so_escalona_prioridade(so_t *self) {
 static int so_despacha(so_t *self)
 {
   // t1: se houver processo corrente, coloca o estado desse processo onde ele
-  // será recuperado pela CPU (em IRQ_END_*) e retorna 0, senão retorna 1
+  // será recuperado pela CPU (no banco de sombra) e retorna 0, senão retorna 1
   // o valor retornado será o valor de retorno de CHAMAC
-  console_printf("quantum = %d", self->quantum);
+  log_rastro(self->console, "quantum = %d", self->quantum);
 
   bool deu_erro;
-  if(self->erro_interno || self->processo_corrente == NULL)
+  if(!self->erro_interno && self->processo_corrente == NULL)
+  {
+    // nenhum processo pronto: a CPU fica parada até a próxima interrupção
+    log_depura(self->console, "SO: nenhum processo para executar");
+    return 1;
+  }
+  if(self->erro_interno)
   {
-    console_printf("SO: deu ruim na 1 verificacao do despacha, erro interno %d", self->erro_interno);
+    log_erro(self->console, "SO: deu ruim na 1 verificacao do despacha, erro interno %d", self->erro_interno);
     if(self->processo_corrente != NULL)
     {
-      console_printf("SO: processo corrente %d estado %d", self->processo_corrente->pid, self->processo_corrente->estado);
+      log_erro(self->console, "SO: processo corrente %d estado %d", self->processo_corrente->pid, self->processo_corrente->estado);
     }
     return 1;
   }
@@ -403,14 +352,14 @@ static int so_despacha(so_t *self)
   }
 
   if(deu_erro){
-    console_printf("SO: Erro ao despachar o processo");
+    log_erro(self->console, "SO: Erro ao despachar o processo");
     self->erro_interno = true;
     return 1;
   }
   else
   {
     self->processo_corrente->estado = EXECUTANDO;
-    console_printf("SO: processo %d despachado com sucesso", self->processo_corrente->pid);
+    log_depura(self->console, "SO: processo %d despachado com sucesso", self->processo_corrente->pid);
     return 0;
   }
 }
@@ -422,6 +371,8 @@ static void so_trata_irq_reset(so_t *self);
 static void so_trata_irq_chamada_sistema(so_t *self);
 static void so_trata_irq_err_cpu(so_t *self);
 static void so_trata_irq_relogio(so_t *self);
+static void so_trata_irq_teclado(so_t *self);
+static void so_trata_irq_tela(so_t *self);
 static void so_trata_irq_desconhecida(so_t *self, int irq);
 
 static void so_trata_irq(so_t *self, int irq)
@@ -440,6 +391,12 @@ static void so_trata_irq(so_t *self, int irq)
     case IRQ_RELOGIO:
       so_trata_irq_relogio(self);
       break;
+    case IRQ_TECLADO:
+      so_trata_irq_teclado(self);
+      break;
+    case IRQ_TELA:
+      so_trata_irq_tela(self);
+      break;
     default:
       so_trata_irq_desconhecida(self, irq);
   }
@@ -458,7 +415,7 @@ static void so_trata_irq_reset(so_t *self)
   // coloca o programa init na memória
   int ender = so_carrega_programa(self, "init.maq");
   if (ender != 100) {
-    console_printf("SO: problema na carga do programa inicial");
+    log_erro(self->console, "SO: problema na carga do programa inicial");
     self->erro_interno = true;
     return;
   }
@@ -477,23 +434,22 @@ static void so_trata_irq_reset(so_t *self)
 static void so_trata_irq_err_cpu(so_t *self)
 {
   // Ocorreu um erro interno na CPU
-  // O erro está codificado em IRQ_END_erro
+  // O erro está no estado salvo pela CPU
   // Em geral, causa a morte do processo que causou o erro
   // Ainda não temos processos, causa a parada da CPU
   int err_int;
   // t1: com suporte a processos, deveria pegar o valor do registrador erro
   // no descritor do processo corrente, e reagir de acordo com esse erro
   // (em geral, matando o processo)
-  mem_le(self->mem, IRQ_END_erro, &err_int);
+  err_int = cpu_estado_salvo(self->cpu)->erro;
   err_t err = err_int;
-  console_printf("SO: IRQ não tratada -- erro na CPU: %s", err_nome(err));
+  log_erro(self->console, "SO: IRQ não tratada -- erro na CPU: %s", err_nome(err));
   self->erro_interno = true;
 
   // Trata a morte do processo corrente
   if (self->processo_corrente != NULL) {
-      console_printf("SO: Matando o processo PID %d", self->processo_corrente->pid);
-      liberar_porta(self, self->processo_corrente->porta);
-      muda_estado(self->processo_corrente, MORTO);
+      log_info(self->console, "SO: Matando o processo PID %d", self->processo_corrente->pid);
+      so_mata_processo(self, self->processo_corrente);
   }
 }
 
@@ -505,7 +461,7 @@ static void so_trata_irq_relogio(so_t *self)
   e1 = es_escreve(self->es, D_RELOGIO_INTERRUPCAO, 0); // desliga o sinalizador de interrupção
   e2 = es_escreve(self->es, D_RELOGIO_TIMER, INTERVALO_INTERRUPCAO);
   if (e1 != ERR_OK || e2 != ERR_OK) {
-    console_printf("SO: problema da reinicialização do timer");
+    log_erro(self->console, "SO: problema da reinicialização do timer");
     self->erro_interno = true;
   }
 
@@ -523,10 +479,51 @@ static void so_trata_irq_relogio(so_t *self)
   }
 }
 
+// lê e reconhece os pedidos de interrupção dos terminais no dispositivo
+//   'disp' do controlador de interrupções, e tenta de novo a E/S do processo
+//   que está bloqueado com 'motivo' em cada terminal que pediu
+static void so_acorda_terminais(so_t *self, dispositivo_id_t disp,
+                                motivo_bloqueio_t motivo)
+{
+  int terminais;
+  if (es_le(self->es, disp, &terminais) != ERR_OK
+      || es_escreve(self->es, disp, terminais) != ERR_OK) {
+    log_erro(self->console, "SO: problema no acesso ao controlador de interrupções");
+    self->erro_interno = true;
+    return;
+  }
+  // o terminal t é o da porta t
+  for (int t = 0; t < MAX_PROCESSOS; t++) {
+    if ((terminais & (1 << t)) == 0) continue;
+    processo_t *proc = self->tabela_portas[t].dono;
+    if (proc == NULL || proc->estado != BLOQUEADO
+        || proc->motivo_bloqueio != motivo) {
+      continue;
+    }
+    if (motivo == BLOQUEIO_LE) {
+      so_pendencia_de_leitura(self, proc);
+    } else {
+      so_pendencia_de_escrita(self, proc);
+    }
+  }
+}
+
+// interrupção gerada quando chega um caractere no teclado de um terminal
+static void so_trata_irq_teclado(so_t *self)
+{
+  so_acorda_terminais(self, D_CINT_TECLADO, BLOQUEIO_LE);
+}
+
+// interrupção gerada quando a tela de um terminal volta a aceitar caracteres
+static void so_trata_irq_tela(so_t *self)
+{
+  so_acorda_terminais(self, D_CINT_TELA, BLOQUEIO_ES);
+}
+
 // foi gerada uma interrupção para a qual o SO não está preparado
 static void so_trata_irq_desconhecida(so_t *self, int irq)
 {
-  console_printf("SO: não sei tratar IRQ %d (%s)", irq, irq_nome(irq));
+  log_erro(self->console, "SO: não sei tratar IRQ %d (%s)", irq, irq_nome(irq));
   self->erro_interno = true;
 }
 
@@ -535,6 +532,9 @@ static void so_trata_irq_desconhecida(so_t *self, int irq)
 // funções auxiliares para cada chamada de sistema
 static void so_chamada_le(so_t *self);
 static void so_chamada_escr(so_t *self);
+static void so_chamada_escr_str(so_t *self);
+static void so_chamada_escr_buf(so_t *self);
+static void so_chamada_le_buf(so_t *self);
 static void so_chamada_cria_proc(so_t *self);
 static void so_chamada_mata_proc(so_t *self);
 static void so_chamada_espera_proc(so_t *self);
@@ -557,7 +557,7 @@ static void so_tentativa_leitura(so_t *self, processo_t *proc) {
 
     int estado;
     if (es_le(self->es, porta->estadoTeclado, &estado) != ERR_OK) {
-        console_printf("SO: problema no acesso ao estado do teclado");
+        log_erro(self->console, "SO: problema no acesso ao estado do teclado");
         self->erro_interno = true;
         return;
     }
@@ -570,11 +570,11 @@ static void so_tentativa_leitura(so_t *self, processo_t *proc) {
 
     int dado;
     if (es_le(self->es, porta->teclado, &dado) != ERR_OK) {
-        console_printf("SO: problema no acesso ao teclado");
+        log_erro(self->console, "SO: problema no acesso ao teclado");
         self->erro_interno = true;
         return;
     }
-    proc->reg_A = dado;
+    proc->regs.A = dado;
     so_desbloqueia_processo(self, proc);
 }
 
@@ -583,7 +583,7 @@ static void so_tentativa_escrita(so_t *self, processo_t *proc) {
 
     int estado;
     if (es_le(self->es, porta->estadoTela, &estado) != ERR_OK) {
-        console_printf("SO: problema no acesso ao estado da tela");
+        log_erro(self->console, "SO: problema no acesso ao estado da tela");
         self->erro_interno = true;
         return;
     }
@@ -594,32 +594,129 @@ static void so_tentativa_escrita(so_t *self, processo_t *proc) {
         return;
     }
 
-    int dado = proc->reg_X;
+    int dado = proc->regs.X;
     if (es_escreve(self->es, porta->tela, dado) != ERR_OK) {
-        console_printf("SO: problema no acesso à tela");
+        log_erro(self->console, "SO: problema no acesso à tela");
         self->erro_interno = true;
         return;
     }
-    proc->reg_A = 0;
+    proc->regs.A = 0;
     so_desbloqueia_processo(self, proc);
 }
 
+// termina a transferência de vários caracteres do processo, com 'resultado'
+//   no seu registrador A
+static void so_termina_transferencia(so_t *self, processo_t *proc, int resultado)
+{
+  proc->regs.A = resultado;
+  so_desbloqueia_processo(self, proc);
+}
+
+// escreve na tela do processo os caracteres da transferência em andamento,
+//   enquanto a tela aceitar; se ela não aceitar, bloqueia o processo, e a
+//   escrita continua daqui quando vier a interrupção da tela
+static void so_continua_escrita(so_t *self, processo_t *proc)
+{
+  porta_t *porta = proc->porta;
+
+  while (proc->es_resto != 0) {
+    int caractere;
+    if (mem_le(self->mem, proc->es_ender, &caractere) != ERR_OK) {
+      so_termina_transferencia(self, proc, -1);
+      return;
+    }
+    if (proc->es_resto < 0 && caractere == 0) break;
+
+    int estado;
+    if (es_le(self->es, porta->estadoTela, &estado) != ERR_OK) {
+      log_erro(self->console, "SO: problema no acesso ao estado da tela");
+      self->erro_interno = true;
+      return;
+    }
+    if (estado == 0) {
+      so_bloqueia_processo(self, proc, BLOQUEADO, BLOQUEIO_ES);
+      return;
+    }
+    if (es_escreve(self->es, porta->tela, caractere) != ERR_OK) {
+      log_erro(self->console, "SO: problema no acesso à tela");
+      self->erro_interno = true;
+      return;
+    }
+    proc->es_ender++;
+    proc->es_feitos++;
+    if (proc->es_resto > 0) proc->es_resto--;
+  }
+  so_termina_transferencia(self, proc, proc->es_feitos);
+}
+
+// lê do teclado do processo os caracteres disponíveis para a transferência
+//   em andamento; se não tiver nenhum, bloqueia o processo, e a leitura
+//   continua daqui quando vier a interrupção do teclado
+static void so_continua_leitura(so_t *self, processo_t *proc)
+{
+  porta_t *porta = proc->porta;
+
+  while (proc->es_resto > 0) {
+    int estado;
+    if (es_le(self->es, porta->estadoTeclado, &estado) != ERR_OK) {
+      log_erro(self->console, "SO: problema no acesso ao estado do teclado");
+      self->erro_interno = true;
+      return;
+    }
+    if (estado == 0) {
+      // só bloqueia se ainda não leu nada
+      if (proc->es_feitos > 0) break;
+      so_bloqueia_processo(self, proc, BLOQUEADO, BLOQUEIO_LE);
+      return;
+    }
+    int dado;
+    if (es_le(self->es, porta->teclado, &dado) != ERR_OK) {
+      log_erro(self->console, "SO: problema no acesso ao teclado");
+      self->erro_interno = true;
+      return;
+    }
+    if (mem_escreve(self->mem, proc->es_ender, dado) != ERR_OK) {
+      so_termina_transferencia(self, proc, -1);
+      return;
+    }
+    proc->es_ender++;
+    proc->es_feitos++;
+    proc->es_resto--;
+    if (dado == '\n') break;
+  }
+  so_termina_transferencia(self, proc, proc->es_feitos);
+}
+
+// a chamada de sistema que bloqueou o processo ainda está no seu
+//   registrador A, e diz como a E/S deve continuar
 static void so_pendencia_de_escrita(so_t *self, processo_t *processo)
 {
-  so_tentativa_escrita(self, processo);
+  if (processo->regs.A == SO_ESCR) {
+    so_tentativa_escrita(self, processo);
+  } else {
+    so_continua_escrita(self, processo);
+  }
 }
 
 static void so_pendencia_de_leitura(so_t *self, processo_t *processo)
 {
-  so_tentativa_leitura(self, processo);
+  if (processo->regs.A == SO_LE) {
+    so_tentativa_leitura(self, processo);
+  } else {
+    so_continua_leitura(self, processo);
+  }
 }
 
-static void so_pendencia_de_espera(so_t *self, processo_t *processo) {
+// mata o processo, e desbloqueia os processos que estavam esperando ele
+static void so_mata_processo(so_t *self, processo_t *processo) {
+    liberar_porta(self, processo->porta);
+    muda_estado(processo, MORTO);
     for (int i = 0; i < MAX_PROCESSOS; i++) {
-        processo_t *processo_esperado = &self->tabela_processos[i];
-        if (processo_esperado->pid == processo->reg_X && processo_esperado->estado == MORTO) {
-            so_desbloqueia_processo(self, processo);
-            console_printf("Desbloquando processo porque o esperado de PID %d morreu.", processo_esperado->pid);
+        processo_t *proc = &self->tabela_processos[i];
+        if (proc->estado == BLOQUEADO && proc->motivo_bloqueio == BLOQUEIO_ESPERA
+            && proc->regs.X == processo->pid) {
+            so_desbloqueia_processo(self, proc);
+            log_depura(self->console, "Desbloquando processo porque o esperado de PID %d morreu.", processo->pid);
         }
     }
 }
@@ -629,9 +726,6 @@ static void so_pendencia_de_espera(so_t *self, processo_t *processo) {
 static void so_chamada_le(so_t *self) {
     self->processo_corrente->chamada_sistema = true;
     so_tentativa_leitura(self, self->processo_corrente);
-    if (self->processo_corrente->estado == PRONTO) {
-        mem_escreve(self->mem, IRQ_END_A, self->processo_corrente->reg_A);
-    }
     self->processo_corrente->chamada_sistema = false;
 }
 
@@ -640,18 +734,66 @@ static void so_chamada_le(so_t *self) {
 static void so_chamada_escr(so_t *self) {
     self->processo_corrente->chamada_sistema = true;
     so_tentativa_escrita(self, self->processo_corrente);
-    if (self->processo_corrente->estado == PRONTO) {
-        mem_escreve(self->mem, IRQ_END_A, 0);
-    }
     self->processo_corrente->chamada_sistema = false;
 }
 
+// implementação da chamada de sistema SO_ESCR_STR
+// escreve a string que inicia no endereço X na saída corrente do processo
+static void so_chamada_escr_str(so_t *self)
+{
+  processo_t *proc = self->processo_corrente;
+  proc->es_ender = proc->regs.X;
+  proc->es_resto = -1;
+  proc->es_feitos = 0;
+  so_continua_escrita(self, proc);
+}
+
+// inicializa a transferência do processo com o descritor de buffer que
+//   está no endereço X; retorna false se o descritor não for válido
+static bool so_inicia_transferencia_buf(so_t *self, processo_t *proc)
+{
+  int ender, tam;
+  if (mem_le(self->mem, proc->regs.X, &ender) != ERR_OK
+      || mem_le(self->mem, proc->regs.X + 1, &tam) != ERR_OK
+      || tam < 0) {
+    return false;
+  }
+  proc->es_ender = ender;
+  proc->es_resto = tam;
+  proc->es_feitos = 0;
+  return true;
+}
+
+// implementação da chamada de sistema SO_ESCR_BUF
+// escreve o buffer descrito em X na saída corrente do processo
+static void so_chamada_escr_buf(so_t *self)
+{
+  processo_t *proc = self->processo_corrente;
+  if (!so_inicia_transferencia_buf(self, proc)) {
+    proc->regs.A = -1;
+    return;
+  }
+  so_continua_escrita(self, proc);
+}
+
+// implementação da chamada de sistema SO_LE_BUF
+// lê da entrada corrente do processo para o buffer descrito em X
+static void so_chamada_le_buf(so_t *self)
+{
+  processo_t *proc = self->processo_corrente;
+  if (!so_inicia_transferencia_buf(self, proc)) {
+    proc->regs.A = -1;
+    return;
+  }
+  so_continua_leitura(self, proc);
+}
+
 // implementação da chamada de sistema SO_CRIA_PROC
 // cria um processo
 static void so_chamada_cria_proc(so_t *self)
 {
   // em X está o endereço onde está o nome do arquivo
-  int ender_proc = self->processo_corrente->reg_X;
+  int ender_proc = self->processo_corrente->regs.X;
   char nome[100];
   if (copia_str_da_mem(100, nome, self->mem, ender_proc)) 
   {
@@ -664,56 +806,54 @@ static void so_chamada_cria_proc(so_t *self)
         if (self->tabela_processos[i].estado == MORTO) 
         {     
           inicializa_processo(self, &self->tabela_processos[i], ender_carga);
-          if(self->processo_corrente->reg_A == -1)
+          if(self->processo_corrente->regs.A == -1)
           {
             return;
           }
-          self->processo_corrente->reg_A = self->tabela_processos[i].pid;
+          self->processo_corrente->regs.A = self->tabela_processos[i].pid;
           return;
         }
       }
     }
   }
   // Se houve erro, escreve -1 no registrador A do processo corrente
-  self->processo_corrente->reg_A = -1;
+  self->processo_corrente->regs.A = -1;
 }
 
 // implementação da chamada de sistema SO_MATA_PROC
 // mata o processo com pid X (ou o processo corrente se X é 0)
 static void so_chamada_mata_proc(so_t *self)
 {
-  int pid = self->processo_corrente->reg_X;
+  int pid = self->processo_corrente->regs.X;
 
   if (pid == 0) {
     // Mata o processo corrente
-    console_printf("SO: Matando o proprio proceso PID %d.", self->processo_corrente->pid);
-    liberar_porta(self, self->processo_corrente->porta);
-    muda_estado(self->processo_corrente, MORTO);
+    log_info(self->console, "SO: Matando o proprio proceso PID %d.", self->processo_corrente->pid);
+    so_mata_processo(self, self->processo_corrente);
     return;
   } else {
     // Procura o processo na tabela de processos
-    console_printf("SO: Matando o processo PID %d", pid);
+    log_info(self->console, "SO: Matando o processo PID %d", pid);
     for (int i = 0; i < MAX_PROCESSOS; i++) {
       if (self->tabela_processos[i].pid == pid) {
-        liberar_porta(self, self->tabela_processos[i].porta);
-        muda_estado(&self->tabela_processos[i], MORTO);
+        so_mata_processo(self, &self->tabela_processos[i]);
         return;
       }
     }
   }
 
   // Se não encontrou o processo, escreve -1 no registrador A do processo corrente
-  self->processo_corrente->reg_A = -1;
+  self->processo_corrente->regs.A = -1;
 }
 
 // implementação da chamada se sistema SO_ESPERA_PROC
 // espera o fim do processo com pid X
 static void so_chamada_espera_proc(so_t *self) {
-    int pid_esperado = self->processo_corrente->reg_X;
+    int pid_esperado = self->processo_corrente->regs.X;
 
     if (pid_esperado == 0 || pid_esperado == self->processo_corrente->pid) {
         // Não pode esperar por si mesmo ou por um processo inexistente
-        self->processo_corrente->reg_A = -1;
+        self->processo_corrente->regs.A = -1;
         return;
     }
 
@@ -726,7 +866,7 @@ static void so_chamada_espera_proc(so_t *self) {
     }
 
     // Se o processo esperado não existe, retorna erro
-    self->processo_corrente->reg_A = -1;
+    self->processo_corrente->regs.A = -1;
 }
 
 // CARGA DE PROGRAMA {{{1
@@ -738,7 +878,7 @@ static int so_carrega_programa(so_t *self, char *nome_do_executavel)
   // programa para executar na nossa CPU
   programa_t *prog = prog_cria(nome_do_executavel);
   if (prog == NULL) {
-    console_printf("Erro na leitura do programa '%s'\n", nome_do_executavel);
+    log_erro(self->console, "Erro na leitura do programa '%s'\n", nome_do_executavel);
     return -1;
   }
 
@@ -747,13 +887,13 @@ static int so_carrega_programa(so_t *self, char *nome_do_executavel)
 
   for (int end = end_ini; end < end_fim; end++) {
     if (mem_escreve(self->mem, end, prog_dado(prog, end)) != ERR_OK) {
-      console_printf("Erro na carga da memória, endereco %d\n", end);
+      log_erro(self->console, "Erro na carga da memória, endereco %d\n", end);
       return -1;
     }
   }
 
   prog_destroi(prog);
-  console_printf("SO: carga de '%s' em %d-%d", nome_do_executavel, end_ini, end_fim);
+  log_info(self->console, "SO: carga de '%s' em %d-%d", nome_do_executavel, end_ini, end_fim);
   return end_ini;
 }
 
@@ -827,7 +967,7 @@ static void retira_processo_fila(so_t *self, processo_t *processo) {
 
 static void so_trata_irq_chamada_sistema(so_t *self) {
     // a identificação da chamada está no registrador A
-    int id_chamada = self->processo_corrente->reg_A;
+    int id_chamada = self->processo_corrente->regs.A;
 
     switch (id_chamada) {
         case SO_LE:
@@ -836,6 +976,15 @@ static void so_trata_irq_chamada_sistema(so_t *self) {
         case SO_ESCR:
             so_chamada_escr(self);
             break;
+        case SO_ESCR_STR:
+            so_chamada_escr_str(self);
+            break;
+        case SO_ESCR_BUF:
+            so_chamada_escr_buf(self);
+            break;
+        case SO_LE_BUF:
+            so_chamada_le_buf(self);
+            break;
         case SO_CRIA_PROC:
             so_chamada_cria_proc(self);
             break;
@@ -846,8 +995,8 @@ static void so_trata_irq_chamada_sistema(so_t *self) {
             so_chamada_espera_proc(self);
             break;
         default:
-            console_printf("SO: chamada de sistema desconhecida (%d)", id_chamada);
-            muda_estado(self->processo_corrente, MORTO);
+            log_erro(self->console, "SO: chamada de sistema desconhecida (%d)", id_chamada);
+            so_mata_processo(self, self->processo_corrente);
     }
 
 }
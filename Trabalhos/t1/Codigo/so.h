@@ -44,6 +44,38 @@ void so_destroi(so_t *self);
 // #define SO_SEL_LE      5
 // #define SO_SEL_ESCR    6
 
+// As chamadas abaixo transferem vários caracteres com uma só chamada de
+//   sistema. Se o dispositivo não estiver pronto no meio da transferência,
+//   o processo é bloqueado, e a transferência continua de onde parou na
+//   interrupção do terminal (IRQ_TELA na escrita, IRQ_TECLADO na leitura),
+//   sem nova chamada de sistema; o processo só volta a executar quando a
+//   chamada terminar.
+// A tela do terminal rola a cada caractere escrito depois que a linha
+//   enche, então uma escrita longa ainda bloqueia uma vez por caractere a
+//   partir daí; o que deixa de existir é a chamada de sistema por caractere.
+// As chamadas com buffer recebem em X o endereço de um descritor de 2
+//   posições de memória: na primeira está o endereço do buffer, na
+//   segunda o número de caracteres.
+
+// escreve uma string no dispositivo de saída do processo
+// recebe em X o endereço do primeiro caractere da string, que termina
+//   na posição de memória que contém o valor 0 (que não é escrito)
+// retorna em A: o número de caracteres escritos ou um código de erro negativo
+#define SO_ESCR_STR    10
+
+// escreve os caracteres de um buffer no dispositivo de saída do processo
+// recebe em X o endereço do descritor do buffer (endereço e tamanho)
+// retorna em A: o número de caracteres escritos ou um código de erro negativo
+#define SO_ESCR_BUF    11
+
+// lê caracteres do dispositivo de entrada do processo para um buffer
+// recebe em X o endereço do descritor do buffer (endereço e número máximo
+//   de caracteres a ler)
+// bloqueia até ter pelo menos um caractere; lê os que estiverem disponíveis,
+//   até encher o buffer ou ler um '\n' (que é colocado no buffer)
+// retorna em A: o número de caracteres lidos ou um código de erro negativo
+#define SO_LE_BUF      12
+
 
 // Chamadas para gerenciamento de processos
 // O sistema cria um processo automaticamente na sua inicialização,
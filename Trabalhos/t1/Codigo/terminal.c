@@ -4,6 +4,7 @@
 // so24b
 
 #include "terminal.h"
+#include "irq.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +33,10 @@ struct terminal_t {
   enum { normal, rolando, limpando } estado_saida;
   // posicao do caractere que está sendo movido durante uma rolagem
   int pos_rolagem;
+  // controlador de interrupções a avisar (ou NULL), e o número do terminal
+  //   nele
+  cint_t *cint;
+  int num_cint;
 };
 
 
@@ -48,6 +53,8 @@ terminal_t *terminal_cria(int tam_linha)
   strcpy(self->entrada, "");
   strcpy(self->saida, "");
   self->estado_saida = normal;
+  self->cint = NULL;
+  self->num_cint = 0;
 
   return self;
 }
@@ -59,6 +66,25 @@ void terminal_destroi(terminal_t *self)
   free(self);
 }
 
+void terminal_define_cint(terminal_t *self, cint_t *cint, int num)
+{
+  self->cint = cint;
+  self->num_cint = num;
+}
+
+// pede a interrupção 'irq' ao controlador de interrupções, se tiver um
+static void terminal_pede_interrupcao(terminal_t *self, irq_t irq)
+{
+  if (self->cint != NULL) cint_pede(self->cint, irq, self->num_cint);
+}
+
+// a saída volta a aceitar caracteres
+static void terminal_saida_normal(terminal_t *self)
+{
+  self->estado_saida = normal;
+  terminal_pede_interrupcao(self, IRQ_TELA);
+}
+
 static bool terminal_entrada_vazia(terminal_t *self)
 {
   return self->entrada[0] == '\0';
@@ -82,6 +108,8 @@ void terminal_insere_char(terminal_t *self, char ch)
   if (tam >= self->tam_linha-2) return;
   p[tam] = ch;
   p[tam+1] = '\0';
+  // a entrada estava vazia, agora dá para ler
+  if (tam == 0) terminal_pede_interrupcao(self, IRQ_TECLADO);
 }
 
 static bool terminal_pode_imprimir(terminal_t *self)
@@ -110,7 +138,7 @@ static void terminal_imprime(terminal_t *self, char ch)
 void terminal_limpa_saida(terminal_t *self)
 {
   self->saida[0] = '\0';
-  self->estado_saida = normal;
+  if (self->estado_saida != normal) terminal_saida_normal(self);
 }
 
 static void terminal_atualiza_rolagem(terminal_t *self)
@@ -123,7 +151,7 @@ static void terminal_atualiza_rolagem(terminal_t *self)
     self->pos_rolagem++;
     p[self->pos_rolagem] = ' ';
   } else {
-    self->estado_saida = normal;
+    terminal_saida_normal(self);
   }
 }
 
@@ -134,7 +162,7 @@ static void terminal_atualiza_limpeza(terminal_t *self)
   int tam = strlen(p);
   memmove(p, p+1, tam);
   if (tam <= 1) {
-    self->estado_saida = normal;
+    terminal_saida_normal(self);
   }
 }
 
@@ -26,6 +26,10 @@
 // a escrita não é possível se a saída estiver rolando ou sendo limpa, o que é
 //   feito um caractere por vez (a cada chamada a tictac).
 //
+// se tiver um controlador de interrupções, o terminal pede IRQ_TECLADO quando
+//   a entrada, que estava vazia, recebe um caractere, e IRQ_TELA quando a saída
+//   termina de rolar ou de ser limpa e volta a aceitar caracteres
+//
 // a E/S efetiva é realizada pela console. ela obtém acesso às linhas de entrada e
 //   saída chamando terminal_txt_entrada ou terminal_txt_saida. a console insere
 //   caracteres digitados no terminal chamando terminal_insere_char, e limpa a
@@ -33,6 +37,7 @@
 
 #include <stdbool.h>
 #include "es.h"
+#include "cint.h"
 
 typedef struct terminal_t terminal_t;
 
@@ -41,6 +46,10 @@ terminal_t *terminal_cria(int tam_linha);
 // libera a memória ocupada por um terminal
 void terminal_destroi(terminal_t *self);
 
+// define o controlador de interrupções a avisar, e o número deste terminal
+//   nele (0 para o terminal A)
+void terminal_define_cint(terminal_t *self, cint_t *cint, int num);
+
 // retorna a linha de entrada do terminal (para uso pela console)
 char *terminal_txt_entrada(terminal_t *self);
 
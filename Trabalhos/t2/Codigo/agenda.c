@@ -0,0 +1,153 @@
+// agenda.c
+// agenda de eventos futuros dos dispositivos, ordenada pelo instante
+// simulador de computador
+// so24b
+
+#include "agenda.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+// a agenda é um heap mínimo, ordenado por instante e, no mesmo instante, pela
+//   ordem de inserção
+typedef struct {
+  int instante;
+  unsigned long ordem;
+  func_evento_t funcao;
+  void *arg;
+} evento_t;
+
+struct agenda_t {
+  evento_t *eventos;
+  int n_eventos;
+  int capacidade;
+  // número de ordem do próximo evento inserido
+  unsigned long ordem;
+};
+
+agenda_t *agenda_cria(void)
+{
+  agenda_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->capacidade = 8;
+  self->eventos = malloc(self->capacidade * sizeof(evento_t));
+  assert(self->eventos != NULL);
+  self->n_eventos = 0;
+  self->ordem = 0;
+  return self;
+}
+
+void agenda_destroi(agenda_t *self)
+{
+  free(self->eventos);
+  free(self);
+}
+
+// HEAP {{{1
+
+// retorna true se o evento 'a' deve acontecer antes do 'b'
+static bool antes(evento_t *a, evento_t *b)
+{
+  if (a->instante != b->instante) return a->instante < b->instante;
+  return a->ordem < b->ordem;
+}
+
+static void troca(agenda_t *self, int i, int j)
+{
+  evento_t tmp = self->eventos[i];
+  self->eventos[i] = self->eventos[j];
+  self->eventos[j] = tmp;
+}
+
+static void sobe(agenda_t *self, int i)
+{
+  while (i > 0) {
+    int pai = (i - 1) / 2;
+    if (!antes(&self->eventos[i], &self->eventos[pai])) break;
+    troca(self, i, pai);
+    i = pai;
+  }
+}
+
+static void desce(agenda_t *self, int i)
+{
+  for (;;) {
+    int menor = i;
+    int esq = 2 * i + 1;
+    int dir = esq + 1;
+    if (esq < self->n_eventos
+        && antes(&self->eventos[esq], &self->eventos[menor])) {
+      menor = esq;
+    }
+    if (dir < self->n_eventos
+        && antes(&self->eventos[dir], &self->eventos[menor])) {
+      menor = dir;
+    }
+    if (menor == i) break;
+    troca(self, i, menor);
+    i = menor;
+  }
+}
+
+// retira o evento na posição 'i' do heap
+static void retira(agenda_t *self, int i)
+{
+  self->n_eventos--;
+  if (i == self->n_eventos) return;
+  self->eventos[i] = self->eventos[self->n_eventos];
+  sobe(self, i);
+  desce(self, i);
+}
+
+// OPERAÇÕES {{{1
+
+void agenda_insere(agenda_t *self, int instante, func_evento_t funcao, void *arg)
+{
+  if (self->n_eventos == self->capacidade) {
+    self->capacidade *= 2;
+    self->eventos = realloc(self->eventos, self->capacidade * sizeof(evento_t));
+    assert(self->eventos != NULL);
+  }
+  evento_t *ev = &self->eventos[self->n_eventos];
+  ev->instante = instante;
+  ev->ordem = self->ordem++;
+  ev->funcao = funcao;
+  ev->arg = arg;
+  self->n_eventos++;
+  sobe(self, self->n_eventos - 1);
+}
+
+void agenda_remove(agenda_t *self, func_evento_t funcao, void *arg)
+{
+  // são poucos eventos, a busca é linear
+  int i = 0;
+  while (i < self->n_eventos) {
+    evento_t *ev = &self->eventos[i];
+    if (ev->funcao == funcao && ev->arg == arg) {
+      retira(self, i);
+      // o que foi colocado na posição 'i' pode ter subido; recomeça
+      i = 0;
+    } else {
+      i++;
+    }
+  }
+}
+
+bool agenda_proximo(agenda_t *self, int *pinstante)
+{
+  if (self->n_eventos == 0) return false;
+  *pinstante = self->eventos[0].instante;
+  return true;
+}
+
+void agenda_dispara(agenda_t *self, int agora)
+{
+  while (self->n_eventos > 0 && self->eventos[0].instante <= agora) {
+    // retira antes de chamar, a função pode alterar a agenda
+    evento_t ev = self->eventos[0];
+    retira(self, 0);
+    ev.funcao(ev.arg);
+  }
+}
+
+// vim: foldmethod=marker
@@ -0,0 +1,45 @@
+// agenda.h
+// agenda de eventos futuros dos dispositivos, ordenada pelo instante
+// simulador de computador
+// so24b
+
+#ifndef AGENDA_H
+#define AGENDA_H
+
+// Em vez de cada dispositivo ser consultado a cada instrução para saber se
+//   tem algo a fazer, ele coloca na agenda o instante (no relógio de
+//   instruções) em que algo vai acontecer, e a função a ser chamada nesse
+//   instante. O controlador executa a CPU até o instante do próximo evento,
+//   e o relógio dispara os eventos que venceram quando avança.
+// Os eventos de um mesmo instante são disparados na ordem em que foram
+//   inseridos.
+
+#include <stdbool.h>
+
+typedef struct agenda_t agenda_t;
+
+// tipo da função chamada quando o evento acontece; recebe o argumento
+//   fornecido na inserção do evento
+typedef void (*func_evento_t)(void *arg);
+
+// cria uma agenda vazia
+agenda_t *agenda_cria(void);
+
+// destrói uma agenda (os eventos pendentes são descartados)
+void agenda_destroi(agenda_t *self);
+
+// insere um evento, que vai chamar 'funcao(arg)' no instante 'instante'
+void agenda_insere(agenda_t *self, int instante, func_evento_t funcao, void *arg);
+
+// remove os eventos pendentes que chamariam 'funcao(arg)'
+void agenda_remove(agenda_t *self, func_evento_t funcao, void *arg);
+
+// retorna true se a agenda tem algum evento, e coloca em '*pinstante' o
+//   instante do próximo
+bool agenda_proximo(agenda_t *self, int *pinstante);
+
+// dispara, em ordem, os eventos com instante até 'agora' (inclusive)
+// as funções dos eventos podem inserir e remover eventos
+void agenda_dispara(agenda_t *self, int agora);
+
+#endif // AGENDA_H
@@ -0,0 +1,126 @@
+// arqlog.c
+// escrita assíncrona de um arquivo de log
+// simulador de computador
+// so24b
+
+#include "arqlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <assert.h>
+
+// tamanho da fila, em bytes (tem que ser potência de 2)
+#define TAM_FILA (1 << 20)
+// tempo que a escritora dorme quando a fila está vazia, em µs
+#define ESPERA_VAZIA 2000
+// tempo que arqlog_escreve dorme esperando espaço na fila cheia, em µs
+#define ESPERA_CHEIA 100
+
+struct arqlog_t {
+  FILE *arquivo;
+  // fila circular de bytes a escrever
+  // 'inicio' e 'fim' só crescem; a posição na fila é o resto da divisão por
+  //   TAM_FILA. 'fim' só é alterado por quem escreve no log, 'inicio' só pela
+  //   thread escritora
+  char fila[TAM_FILA];
+  atomic_size_t inicio;
+  atomic_size_t fim;
+  atomic_bool terminar;
+  pthread_t escritora;
+};
+
+static void *arqlog_escritora(void *arg);
+
+arqlog_t *arqlog_cria(char *nome)
+{
+  FILE *arquivo = fopen(nome, "w");
+  if (arquivo == NULL) return NULL;
+
+  arqlog_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->arquivo = arquivo;
+  atomic_init(&self->inicio, 0);
+  atomic_init(&self->fim, 0);
+  atomic_init(&self->terminar, false);
+  int r = pthread_create(&self->escritora, NULL, arqlog_escritora, self);
+  assert(r == 0);
+
+  return self;
+}
+
+void arqlog_destroi(arqlog_t *self)
+{
+  atomic_store(&self->terminar, true);
+  pthread_join(self->escritora, NULL);
+  fclose(self->arquivo);
+  free(self);
+}
+
+static void dorme(int us)
+{
+  struct timespec ts = { .tv_sec = 0, .tv_nsec = us * 1000L };
+  nanosleep(&ts, NULL);
+}
+
+// PRODUTOR {{{1
+
+// coloca 'n' bytes de 'dados' na posição 'pos' da fila
+static void copia_para_fila(arqlog_t *self, size_t pos, char *dados, size_t n)
+{
+  size_t p = pos % TAM_FILA;
+  size_t n1 = n < TAM_FILA - p ? n : TAM_FILA - p;
+  memcpy(&self->fila[p], dados, n1);
+  memcpy(&self->fila[0], dados + n1, n - n1);
+}
+
+void arqlog_escreve(arqlog_t *self, char *linha)
+{
+  size_t n = strlen(linha);
+  // sempre sobra espaço para o fim de linha
+  if (n > TAM_FILA - 1) n = TAM_FILA - 1;
+  size_t fim = atomic_load_explicit(&self->fim, memory_order_relaxed);
+  while (fim + n + 1 - atomic_load_explicit(&self->inicio, memory_order_acquire)
+         > TAM_FILA) {
+    // fila cheia, espera a escritora
+    dorme(ESPERA_CHEIA);
+  }
+  copia_para_fila(self, fim, linha, n);
+  copia_para_fila(self, fim + n, "\n", 1);
+  atomic_store_explicit(&self->fim, fim + n + 1, memory_order_release);
+}
+
+// ESCRITORA {{{1
+
+static void *arqlog_escritora(void *arg)
+{
+  arqlog_t *self = arg;
+  for (;;) {
+    // lê 'terminar' antes de 'fim', para não perder o que foi colocado na fila
+    //   antes do pedido de término
+    bool terminar = atomic_load(&self->terminar);
+    size_t inicio = atomic_load_explicit(&self->inicio, memory_order_relaxed);
+    size_t fim = atomic_load_explicit(&self->fim, memory_order_acquire);
+    if (inicio == fim) {
+      if (terminar) break;
+      // deixa o arquivo em dia enquanto não tem nada para fazer
+      fflush(self->arquivo);
+      dorme(ESPERA_VAZIA);
+      continue;
+    }
+    // escreve tudo que tem na fila, em no máximo dois pedaços
+    size_t p = inicio % TAM_FILA;
+    size_t n = fim - inicio;
+    size_t n1 = n < TAM_FILA - p ? n : TAM_FILA - p;
+    fwrite(&self->fila[p], 1, n1, self->arquivo);
+    fwrite(&self->fila[0], 1, n - n1, self->arquivo);
+    atomic_store_explicit(&self->inicio, fim, memory_order_release);
+  }
+  return NULL;
+}
+
+// vim: foldmethod=marker
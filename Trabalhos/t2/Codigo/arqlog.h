@@ -0,0 +1,28 @@
+// arqlog.h
+// escrita assíncrona de um arquivo de log
+// simulador de computador
+// so24b
+
+#ifndef ARQLOG_H
+#define ARQLOG_H
+
+// as linhas do log são colocadas em uma fila circular em memória, e uma
+//   thread separada retira da fila e escreve no arquivo, em blocos grandes
+// a fila não usa trava: só a thread que chama arqlog_escreve coloca dados na
+//   fila, e só a thread escritora retira
+// se a fila encher, arqlog_escreve espera a escritora abrir espaço
+
+typedef struct arqlog_t arqlog_t;
+
+// cria o arquivo 'nome' e a thread que escreve nele
+// retorna NULL se não conseguir criar o arquivo
+arqlog_t *arqlog_cria(char *nome);
+
+// escreve no arquivo o que ainda estiver na fila, fecha o arquivo e termina a
+//   thread escritora
+void arqlog_destroi(arqlog_t *self);
+
+// coloca a linha 'linha' (seguida de um fim de linha) na fila para escrita
+void arqlog_escreve(arqlog_t *self, char *linha);
+
+#endif // ARQLOG_H
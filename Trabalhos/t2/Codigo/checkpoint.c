@@ -0,0 +1,175 @@
+// checkpoint.c
+// arquivo com o estado completo de uma máquina, para salvar e restaurar
+// simulador de computador
+// so24b
+
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+// identificação do arquivo, no início dele
+#define CKPT_MAGICA "so24bckp"
+
+// cabeçalho do arquivo
+typedef struct {
+  char magica[8];
+  int versao;
+} ckpt_cabecalho_t;
+
+struct ckpt_t {
+  // true se está salvando, false se está restaurando
+  bool salvando;
+  // true se aconteceu algum erro
+  bool erro;
+  // para salvar: o arquivo
+  FILE *arquivo;
+  // para restaurar: o descritor do arquivo e o mapeamento dele
+  int fd;
+  char *mapa;
+  long tam_mapa;
+  // posição no arquivo do próximo dado a ler ou escrever
+  long pos;
+};
+
+static long tam_pagina(void)
+{
+  return sysconf(_SC_PAGESIZE);
+}
+
+static ckpt_t *ckpt_aloca(bool salvando)
+{
+  ckpt_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->salvando = salvando;
+  self->erro = false;
+  self->arquivo = NULL;
+  self->fd = -1;
+  self->mapa = NULL;
+  self->tam_mapa = 0;
+  self->pos = 0;
+  return self;
+}
+
+ckpt_t *ckpt_cria(char *nome)
+{
+  FILE *arquivo = fopen(nome, "w");
+  if (arquivo == NULL) return NULL;
+  ckpt_t *self = ckpt_aloca(true);
+  self->arquivo = arquivo;
+
+  ckpt_cabecalho_t cab;
+  memset(&cab, 0, sizeof(cab));
+  memcpy(cab.magica, CKPT_MAGICA, sizeof(cab.magica));
+  cab.versao = CKPT_VERSAO;
+  ckpt_escreve(self, &cab, sizeof(cab));
+  return self;
+}
+
+ckpt_t *ckpt_abre(char *nome)
+{
+  int fd = open(nome, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < sizeof(ckpt_cabecalho_t)) {
+    close(fd);
+    return NULL;
+  }
+  void *mapa = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapa == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+  ckpt_t *self = ckpt_aloca(false);
+  self->fd = fd;
+  self->mapa = mapa;
+  self->tam_mapa = st.st_size;
+
+  ckpt_cabecalho_t cab;
+  ckpt_le(self, &cab, sizeof(cab));
+  if (memcmp(cab.magica, CKPT_MAGICA, sizeof(cab.magica)) != 0
+      || cab.versao != CKPT_VERSAO) {
+    ckpt_fecha(self);
+    return NULL;
+  }
+  return self;
+}
+
+bool ckpt_fecha(ckpt_t *self)
+{
+  bool ok = !self->erro;
+  if (self->arquivo != NULL) {
+    if (fclose(self->arquivo) != 0) ok = false;
+  }
+  if (self->mapa != NULL) munmap(self->mapa, self->tam_mapa);
+  if (self->fd >= 0) close(self->fd);
+  free(self);
+  return ok;
+}
+
+// SALVAMENTO {{{1
+
+void ckpt_escreve(ckpt_t *self, void *dados, int tam)
+{
+  assert(self->salvando);
+  if (fwrite(dados, 1, tam, self->arquivo) != tam) self->erro = true;
+  self->pos += tam;
+}
+
+void ckpt_escreve_paginas(ckpt_t *self, void *dados, int tam)
+{
+  // completa a página corrente com zeros
+  long pagina = tam_pagina();
+  while (self->pos % pagina != 0) {
+    char zero = 0;
+    ckpt_escreve(self, &zero, 1);
+  }
+  ckpt_escreve(self, dados, tam);
+}
+
+// RESTAURAÇÃO {{{1
+
+bool ckpt_le(ckpt_t *self, void *dados, int tam)
+{
+  assert(!self->salvando);
+  if (self->erro || tam < 0 || self->pos + tam > self->tam_mapa) {
+    self->erro = true;
+    memset(dados, 0, tam);
+    return false;
+  }
+  memcpy(dados, self->mapa + self->pos, tam);
+  self->pos += tam;
+  return true;
+}
+
+void *ckpt_mapeia(ckpt_t *self, int tam)
+{
+  assert(!self->salvando);
+  long pagina = tam_pagina();
+  long inicio = (self->pos + pagina - 1) / pagina * pagina;
+  if (self->erro || tam <= 0 || inicio + tam > self->tam_mapa) {
+    self->erro = true;
+    return NULL;
+  }
+  void *dados = mmap(NULL, tam, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                     self->fd, inicio);
+  if (dados == MAP_FAILED) {
+    self->erro = true;
+    return NULL;
+  }
+  self->pos = inicio + tam;
+  return dados;
+}
+
+void ckpt_desmapeia(void *dados, int tam)
+{
+  munmap(dados, tam);
+}
+
+// vim: foldmethod=marker
@@ -0,0 +1,65 @@
+// checkpoint.h
+// arquivo com o estado completo de uma máquina, para salvar e restaurar
+// simulador de computador
+// so24b
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+// um checkpoint é um arquivo com uma identificação e versão, seguidas do
+//   estado de cada componente da máquina, na ordem em que os componentes
+//   foram salvos (os componentes devem ser restaurados na mesma ordem)
+// os dados do checkpoint são lidos de um mapeamento do arquivo em memória;
+//   regiões grandes (como o conteúdo da memória principal) são alinhadas a
+//   páginas no arquivo e podem ser usadas diretamente, sem cópia, através de
+//   um mapeamento privado (as alterações não vão para o arquivo)
+// cada componente tem funções "_salva" e "_restaura", que recebem um ckpt_t
+
+#include <stdbool.h>
+
+// versão do formato do arquivo; deve ser alterada quando o estado salvo de
+//   algum componente mudar
+#define CKPT_VERSAO 8
+
+typedef struct ckpt_t ckpt_t;
+
+// cria o arquivo 'nome' para salvar um checkpoint
+// retorna NULL se não conseguir criar o arquivo
+ckpt_t *ckpt_cria(char *nome);
+
+// abre o arquivo 'nome' para restaurar um checkpoint
+// retorna NULL se não conseguir abrir o arquivo, ou se ele não for um
+//   checkpoint da versão CKPT_VERSAO
+ckpt_t *ckpt_abre(char *nome);
+
+// fecha o arquivo; retorna false se houve algum erro de escrita ou leitura
+//   (por exemplo, se tentou ler além do final do arquivo)
+bool ckpt_fecha(ckpt_t *self);
+
+// SALVAMENTO
+
+// escreve 'tam' bytes de 'dados' no checkpoint
+void ckpt_escreve(ckpt_t *self, void *dados, int tam);
+
+// escreve 'tam' bytes de 'dados' no checkpoint, começando em um início de
+//   página do arquivo, para poderem ser restaurados com ckpt_mapeia
+void ckpt_escreve_paginas(ckpt_t *self, void *dados, int tam);
+
+// RESTAURAÇÃO
+
+// copia os próximos 'tam' bytes do checkpoint para 'dados'
+// retorna false (e marca o checkpoint com erro) se não tiver 'tam' bytes
+bool ckpt_le(ckpt_t *self, void *dados, int tam);
+
+// retorna um ponteiro para um mapeamento privado (que pode ser alterado sem
+//   alterar o arquivo) dos próximos 'tam' bytes do checkpoint, que devem ter
+//   sido escritos com ckpt_escreve_paginas
+// o mapeamento continua válido após o fechamento do checkpoint, e deve ser
+//   liberado com ckpt_desmapeia
+// retorna NULL (e marca o checkpoint com erro) se não for possível mapear
+void *ckpt_mapeia(ckpt_t *self, int tam);
+
+// libera um mapeamento obtido com ckpt_mapeia
+void ckpt_desmapeia(void *dados, int tam);
+
+#endif // CHECKPOINT_H
@@ -8,12 +8,15 @@
 #include "console.h"
 #include "terminal.h"
 #include "tela.h"
+#include "log.h"
+#include "arqlog.h"
 
 #include <string.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <time.h>
 #include <assert.h>
 
 // CONSTANTES {{{1
@@ -39,6 +42,9 @@
 // números de comandos para o controlador que podem ser guardados na console
 #define N_CMD_EXT 10
 
+// número máximo de vezes por segundo que a tela é redesenhada
+#define QUADROS_POR_SEGUNDO 30
+
 // DECLARAÇÃO {{{1
 
 struct console_t {
@@ -46,20 +52,36 @@ struct console_t {
   int cor_txt[N_TERM];
   int cor_cursor[N_TERM];
   char txt_status[N_COL+1];
+  // as linhas da console formam uma fila circular; 'prim_linha' é a mais antiga
+  //   (a que aparece no alto da tela), e é sobrescrita pela próxima inserida
   char txt_console[N_LIN_CONSOLE][N_COL+1];
+  int prim_linha;
   char txt_entrada[N_COL+1];
   char fila_de_comandos_externos[N_CMD_EXT];
-  FILE *arquivo_de_log;
+  arqlog_t *arquivo_de_log;
+  int nivel_log;
+  bool com_tela;
+  // o que está desenhado na tela, para redesenhar só o que mudou
+  // as linhas de cada terminal (entrada e saída) e o status são comparados
+  //   com o que foi desenhado; as outras partes são marcadas quando alteradas
+  char tela_term[N_TERM][2][N_COL+1];
+  char tela_status[N_COL+1];
+  bool console_alterada;
+  bool entrada_alterada;
+  // false se a tela tem que ser toda redesenhada
+  bool tela_desenhada;
+  // instante em que a tela foi desenhada pela última vez, em ns
+  long long instante_quadro;
 };
 
 // CRIAÇÃO {{{1
 
-static console_t *console_global; // gambiarra para simplificar o uso de prints na console
-console_t *console_cria(void)
+static void insere_comando_externo(console_t *self, char c);
+
+console_t *console_cria(bool com_tela, char *nome_log)
 {
   console_t *self = malloc(sizeof(*self));
   assert(self != NULL);
-  console_global = self;
 
   for (int t = 0; t < N_TERM; t++) {
     self->term[t] = terminal_cria(N_COL);
@@ -74,11 +96,25 @@ console_t *console_cria(void)
   for (int l = 0; l < N_LIN_CONSOLE; l++) {
     strcpy(self->txt_console[l], "");
   }
+  self->prim_linha = 0;
   strcpy(self->txt_entrada, "");
   self->fila_de_comandos_externos[0] = '\0';
-  self->arquivo_de_log = fopen("log_da_console", "w");
-
-  tela_init();
+  self->arquivo_de_log = NULL;
+  if (nome_log != NULL) self->arquivo_de_log = arqlog_cria(nome_log);
+  self->nivel_log = LOG_RASTRO;
+  self->com_tela = com_tela;
+  strcpy(self->txt_status, "");
+  self->console_alterada = false;
+  self->entrada_alterada = false;
+  self->tela_desenhada = false;
+  self->instante_quadro = 0;
+
+  if (com_tela) {
+    tela_init();
+  } else {
+    // não tem operador para mandar executar
+    insere_comando_externo(self, 'C');
+  }
 
   return self;
 }
@@ -87,14 +123,16 @@ static void console_desenha(console_t *self);
 
 void console_destroi(console_t *self)
 {
-  console_desenha(self);
-  if (self->arquivo_de_log != NULL) fclose(self->arquivo_de_log);
-  tela_puts(COR_OCUPADO, "  digite ENTER para sair  ");
-  tela_atualiza();
-  while (tela_tecla() != '\n') {
-    ;
+  if (self->arquivo_de_log != NULL) arqlog_destroi(self->arquivo_de_log);
+  if (self->com_tela) {
+    console_desenha(self);
+    tela_puts(COR_OCUPADO, "  digite ENTER para sair  ");
+    tela_atualiza();
+    while (tela_tecla() != '\n') {
+      ;
+    }
+    tela_fim();
   }
-  tela_fim();
 
   for (int t = 0; t < N_TERM; t++) {
     terminal_destroi(self->term[t]);
@@ -113,6 +151,13 @@ terminal_t *console_terminal(console_t *self, char id_terminal)
 }
 
 static void atualiza_terminais(console_t *self)
+{
+  for (int t = 0; t < N_TERM; t++) {
+    terminal_atualiza(self->term[t]);
+  }
+}
+
+static void tictac_terminais(console_t *self)
 {
   for (int t = 0; t < N_TERM; t++) {
     terminal_tictac(self->term[t]);
@@ -124,7 +169,7 @@ static void insere_string_no_terminal(console_t *self, char id_terminal, char *s
   // insere caracteres no terminal (e espaço no final)
   terminal_t *terminal = console_terminal(self, id_terminal);
   if (terminal == NULL) {
-    console_printf("Terminal '%c' inválido\n", id_terminal);
+    console_printf(self, "Terminal '%c' inválido\n", id_terminal);
     return;
   }
   char *p = str;
@@ -139,7 +184,7 @@ static void limpa_saida_do_terminal(console_t *self, char id_terminal)
 {
   terminal_t *terminal = console_terminal(self, id_terminal);
   if (terminal == NULL) {
-    console_printf("Terminal '%c' inválido\n", id_terminal);
+    console_printf(self, "Terminal '%c' inválido\n", id_terminal);
     return;
   }
   terminal_limpa_saida(terminal);
@@ -149,14 +194,14 @@ static void limpa_saida_do_terminal(console_t *self, char id_terminal)
 
 static void insere_string_na_console(console_t *self, char *s)
 {
-  for(int l=0; l<N_LIN_CONSOLE-1; l++) {
-    strncpy(self->txt_console[l], self->txt_console[l+1], N_COL);
-    self->txt_console[l][N_COL] = '\0'; // quem definiu strncpy é estúpido!
-  }
-  strncpy(self->txt_console[N_LIN_CONSOLE-1], s, N_COL);
-  self->txt_console[N_LIN_CONSOLE-1][N_COL] = '\0'; // grrrr
+  // a nova linha ocupa o lugar da mais antiga, que passa a ser a seguinte
+  char *linha = self->txt_console[self->prim_linha];
+  self->prim_linha = (self->prim_linha + 1) % N_LIN_CONSOLE;
+  strncpy(linha, s, N_COL);
+  linha[N_COL] = '\0'; // quem definiu strncpy é estúpido!
+  self->console_alterada = true;
   if (self->arquivo_de_log != NULL) {
-    fprintf(self->arquivo_de_log, "%s\n", s);
+    arqlog_escreve(self->arquivo_de_log, s);
   }
 }
 
@@ -181,12 +226,11 @@ void console_print_status(console_t *self, char *txt)
   sprintf(self->txt_status, "%-*s", N_COL, txt);
 }
 
-int console_printf(char *formato, ...)
+int console_printf(console_t *self, char *formato, ...)
 {
   // esta função usa número variável de argumentos, como o printf.
   // Se não sabe como é isso, dá uma olhada em:
   // https://www.geeksforgeeks.org/variadic-functions-in-c/
-  console_t *self = console_global; // gambiarra para simplificar o uso de prints na console
   char s[sizeof(self->txt_console)];
   va_list arg;
   va_start(arg, formato);
@@ -195,6 +239,16 @@ int console_printf(char *formato, ...)
   return r;
 }
 
+void console_define_nivel_log(console_t *self, int nivel)
+{
+  self->nivel_log = nivel;
+}
+
+int console_nivel_log(console_t *self)
+{
+  return self->nivel_log;
+}
+
 // ENTRADA {{{1
 
 static void insere_comando_externo(console_t *self, char c)
@@ -227,9 +281,10 @@ static void interpreta_linha_entrada(console_t *self)
   // 1     executa uma instrução
   // C     continua a execução
   // F     fim da simulação
+  // T     grava a trilha de instruções
 
   char *linha = self->txt_entrada;
-  console_printf("CMD: '%s'", linha);
+  console_printf(self, "CMD: '%s'", linha);
   char cmd = toupper(linha[0]);
   int val;
   switch (cmd) {
@@ -247,17 +302,20 @@ static void interpreta_linha_entrada(console_t *self)
     case '1':
     case 'C':
     case 'F':
+    case 'T':
       insere_comando_externo(self, cmd);
       break;
     default:
-      console_printf("Comando '%c' não reconhecido", cmd);
+      console_printf(self, "Comando '%c' não reconhecido", cmd);
   }
   strcpy(self->txt_entrada, "");
+  self->entrada_alterada = true;
 }
 
 // lê e guarda um caractere do teclado; interpreta linha se for 'enter'
 static void verifica_entrada(console_t *self)
 {
+  if (!self->com_tela) return;
   char ch = tela_tecla();
 
   int l = strlen(self->txt_entrada);
@@ -265,12 +323,14 @@ static void verifica_entrada(console_t *self)
   if (ch == '\b' || ch == 127) {   // backspace ou del
     if (l > 0) {
       self->txt_entrada[l - 1] = '\0';
+      self->entrada_alterada = true;
     }
   } else if (ch == '\n') {
     interpreta_linha_entrada(self);
   } else if (ch >= ' ' && ch < 127 && l < N_COL) {
     self->txt_entrada[l] = ch;
     self->txt_entrada[l+1] = '\0';
+    self->entrada_alterada = true;
   } // senão, ignora o caractere digitado
 }
 
@@ -282,44 +342,63 @@ char console_comando_externo(console_t *self)
 
 // DESENHO {{{1
 
-static void desenha_linha_terminal(char *txt, int linha, int cor_txt, int cor_cursor)
+// desenha uma linha de terminal, se for diferente do que já está na tela
+//   (em 'desenhado', que é atualizado)
+static void desenha_linha_terminal(char *txt, char *desenhado, bool forca,
+                                   int linha, int cor_txt, int cor_cursor)
 {
+  if (!forca && strcmp(txt, desenhado) == 0) return;
+  strncpy(desenhado, txt, N_COL);
+  desenhado[N_COL] = '\0';
   tela_posiciona(linha, 0);
   tela_puts(cor_txt, txt);
   tela_limpa_linha();
   tela_puts(cor_cursor, " ");
 }
 
-static void desenha_terminais(console_t *self)
+static void desenha_terminais(console_t *self, bool forca)
 {
   for (int t = 0; t < N_TERM; t++) {
     terminal_t *terminal = self->term[t];
     int cor_txt = self->cor_txt[t];
     int cor_cursor = self->cor_cursor[t];
     int linha = LINHA_TERM + t * 2;
-    desenha_linha_terminal(terminal_txt_entrada(terminal), linha, cor_txt, cor_cursor);
-    desenha_linha_terminal(terminal_txt_saida(terminal), linha+1, cor_txt, cor_cursor);
+    desenha_linha_terminal(terminal_txt_entrada(terminal), self->tela_term[t][0],
+                           forca, linha, cor_txt, cor_cursor);
+    desenha_linha_terminal(terminal_txt_saida(terminal), self->tela_term[t][1],
+                           forca, linha+1, cor_txt, cor_cursor);
   }
 }
 
-static void desenha_status(console_t *self)
+static void desenha_status(console_t *self, bool forca)
 {
+  if (!forca && strcmp(self->txt_status, self->tela_status) == 0) return;
+  strcpy(self->tela_status, self->txt_status);
   tela_posiciona(LINHA_STATUS, 0);
   tela_puts(COR_STATUS, self->txt_status);
   tela_limpa_linha();
 }
 
-static void desenha_console(console_t *self)
+static void desenha_console(console_t *self, bool forca)
 {
+  if (!forca && !self->console_alterada) return;
+  self->console_alterada = false;
   for (int l=0; l<N_LIN_CONSOLE; l++) {
     tela_posiciona(LINHA_CONSOLE + l, 0);
-    tela_puts(COR_CONSOLE, self->txt_console[l]);
+    int l_txt = (self->prim_linha + l) % N_LIN_CONSOLE;
+    tela_puts(COR_CONSOLE, self->txt_console[l_txt]);
     tela_limpa_linha();
   }
 }
 
-static void desenha_entrada(console_t *self)
+static void desenha_entrada(console_t *self, bool forca)
 {
+  if (!forca && !self->entrada_alterada) {
+    // o cursor fica no final da linha de entrada
+    tela_posiciona(LINHA_ENTRADA, strlen(self->txt_entrada));
+    return;
+  }
+  self->entrada_alterada = false;
   char txt_fixo[] = "P=para C=continua 1=passo F=fim  Ets=entra Zt=zera";
   tela_posiciona(LINHA_ENTRADA, 0);
   tela_puts(COR_ENTRADA, ""); // gambiarra para limpar na cor certa
@@ -330,23 +409,46 @@ static void desenha_entrada(console_t *self)
   tela_puts(COR_ENTRADA, self->txt_entrada);
 }
 
+// desenha as partes da tela que foram alteradas desde o último desenho
 static void console_desenha(console_t *self)
 {
-  desenha_terminais(self);
-  desenha_status(self);
-  desenha_console(self);
-  desenha_entrada(self);
+  bool forca = !self->tela_desenhada;
+  desenha_terminais(self, forca);
+  desenha_status(self, forca);
+  desenha_console(self, forca);
+  desenha_entrada(self, forca);
+  self->tela_desenhada = true;
 
   // faz aparecer tudo que foi desenhado
   tela_atualiza();
 }
 
+// retorna true se já passou tempo suficiente desde o último desenho da tela
+static bool hora_de_desenhar(console_t *self)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  long long agora = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  if (agora - self->instante_quadro < 1000000000LL / QUADROS_POR_SEGUNDO) {
+    return false;
+  }
+  self->instante_quadro = agora;
+  return true;
+}
+
 // TICTAC {{{1
-void console_tictac(console_t *self)
+void console_atualiza(console_t *self)
 {
   verifica_entrada(self);
   atualiza_terminais(self);
-  console_desenha(self);
+  if (self->com_tela && hora_de_desenhar(self)) console_desenha(self);
+}
+
+void console_tictac(console_t *self)
+{
+  verifica_entrada(self);
+  tictac_terminais(self);
+  if (self->com_tela && hora_de_desenhar(self)) console_desenha(self);
 }
 
 // vim: foldmethod=marker
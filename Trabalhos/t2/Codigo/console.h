@@ -12,13 +12,24 @@
 typedef struct console_t console_t;
 
 // cria e inicializa a console
-console_t *console_cria(void);
+// se 'com_tela' for false, a console não usa a tela nem o teclado: as
+//   mensagens vão só para o arquivo de log, a saída dos terminais deve ser
+//   copiada para arquivos (ver terminal_define_copia_saida), e a execução é
+//   iniciada sem esperar comando do operador
+// as mensagens são copiadas para o arquivo 'nome_log' (se não for NULL)
+console_t *console_cria(bool com_tela, char *nome_log);
 
 // destrói a console
 void console_destroi(console_t *self);
 
 // imprime na área geral do console
-int console_printf(char *fmt, ...);
+int console_printf(console_t *self, char *fmt, ...);
+
+// define o nível de detalhe das mensagens de log mostradas (ver log.h)
+void console_define_nivel_log(console_t *self, int nivel);
+
+// retorna o nível de detalhe das mensagens de log mostradas
+int console_nivel_log(console_t *self);
 
 // imprime na linha de status
 void console_print_status(console_t *self, char *txt);
@@ -30,14 +41,20 @@ void console_print_status(console_t *self, char *txt);
 //   'P': para a execução,
 //   '1': executa uma instrução,
 //   'C': continua a execução,
-//   'F': finaliza a simulação.
+//   'F': finaliza a simulação,
+//   'T': grava a trilha de instruções.
 // retorna '\0' caso não tenha comando externo digitado
 char console_comando_externo(console_t *self);
 
 // retorna o terminal identificado ('A', 'B', etc)
 terminal_t *console_terminal(console_t *self, char id_terminal);
 
-// esta função deve ser chamada periodicamente para que tela funcione
+// esta função deve ser chamada a cada iteração do controlador para que tela
+//   funcione; o tempo dos terminais vem do relógio, não desta chamada
+void console_atualiza(console_t *self);
+
+// como console_atualiza, mas os terminais passam um tic fora do relógio
+// é usada quando o SO fica em espera ocupada, sem o relógio avançar
 void console_tictac(console_t *self);
 
 #endif // CONSOLE_H
@@ -4,20 +4,31 @@
 // so24b
 
 #include "controle.h"
+#include "log.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
 
+// número máximo de instruções executadas entre duas atualizações da console
+#define MAX_PASSOS 1000
+
 struct controle_t {
   cpu_t *cpu;
   relogio_t *relogio;
   console_t *console;
   enum { executando, passo, parado, fim } estado;
+  // função e argumento para saber se a simulação terminou
+  func_fim_t funcao_fim;
+  void *arg_fim;
+  // gravação ou reprodução dos comandos do operador (ou NULL)
+  gravacao_t *gravacao;
 };
 
 // funções auxiliares
+static int controle_passos_a_executar(controle_t *self);
+static int controle_tempo_ocioso(controle_t *self);
 static void controle_processa_comandos_da_console(controle_t *self);
 static void controle_atualiza_estado_na_console(controle_t *self);
 
@@ -31,6 +42,8 @@ controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio)
   self->console = console;
   self->relogio = relogio;
   self->estado = parado;
+  self->funcao_fim = NULL;
+  self->gravacao = NULL;
 
   return self;
 }
@@ -40,13 +53,28 @@ void controle_destroi(controle_t *self)
   free(self);
 }
 
+void controle_define_fim(controle_t *self, func_fim_t func, void *arg)
+{
+  self->funcao_fim = func;
+  self->arg_fim = arg;
+}
+
+void controle_define_gravacao(controle_t *self, gravacao_t *gravacao)
+{
+  self->gravacao = gravacao;
+}
+
 void controle_laco(controle_t *self)
 {
-  // executa uma instrução por vez até a console dizer que chega
+  // executa sequências de instruções até a console dizer que chega
   do {
+    if (self->gravacao != NULL) gravacao_nova_iteracao(self->gravacao);
     if (self->estado == passo || self->estado == executando) {
-      cpu_executa_1(self->cpu);
-      relogio_tictac(self->relogio);
+      int n = controle_passos_a_executar(self);
+      int executadas = cpu_executa_n(self->cpu, n);
+      // com a CPU parada, o tempo passa mesmo sem executar instruções
+      if (executadas == 0) executadas = controle_tempo_ocioso(self);
+      relogio_avanca(self->relogio, executadas);
 
       if (self->estado == passo) self->estado = parado;
 
@@ -57,21 +85,69 @@ void controle_laco(controle_t *self)
       if (tem_int != 0) {
         cpu_interrompe(self->cpu, IRQ_RELOGIO);
       }
+
+      if (self->funcao_fim != NULL && self->funcao_fim(self->arg_fim)) {
+        self->estado = fim;
+      }
     }
-    console_tictac(self->console);
+    // os terminais não precisam de um tic por instrução: o que acontece
+    //   neles com o passar do tempo está na agenda do relógio
+    console_atualiza(self->console);
 
     controle_processa_comandos_da_console(self);
     controle_atualiza_estado_na_console(self);
   } while (self->estado != fim);
 
-  console_printf("Fim da execução.");
-  console_printf("relógio: %d\n", relogio_agora(self->relogio));
+  if (self->gravacao != NULL && gravacao_divergiu(self->gravacao)) {
+    log_erro(self->console, "a execução não seguiu a gravação reproduzida");
+  }
+  log_info(self->console, "Fim da execução.");
+  log_info(self->console, "relógio: %d\n", relogio_agora(self->relogio));
 }
  
 
+// calcula quantas instruções executar antes de verificar interrupções e a
+//   console: até o instante do próximo evento da agenda do relógio (como o
+//   timer, que pede interrupção)
+static int controle_passos_a_executar(controle_t *self)
+{
+  if (self->estado == passo) return 1;
+  // se tem uma interrupção que a CPU ainda não aceitou, tenta de novo após
+  //   cada instrução
+  int tem_int;
+  relogio_leitura(self->relogio, 3, &tem_int);
+  if (tem_int != 0) return 1;
+  int t_ate_evento = relogio_ate_proximo_evento(self->relogio);
+  if (t_ate_evento == 0 || t_ate_evento > MAX_PASSOS) return MAX_PASSOS;
+  return t_ate_evento;
+}
+
+// calcula quanto tempo passa em uma iteração em que a CPU não executou
+//   nenhuma instrução (está parada esperando interrupção)
+// o único dispositivo que gera interrupção é o relógio, e as entradas dos
+//   terminais só são vistas pela CPU quando ela volta a executar; então
+//   nada muda até o próximo evento da agenda, e o relógio já pode avançar
+//   direto até lá, em vez de um tic por iteração
+static int controle_tempo_ocioso(controle_t *self)
+{
+  // no passo a passo, o tempo anda de 1 em 1, para o operador ver
+  if (self->estado == passo) return 1;
+  int t_ate_evento = relogio_ate_proximo_evento(self->relogio);
+  // sem evento na agenda, a CPU só sai dessa por ação do operador
+  if (t_ate_evento == 0) return 1;
+  return t_ate_evento;
+}
+
 static void controle_processa_comandos_da_console(controle_t *self)
 {
   char cmd = console_comando_externo(self->console);
+  if (self->gravacao != NULL) {
+    if (gravacao_reproduzindo(self->gravacao)) {
+      if (cmd != 'F') cmd = gravacao_comando(self->gravacao);
+    } else if (cmd != '\0') {
+      gravacao_registra_comando(self->gravacao, cmd);
+    }
+  }
   switch (cmd) {
     case 'F':
       self->estado = fim;
@@ -85,12 +161,15 @@ static void controle_processa_comandos_da_console(controle_t *self)
     case 'C':
       self->estado = executando;
       break;
+    case 'T':
+      cpu_grava_trilha(self->cpu);
+      break;
   }
 }
 
 static void controle_atualiza_estado_na_console(controle_t *self)
 {
-  char status[100];
+  char status[120];
   switch (self->estado) {
     case fim:        strcpy(status, "FIM    | "); break;
     case parado:     strcpy(status, "PARADO | "); break;
@@ -11,10 +11,26 @@ typedef struct controle_t controle_t;
 #include "cpu.h"
 #include "console.h"
 #include "relogio.h"
+#include "gravacao.h"
 
 controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio);
 void controle_destroi(controle_t *self);
 
+// tipo da função que diz se a simulação terminou
+typedef bool (*func_fim_t)(void *arg);
+
+// define uma função a chamar após cada sequência de instruções, e o argumento
+//   a passar para ela; se ela retornar true, a simulação termina sem esperar
+//   comando da console (normalmente, a função é do SO, para terminar quando
+//   não tiver mais processos)
+void controle_define_fim(controle_t *self, func_fim_t func, void *arg);
+
+// define a gravação onde são registrados os comandos do operador, ou de onde
+//   eles são reproduzidos (NULL para nenhuma)
+// na reprodução, só o comando de fim é aceito do operador; os demais vêm da
+//   gravação
+void controle_define_gravacao(controle_t *self, gravacao_t *gravacao);
+
 // o laço principal da simulação
 void controle_laco(controle_t *self);
 
@@ -7,20 +7,57 @@
 #include "cpu.h"
 #include "err.h"
 #include "instrucao.h"
+#include "jit.h"
+#include "perfil.h"
+#include "trilha.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
 // DECLARAÇÃO {{{1
+
+// cache de instruções predecodificadas, usada pelos motores CPU_MOTOR_PREDECOD
+//   e CPU_MOTOR_JIT
+// é organizada em linhas de PRE_TAM_LINHA palavras consecutivas da memória
+//   física, com mapeamento direto (a linha n da memória só pode estar na
+//   posição n % PRE_N_LINHAS da cache)
+// uma escrita na memória invalida a linha que contém o endereço alterado
+#define PRE_TAM_LINHA 8
+#define PRE_N_LINHAS  512
+// número de traduções de páginas de código lembradas durante uma sequência
+#define PRE_N_PAGINAS 16
+
+// uma instrução decodificada
+typedef struct {
+  bool valida;
+  // índice do tratador da instrução (o opcode, ou N_OPCODE se inválido)
+  int opcode;
+  // número de palavras ocupadas pela instrução (1 ou 2)
+  int tam;
+  // argumento da instrução, se tem_A1
+  // o argumento não é guardado se estiver em outra página
+  bool tem_A1;
+  int A1;
+} pre_instrucao_t;
+
+typedef struct {
+  // número da linha da memória física que está nesta linha da cache, ou -1
+  int num;
+  pre_instrucao_t instrucao[PRE_TAM_LINHA];
+} pre_linha_t;
+
 // uma CPU tem estado, memória, controlador de ES
 struct cpu_t {
   // registradores
   int PC;
   int A;
   int X;
+  // topo da pilha (endereço do último valor empilhado)
+  int SP;
   // estado interno da CPU
   err_t erro;
   int complemento;
@@ -33,8 +70,43 @@ struct cpu_t {
   // função e argumento para implementar instrução CHAMAC
   func_chamaC_t funcaoC;
   void *argC;
+  // onde o estado é salvo nas interrupções, e o banco de registradores de
+  //   sombra
+  cpu_salvamento_t salvamento;
+  cpu_estado_t banco;
+  // motor de execução das instruções
+  cpu_motor_t motor;
+  // argumento da instrução no PC, se já foi lido junto com o opcode
+  bool tem_A1;
+  int A1;
+  // número máximo de passos que a instrução sendo executada pode usar, e
+  //   quantos ela usou além do primeiro (só as instruções de bloco usam mais
+  //   de um, um por palavra)
+  int orcamento;
+  int passos_extras;
+  // cache de instruções predecodificadas
+  pre_linha_t cache[PRE_N_LINHAS];
+  // páginas de código traduzidas na sequência de instruções corrente, e o
+  //   endereço físico do início delas
+  // a tradução não muda durante uma sequência, porque a tabela de páginas só
+  //   é alterada pelo SO, que só executa após uma mudança de modo
+  // uma entrada só vale se foi preenchida na sequência número 'sequencia'
+  unsigned long sequencia;
+  struct {
+    unsigned long sequencia;
+    int pagina;
+    int inicio_quadro;
+  } pre_traducao[PRE_N_PAGINAS];
+  // tradutor para código nativo do motor CPU_MOTOR_JIT (NULL se não tem)
+  jit_t *jit;
+  // perfil de execução (NULL se não tem)
+  perfil_t *perfil;
+  // trilha das instruções executadas (NULL se não tem)
+  trilha_t *trilha;
 };
 
+static void cpu__memoria_alterada(void *arg, int endereco);
+
 // CRIAÇÃO {{{1
 cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
 {
@@ -48,10 +120,27 @@ cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
   self->PC = 0;
   self->A = 0;
   self->X = 0;
+  self->SP = 0;
   self->erro = ERR_OK;
   self->complemento = 0;
   self->modo = usuario;
   self->funcaoC = NULL;
+  self->salvamento = CPU_SALVA_NA_MEMORIA;
+  memset(&self->banco, 0, sizeof(self->banco));
+  self->motor = CPU_MOTOR_SWITCH;
+  self->tem_A1 = false;
+  self->orcamento = 1;
+  self->passos_extras = 0;
+  self->jit = NULL;
+  self->perfil = NULL;
+  self->trilha = NULL;
+  self->sequencia = 0;
+  memset(self->pre_traducao, 0, sizeof(self->pre_traducao));
+  // inicializa a cache, e pede para ser avisado das alterações na memória
+  for (int l = 0; l < PRE_N_LINHAS; l++) {
+    self->cache[l].num = -1;
+  }
+  mem_define_observador(mmu_memoria(mmu), cpu__memoria_alterada, self);
   // inicializa instruções privilegiadas
   memset(self->privilegiadas, 0, sizeof(self->privilegiadas));
   self->privilegiadas[PARA] = true;
@@ -68,6 +157,8 @@ cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
 void cpu_destroi(cpu_t *self)
 {
   // eu nao criei MMU nem es; quem criou que destrua!
+  mem_define_observador(mmu_memoria(self->mmu), NULL, NULL);
+  if (self->jit != NULL) jit_destroi(self->jit);
   free(self);
 }
 
@@ -77,12 +168,85 @@ void cpu_define_chamaC(cpu_t *self, func_chamaC_t funcaoC, void *argC)
   self->argC = argC;
 }
 
+// copia o estado salvo na memória para o banco, ou vice-versa
+static void copia_da_memoria(cpu_t *self, cpu_estado_t *estado);
+static void copia_para_memoria(cpu_t *self, cpu_estado_t *estado);
+
+void cpu_define_salvamento(cpu_t *self, cpu_salvamento_t onde)
+{
+  if (onde == self->salvamento) return;
+  // os acessos à memória alteram o erro, que não pode mudar aqui
+  err_t erro = self->erro;
+  int complemento = self->complemento;
+  cpu_modo_t modo = self->modo;
+  // os endereços IRQ_END_* são físicos
+  self->modo = supervisor;
+  if (onde == CPU_SALVA_NO_BANCO) {
+    copia_da_memoria(self, &self->banco);
+  } else {
+    copia_para_memoria(self, &self->banco);
+  }
+  self->modo = modo;
+  self->erro = erro;
+  self->complemento = complemento;
+  self->salvamento = onde;
+}
+
+cpu_estado_t *cpu_estado_salvo(cpu_t *self)
+{
+  return &self->banco;
+}
+
+static jit_t *cpu__cria_jit(cpu_t *self);
+
+void cpu_define_motor(cpu_t *self, cpu_motor_t motor)
+{
+  assert(motor >= 0 && motor < N_CPU_MOTOR);
+  self->motor = motor;
+  if (motor == CPU_MOTOR_JIT && self->jit == NULL) {
+    self->jit = cpu__cria_jit(self);
+  }
+}
+
+void cpu_define_perfil(cpu_t *self, perfil_t *perfil)
+{
+  self->perfil = perfil;
+}
+
+perfil_t *cpu_perfil(cpu_t *self)
+{
+  return self->perfil;
+}
+
+void cpu_define_trilha(cpu_t *self, trilha_t *trilha)
+{
+  self->trilha = trilha;
+}
+
+void cpu_grava_trilha(cpu_t *self)
+{
+  if (self->trilha != NULL) trilha_grava(self->trilha);
+}
+
+cpu_motor_t cpu_motor_do_nome(char *nome)
+{
+  static char *nomes[N_CPU_MOTOR] = {
+    [CPU_MOTOR_SWITCH] = "switch",
+    [CPU_MOTOR_PREDECOD] = "predecod",
+    [CPU_MOTOR_JIT]      = "jit",
+  };
+  for (cpu_motor_t motor = 0; motor < N_CPU_MOTOR; motor++) {
+    if (strcmp(nome, nomes[motor]) == 0) return motor;
+  }
+  return -1;
+}
+
 // IMPRESSÃO {{{1
 static void imprime_registradores(cpu_t *self, char *str)
 {
-  sprintf(str, "%s PC=%04d A=%06d X=%06d",
+  sprintf(str, "%s PC=%04d A=%06d X=%06d SP=%04d",
                 self->modo == supervisor ? "SUP " : "usu ",
-                self->PC, self->A, self->X);
+                self->PC, self->A, self->X, self->SP);
 }
 
 static void imprime_instrucao(cpu_t *self, char *str)
@@ -114,7 +278,7 @@ static void imprime_erro(cpu_t *self, char *str)
 
 void cpu_concatena_descricao(cpu_t *self, char *str)
 {
-  char aux[40];
+  char aux[60];
 
   imprime_registradores(self, aux);
   strcat(str, aux);
@@ -132,8 +296,8 @@ void cpu_concatena_descricao(cpu_t *self, char *str)
 // funções auxiliares para usar durante a execução das instruções
 // alteram o estado da CPU caso ocorra erro
 
-// lê um valor da memória
-static bool pega_mem(cpu_t *self, int endereco, int *pval)
+// lê um valor da memória, para a busca da instrução
+static bool busca_mem(cpu_t *self, int endereco, int *pval)
 {
   self->erro = mmu_le(self->mmu, endereco, pval, self->modo);
   if (self->erro == ERR_OK) return true;
@@ -141,13 +305,21 @@ static bool pega_mem(cpu_t *self, int endereco, int *pval)
   return false;
 }
 
+// lê um valor da memória (acesso a dados, contado no perfil)
+static bool pega_mem(cpu_t *self, int endereco, int *pval)
+{
+  if (self->perfil != NULL) perfil_conta_leitura(self->perfil);
+  return busca_mem(self, endereco, pval);
+}
+
 // lê o opcode da instrução no PC
 // retorna true se ele pode ser executado, ou põe em erro o motivo de não poder
 static bool pega_opcode(cpu_t *self, int *popc)
 {
   // não tem que testar endereços, é tarefa da mmu
   // não pode executar se houver erro na leitura da memória
-  if (!pega_mem(self, self->PC, popc)) return false;
+  self->tem_A1 = false;
+  if (!busca_mem(self, self->PC, popc)) return false;
   // pode executar se tiver privilégio para isso
   if (self->modo == supervisor || !self->privilegiadas[*popc]) return true;
   // não pode executar instrução privilegiada em modo usuário
@@ -156,20 +328,54 @@ static bool pega_opcode(cpu_t *self, int *popc)
 }
 
 // lê o argumento 1 da instrução no PC
+// o motor predecod pode já ter o argumento, decodificado junto com o opcode
 static bool pega_A1(cpu_t *self, int *pA1)
 {
-  return pega_mem(self, self->PC + 1, pA1);
+  if (self->tem_A1) {
+    *pA1 = self->A1;
+    return true;
+  }
+  return busca_mem(self, self->PC + 1, pA1);
 }
 
 // escreve um valor na memória
 static bool poe_mem(cpu_t *self, int endereco, int val)
 {
+  if (self->perfil != NULL) perfil_conta_escrita(self->perfil);
   self->erro = mmu_escreve(self->mmu, endereco, val, self->modo);
   if (self->erro == ERR_OK) return true;
   self->complemento = endereco;
   return false;
 }
 
+// lê 'n' valores de posições consecutivas da memória, a partir de 'endereco'
+static bool pega_bloco(cpu_t *self, int endereco, int n, int valores[n])
+{
+  if (self->perfil != NULL) {
+    for (int i = 0; i < n; i++) perfil_conta_leitura(self->perfil);
+  }
+  int lidos;
+  self->erro = mmu_le_bloco(self->mmu, endereco, n, valores, &lidos, self->modo);
+  if (self->erro == ERR_OK) return true;
+  self->complemento = endereco + lidos;
+  return false;
+}
+
+// escreve 'n' valores em posições consecutivas da memória, a partir de
+//   'endereco'
+static bool poe_bloco(cpu_t *self, int endereco, int n, int valores[n])
+{
+  if (self->perfil != NULL) {
+    for (int i = 0; i < n; i++) perfil_conta_escrita(self->perfil);
+  }
+  int escritos;
+  self->erro = mmu_escreve_bloco(self->mmu, endereco, n, valores, &escritos,
+                                 self->modo);
+  if (self->erro == ERR_OK) return true;
+  self->complemento = endereco + escritos;
+  return false;
+}
+
 // lê um valor da E/S
 static bool pega_es(cpu_t *self, int dispositivo, int *pval)
 {
@@ -396,6 +602,50 @@ static void op_ESCR(cpu_t *self) // escrita de E/S
   }
 }
 
+static void op_PUSH(cpu_t *self) // empilha
+{
+  if (poe_mem(self, self->SP - 1, self->A)) {
+    self->SP -= 1;
+    self->PC += 1;
+  }
+}
+
+static void op_POP(cpu_t *self) // desempilha
+{
+  int topo;
+  if (pega_mem(self, self->SP, &topo)) {
+    self->A = topo;
+    self->SP += 1;
+    self->PC += 1;
+  }
+}
+
+static void op_CALL(cpu_t *self) // chamada de subrotina com pilha
+{
+  int A1;
+  if (pega_A1(self, &A1) && poe_mem(self, self->SP - 1, self->PC + 2)) {
+    self->SP -= 1;
+    self->PC = A1;
+  }
+}
+
+static void op_RETS(cpu_t *self) // retorno de subrotina com pilha
+{
+  int topo;
+  if (pega_mem(self, self->SP, &topo)) {
+    self->SP += 1;
+    self->PC = topo;
+  }
+}
+
+static void op_TRASP(cpu_t *self) // troca A com SP
+{
+  int A = self->A;
+  self->A = self->SP;
+  self->SP = A;
+  self->PC += 1;
+}
+
 // declara uma função auxiliar (só para a interrupção e o retorno ficarem perto)
 static void cpu_desinterrompe(cpu_t *self);
 
@@ -422,6 +672,78 @@ static void op_CHAMAS(cpu_t *self) // chamada de sistema
 
 }
 
+// INSTRUÇÕES DE BLOCO {{{2
+// tratam as palavras da última para a primeira, em pedaços que não passam do
+//   início de uma página (uma tradução de endereço por pedaço), e sem passar
+//   do orçamento de passos da instrução
+// A é decrementado a cada pedaço completo; se um pedaço causa erro (como uma
+//   falta de página), nada dele é alterado, e a instrução pode ser executada
+//   de novo a partir daí
+
+// número de palavras do início da página até 'endereco', inclusive
+static int ate_inicio_da_pagina(int endereco)
+{
+  if (endereco < 0) return 1;
+  return endereco % TAM_PAGINA + 1;
+}
+
+static int menor(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+// termina uma instrução de bloco que tratou 'feitos' palavras
+static void termina_bloco(cpu_t *self, int feitos)
+{
+  if (self->A <= 0 && self->erro == ERR_OK) self->PC += 2;
+  if (feitos > 1) self->passos_extras = feitos - 1;
+}
+
+static void op_MOVB(cpu_t *self) // move bloco
+{
+  int A1;
+  if (!pega_A1(self, &A1)) return;
+  // copiando da última palavra para a primeira, um destino que começa antes
+  //   da origem e se sobrepõe a ela estragaria a origem antes de ser copiada
+  // se a instrução foi interrompida, A diminuiu, e a condição continua falsa
+  if (A1 < self->X && self->X < A1 + self->A) {
+    self->erro = ERR_OP_INV;
+    return;
+  }
+  int valores[TAM_PAGINA];
+  int feitos = 0;
+  while (self->A > 0 && feitos < self->orcamento) {
+    int origem = self->X + self->A - 1;
+    int destino = A1 + self->A - 1;
+    int n = menor(self->A, self->orcamento - feitos);
+    n = menor(n, ate_inicio_da_pagina(origem));
+    n = menor(n, ate_inicio_da_pagina(destino));
+    if (!pega_bloco(self, origem - n + 1, n, valores)) break;
+    if (!poe_bloco(self, destino - n + 1, n, valores)) break;
+    self->A -= n;
+    feitos += n;
+  }
+  termina_bloco(self, feitos);
+}
+
+static void op_PREB(cpu_t *self) // preenche bloco
+{
+  int A1;
+  if (!pega_A1(self, &A1)) return;
+  int valores[TAM_PAGINA];
+  for (int i = 0; i < TAM_PAGINA; i++) valores[i] = self->X;
+  int feitos = 0;
+  while (self->A > 0 && feitos < self->orcamento) {
+    int destino = A1 + self->A - 1;
+    int n = menor(self->A, self->orcamento - feitos);
+    n = menor(n, ate_inicio_da_pagina(destino));
+    if (!poe_bloco(self, destino - n + 1, n, valores)) break;
+    self->A -= n;
+    feitos += n;
+  }
+  termina_bloco(self, feitos);
+}
+
 // EXECUTA UMA INSTRUÇÃO {{{1
 
 static void executa_a_instrucao(cpu_t *self, int opcode)
@@ -455,29 +777,527 @@ static void executa_a_instrucao(cpu_t *self, int opcode)
     case RETI:   op_RETI(self);   break;
     case CHAMAC: op_CHAMAC(self); break;
     case CHAMAS: op_CHAMAS(self); break;
+    case MOVB:   op_MOVB(self);   break;
+    case PREB:   op_PREB(self);   break;
+    case PUSH:   op_PUSH(self);   break;
+    case POP:    op_POP(self);    break;
+    case CALL:   op_CALL(self);   break;
+    case RETS:   op_RETS(self);   break;
+    case TRASP:  op_TRASP(self);  break;
     default:     self->erro = ERR_INSTR_INV;
   }
 }
 
+// se a CPU entrou em erro, causa uma interrupção
+// a menos que a CPU tenha parado, porque a única forma de a CPU entrar nesse
+//   estado é pela execução da instrução PARA em modo supervisor, e é a forma de
+//   o SO dizer que não tem mais nada para fazer, e deve-se deixar a CPU dormindo
+//   até que venha uma interrupção de E/S
+static void cpu__trata_erro(cpu_t *self)
+{
+  if (self->erro != ERR_OK && self->erro != ERR_CPU_PARADA) {
+    // se a interrupção não é aceita nesse ponto, temos um problema grave...
+    assert(cpu_interrompe(self, IRQ_ERR_CPU));
+  }
+}
+
+// retorna true se a instrução acessa dispositivos (ou o SO)
+// essas instruções só são executadas como primeira de uma sequência, para que
+//   os dispositivos sejam acessados no mesmo instante, qualquer que seja o
+//   tamanho das sequências
+static bool instrucao_de_es(int opcode)
+{
+  return opcode == LE || opcode == ESCR || opcode == CHAMAC;
+}
+
+// executa até 'n' instruções com o switch, retorna quantas executou
+static int cpu__executa_switch(cpu_t *self, int n)
+{
+  int passos = 0;
+  cpu_modo_t modo = self->modo;
+  while (passos < n && self->erro == ERR_OK && self->modo == modo) {
+    int opcode;
+    if (pega_opcode(self, &opcode)) {
+      if (passos > 0 && instrucao_de_es(opcode)) break;
+      self->orcamento = n - passos;
+      executa_a_instrucao(self, opcode);
+    }
+    cpu__trata_erro(self);
+    passos += 1 + self->passos_extras;
+    self->passos_extras = 0;
+  }
+  return passos;
+}
+
+// registra na trilha a instrução que foi executada, com o PC, o A1 e o modo
+//   de antes da execução em 'reg'
+// se a instrução causou erro, grava a trilha, para não perder o que levou a ele
+static void cpu__registra_na_trilha(cpu_t *self, trilha_reg_t *reg, int opcode)
+{
+  reg->opcode = opcode;
+  reg->A = self->A;
+  reg->X = self->X;
+  reg->erro = self->erro;
+  reg->reservado = 0;
+  trilha_registra(self->trilha, reg);
+  if (self->erro != ERR_OK && self->erro != ERR_CPU_PARADA) {
+    trilha_grava(self->trilha);
+  }
+}
+
+// executa até 'n' instruções como o motor switch, contando cada uma no perfil
+//   e registrando na trilha (se tiver cada um deles)
+static int cpu__executa_instrumentado(cpu_t *self, int n)
+{
+  int passos = 0;
+  cpu_modo_t modo = self->modo;
+  while (passos < n && self->erro == ERR_OK && self->modo == modo) {
+    int opcode = -1;
+    trilha_reg_t reg = { .PC = self->PC, .A1 = 0, .modo = self->modo };
+    if (pega_opcode(self, &opcode)) {
+      if (passos > 0 && instrucao_de_es(opcode)) break;
+      if (self->trilha != NULL && instrucao_num_args(opcode) == 1) {
+        // se não der para ler, a execução vai dar o mesmo erro
+        mmu_le(self->mmu, self->PC + 1, &reg.A1, self->modo);
+      }
+      if (self->perfil != NULL) {
+        // a busca deu certo, então a tradução do PC também dá
+        int pc_fis;
+        mmu_traduz(self->mmu, self->PC, &pc_fis, self->modo);
+        perfil_inicia_instrucao(self->perfil, opcode, pc_fis, self->PC,
+                                self->modo == usuario);
+      }
+      self->orcamento = n - passos;
+      executa_a_instrucao(self, opcode);
+      if (self->perfil != NULL) perfil_termina_instrucao(self->perfil);
+    }
+    if (self->trilha != NULL) cpu__registra_na_trilha(self, &reg, opcode);
+    cpu__trata_erro(self);
+    passos += 1 + self->passos_extras;
+    self->passos_extras = 0;
+  }
+  return passos;
+}
+
+// MOTOR PREDECOD {{{1
+
+// Despacho direto ("direct threaded code"): o código de cada instrução termina
+//   buscando a instrução seguinte e desviando diretamente para o código dela,
+//   sem voltar para um switch central. Com gcc usa desvio para endereço de
+//   rótulo (&&rotulo), nos outros compiladores usa uma tabela de funções.
+// A busca pega a instrução já decodificada da cache, sem acessar a memória.
+// O resultado é o mesmo do motor switch, inclusive no fim das sequências de
+//   instruções.
+
+// CACHE DE INSTRUÇÕES {{{2
+
+static void pre_invalida_linha(cpu_t *self, int num_linha)
+{
+  pre_linha_t *linha = &self->cache[num_linha % PRE_N_LINHAS];
+  if (linha->num == num_linha) linha->num = -1;
+}
+
+// chamada pela memória a cada escrita
+// invalida a linha que contém o endereço, e também a anterior se o endereço
+//   for o argumento da última instrução dela
+static void cpu__memoria_alterada(void *arg, int endereco)
+{
+  cpu_t *self = arg;
+  int num_linha = endereco / PRE_TAM_LINHA;
+  pre_invalida_linha(self, num_linha);
+  if (endereco % PRE_TAM_LINHA == 0 && num_linha > 0) {
+    pre_linha_t *anterior = &self->cache[(num_linha - 1) % PRE_N_LINHAS];
+    pre_instrucao_t *ultima = &anterior->instrucao[PRE_TAM_LINHA - 1];
+    if (anterior->num == num_linha - 1 && ultima->valida && ultima->tam == 2) {
+      anterior->num = -1;
+    }
+  }
+  if (self->jit != NULL) jit_memoria_alterada(self->jit, endereco);
+}
+
+// decodifica a instrução que está no endereço físico 'endfis', cujo
+//   endereço virtual é o PC
+static void pre_decodifica(cpu_t *self, pre_instrucao_t *instr, int endfis)
+{
+  int opcode;
+  // a tradução do PC deu certo, então o acesso ao endereço físico também dá
+  mmu_le(self->mmu, endfis, &opcode, supervisor);
+  int num_args = instrucao_num_args(opcode);
+  if (opcode < 0 || opcode >= N_OPCODE || num_args < 0) {
+    instr->opcode = N_OPCODE;
+    instr->tam = 1;
+  } else {
+    instr->opcode = opcode;
+    instr->tam = 1 + num_args;
+  }
+  // o argumento só está no endereço físico seguinte se estiver na mesma página
+  instr->tem_A1 = false;
+  if (instr->tam == 2 && self->PC >= 0 && (self->PC + 1) % TAM_PAGINA != 0) {
+    instr->tem_A1 = mmu_le(self->mmu, endfis + 1, &instr->A1, supervisor) == ERR_OK;
+  }
+  instr->valida = true;
+}
+
+// esquece as traduções de páginas de código, no início de uma sequência
+static void pre_esquece_traducoes(cpu_t *self)
+{
+  self->sequencia++;
+}
+
+// traduz o PC para endereço físico, como na leitura da instrução
+static err_t traduz_pc(cpu_t *self, int *pendfis)
+{
+  int pagina = self->PC / TAM_PAGINA;
+  int i = pagina % PRE_N_PAGINAS;
+  if (self->PC >= 0 && pagina == self->pre_traducao[i].pagina
+      && self->pre_traducao[i].sequencia == self->sequencia) {
+    // a página já foi traduzida (e marcada como acessada) nesta sequência
+    *pendfis = self->pre_traducao[i].inicio_quadro + self->PC % TAM_PAGINA;
+    return ERR_OK;
+  }
+  err_t err = mmu_traduz(self->mmu, self->PC, pendfis, self->modo);
+  if (err != ERR_OK) return err;
+  // só lembra da página se ela estiver toda dentro da memória
+  int inicio_quadro = *pendfis - self->PC % TAM_PAGINA;
+  if (self->PC >= 0 &&
+      inicio_quadro + TAM_PAGINA <= mem_tam(mmu_memoria(self->mmu))) {
+    self->pre_traducao[i].sequencia = self->sequencia;
+    self->pre_traducao[i].pagina = pagina;
+    self->pre_traducao[i].inicio_quadro = inicio_quadro;
+  }
+  return ERR_OK;
+}
+
+// obtém a instrução no PC da cache, decodificando se ela não estiver lá
+// o argumento vem junto (em self->A1) se estiver na mesma página que o opcode
+static bool le_instrucao_da_cache(cpu_t *self, int *popc)
+{
+  int endfis;
+  err_t err = traduz_pc(self, &endfis);
+  if (err != ERR_OK) {
+    self->erro = err;
+    self->complemento = self->PC;
+    return false;
+  }
+  int num_linha = endfis / PRE_TAM_LINHA;
+  pre_linha_t *linha = &self->cache[num_linha % PRE_N_LINHAS];
+  if (linha->num != num_linha) {
+    linha->num = num_linha;
+    for (int i = 0; i < PRE_TAM_LINHA; i++) {
+      linha->instrucao[i].valida = false;
+    }
+  }
+  pre_instrucao_t *instr = &linha->instrucao[endfis % PRE_TAM_LINHA];
+  if (!instr->valida) {
+    pre_decodifica(self, instr, endfis);
+  }
+  *popc = instr->opcode;
+  self->tem_A1 = instr->tem_A1;
+  self->A1 = instr->A1;
+  return true;
+}
+
+// BUSCA {{{2
+
+// busca a instrução no PC, para executar como a 'passos'-ésima de uma sequência
+// retorna false se a sequência deve terminar antes dessa instrução
+// em caso de erro na busca, trata o erro e conta a tentativa em '*ppassos'
+// uma instrução de bloco pode usar até 'limite' passos na sequência
+#ifdef __GNUC__
+// a busca é chamada no final de cada tratador; se o compilador expandir ela
+//   em cada um, o código fica tão grande que o despacho fica mais lento
+__attribute__((noinline))
+#endif
+static bool busca_instrucao(cpu_t *self, int *popc, int *ppassos, int n,
+                            int limite, cpu_modo_t modo)
+{
+  if (*ppassos >= n || self->erro != ERR_OK || self->modo != modo) return false;
+  if (le_instrucao_da_cache(self, popc)) {
+    if (*popc < 0 || *popc >= N_OPCODE) {
+      *popc = N_OPCODE;  // vai ser tratado como instrução inválida
+    } else if (self->modo == usuario && self->privilegiadas[*popc]) {
+      self->erro = ERR_INSTR_PRIV;
+    } else if (instrucao_de_es(*popc) && *ppassos > 0) {
+      self->tem_A1 = false;
+      return false;
+    }
+  }
+  if (self->erro == ERR_OK) {
+    self->orcamento = limite - *ppassos;
+    return true;
+  }
+  // a busca não deu certo, conta a tentativa como uma instrução executada
+  self->tem_A1 = false;
+  cpu__trata_erro(self);
+  (*ppassos)++;
+  return false;
+}
+
+// EXECUÇÃO {{{2
+
+// executa instruções com o motor predecod, até completar 'n' passos em uma
+//   sequência na qual 'passos' instruções já foram executadas
+// uma instrução de bloco pode continuar até 'limite' passos (>= n)
+// retorna o número de passos da sequência depois da execução
+#ifdef __GNUC__
+static int cpu__executa_predecod(cpu_t *self, int passos, int n, int limite)
+{
+  static void *tratador[N_OPCODE + 1] = {
+    [NOP]    = &&t_NOP,    [PARA]   = &&t_PARA,   [CARGI]  = &&t_CARGI,
+    [CARGM]  = &&t_CARGM,  [CARGX]  = &&t_CARGX,  [ARMM]   = &&t_ARMM,
+    [ARMX]   = &&t_ARMX,   [TRAX]   = &&t_TRAX,   [CPXA]   = &&t_CPXA,
+    [INCX]   = &&t_INCX,   [SOMA]   = &&t_SOMA,   [SUB]    = &&t_SUB,
+    [MULT]   = &&t_MULT,   [DIV]    = &&t_DIV,    [RESTO]  = &&t_RESTO,
+    [NEG]    = &&t_NEG,    [DESV]   = &&t_DESV,   [DESVZ]  = &&t_DESVZ,
+    [DESVNZ] = &&t_DESVNZ, [DESVN]  = &&t_DESVN,  [DESVP]  = &&t_DESVP,
+    [CHAMA]  = &&t_CHAMA,  [RET]    = &&t_RET,    [LE]     = &&t_LE,
+    [ESCR]   = &&t_ESCR,   [CHAMAS] = &&t_CHAMAS, [RETI]   = &&t_RETI,
+    [CHAMAC] = &&t_CHAMAC, [MOVB]   = &&t_MOVB,   [PREB]   = &&t_PREB,
+    [PUSH]   = &&t_PUSH,   [POP]    = &&t_POP,    [CALL]   = &&t_CALL,
+    [RETS]   = &&t_RETS,   [TRASP]  = &&t_TRASP,
+    // pseudo-instruções e opcodes fora da faixa
+    [VALOR]  = &&t_INV,    [STRING] = &&t_INV,    [ESPACO] = &&t_INV,
+    [DEFINE] = &&t_INV,    [N_OPCODE] = &&t_INV,
+  };
+  int opcode;
+  cpu_modo_t modo = self->modo;
+
+  // busca a instrução seguinte e desvia para o seu tratador
+  #define DESPACHA()                                               \
+    do {                                                           \
+      if (!busca_instrucao(self, &opcode, &passos, n, limite, modo)) { \
+        return passos;                                             \
+      }                                                            \
+      goto *tratador[opcode];                                      \
+    } while (0)
+  // termina a instrução corrente e despacha a seguinte
+  #define PROXIMA()                                                \
+    do {                                                           \
+      self->tem_A1 = false;                                        \
+      cpu__trata_erro(self);                                       \
+      passos++;                                                    \
+      DESPACHA();                                                  \
+    } while (0)
+
+  DESPACHA();
+
+  t_NOP:    op_NOP(self);    PROXIMA();
+  t_PARA:   op_PARA(self);   PROXIMA();
+  t_CARGI:  op_CARGI(self);  PROXIMA();
+  t_CARGM:  op_CARGM(self);  PROXIMA();
+  t_CARGX:  op_CARGX(self);  PROXIMA();
+  t_ARMM:   op_ARMM(self);   PROXIMA();
+  t_ARMX:   op_ARMX(self);   PROXIMA();
+  t_TRAX:   op_TRAX(self);   PROXIMA();
+  t_CPXA:   op_CPXA(self);   PROXIMA();
+  t_INCX:   op_INCX(self);   PROXIMA();
+  t_SOMA:   op_SOMA(self);   PROXIMA();
+  t_SUB:    op_SUB(self);    PROXIMA();
+  t_MULT:   op_MULT(self);   PROXIMA();
+  t_DIV:    op_DIV(self);    PROXIMA();
+  t_RESTO:  op_RESTO(self);  PROXIMA();
+  t_NEG:    op_NEG(self);    PROXIMA();
+  t_DESV:   op_DESV(self);   PROXIMA();
+  t_DESVZ:  op_DESVZ(self);  PROXIMA();
+  t_DESVNZ: op_DESVNZ(self); PROXIMA();
+  t_DESVN:  op_DESVN(self);  PROXIMA();
+  t_DESVP:  op_DESVP(self);  PROXIMA();
+  t_CHAMA:  op_CHAMA(self);  PROXIMA();
+  t_RET:    op_RET(self);    PROXIMA();
+  t_LE:     op_LE(self);     PROXIMA();
+  t_ESCR:   op_ESCR(self);   PROXIMA();
+  t_CHAMAS: op_CHAMAS(self); PROXIMA();
+  t_RETI:   op_RETI(self);   PROXIMA();
+  t_CHAMAC: op_CHAMAC(self); PROXIMA();
+  t_PUSH:   op_PUSH(self);   PROXIMA();
+  t_POP:    op_POP(self);    PROXIMA();
+  t_CALL:   op_CALL(self);   PROXIMA();
+  t_RETS:   op_RETS(self);   PROXIMA();
+  t_TRASP:  op_TRASP(self);  PROXIMA();
+  // as instruções de bloco podem usar mais de um passo
+  t_MOVB:   op_MOVB(self);   passos += self->passos_extras;
+            self->passos_extras = 0; PROXIMA();
+  t_PREB:   op_PREB(self);   passos += self->passos_extras;
+            self->passos_extras = 0; PROXIMA();
+  t_INV:    self->erro = ERR_INSTR_INV; PROXIMA();
+
+  #undef PROXIMA
+  #undef DESPACHA
+}
+#else
+static void op_INV(cpu_t *self) // instrução inválida
+{
+  self->erro = ERR_INSTR_INV;
+}
+
+static int cpu__executa_predecod(cpu_t *self, int passos, int n, int limite)
+{
+  static void (*tratador[N_OPCODE + 1])(cpu_t *self) = {
+    [NOP]    = op_NOP,    [PARA]   = op_PARA,   [CARGI]  = op_CARGI,
+    [CARGM]  = op_CARGM,  [CARGX]  = op_CARGX,  [ARMM]   = op_ARMM,
+    [ARMX]   = op_ARMX,   [TRAX]   = op_TRAX,   [CPXA]   = op_CPXA,
+    [INCX]   = op_INCX,   [SOMA]   = op_SOMA,   [SUB]    = op_SUB,
+    [MULT]   = op_MULT,   [DIV]    = op_DIV,    [RESTO]  = op_RESTO,
+    [NEG]    = op_NEG,    [DESV]   = op_DESV,   [DESVZ]  = op_DESVZ,
+    [DESVNZ] = op_DESVNZ, [DESVN]  = op_DESVN,  [DESVP]  = op_DESVP,
+    [CHAMA]  = op_CHAMA,  [RET]    = op_RET,    [LE]     = op_LE,
+    [ESCR]   = op_ESCR,   [CHAMAS] = op_CHAMAS, [RETI]   = op_RETI,
+    [CHAMAC] = op_CHAMAC, [MOVB]   = op_MOVB,   [PREB]   = op_PREB,
+    [PUSH]   = op_PUSH,   [POP]    = op_POP,    [CALL]   = op_CALL,
+    [RETS]   = op_RETS,   [TRASP]  = op_TRASP,
+    [VALOR]  = op_INV,    [STRING] = op_INV,    [ESPACO] = op_INV,
+    [DEFINE] = op_INV,    [N_OPCODE] = op_INV,
+  };
+  int opcode;
+  cpu_modo_t modo = self->modo;
+  while (busca_instrucao(self, &opcode, &passos, n, limite, modo)) {
+    tratador[opcode](self);
+    self->tem_A1 = false;
+    cpu__trata_erro(self);
+    passos += 1 + self->passos_extras;
+    self->passos_extras = 0;
+  }
+  return passos;
+}
+#endif
+
+// MOTOR JIT {{{1
+
+// Os blocos básicos de instruções são traduzidos para código nativo (ver
+//   jit.h). As instruções que não fazem parte de um bloco, e os blocos que
+//   não cabem no número de instruções que falta executar, são executados pelo
+//   motor predecod.
+
+// funções chamadas pelo código gerado para acessar a memória
+static int64_t jit__le(void *arg, int endereco)
+{
+  cpu_t *self = arg;
+  int valor;
+  if (!pega_mem(self, endereco, &valor)) return -1;
+  return (uint32_t)valor;
+}
+
+static jit_escr_t jit__escreve(void *arg, int endereco, int valor)
+{
+  cpu_t *self = arg;
+  if (!poe_mem(self, endereco, valor)) return JIT_ESCR_ERRO;
+  if (jit_descarte_pendente(self->jit)) return JIT_ESCR_DESCARTADO;
+  return JIT_ESCR_OK;
+}
+
+static jit_t *cpu__cria_jit(cpu_t *self)
+{
+  jit_cpu_t descricao = {
+    .desl_PC = offsetof(cpu_t, PC),
+    .desl_A = offsetof(cpu_t, A),
+    .desl_X = offsetof(cpu_t, X),
+    .le = jit__le,
+    .escreve = jit__escreve,
+  };
+  return jit_cria(mmu_memoria(self->mmu), &descricao);
+}
+
+// executa até 'n' instruções, retorna o número de instruções executadas
+// um bloco só é executado se couber inteiro nas instruções que faltam
+static int cpu__executa_jit(cpu_t *self, int n)
+{
+  int passos = 0;
+  cpu_modo_t modo = self->modo;
+  while (passos < n && self->erro == ERR_OK && self->modo == modo) {
+    int endfis;
+    int n_instrucoes;
+    jit_bloco_f bloco = NULL;
+    if (self->jit != NULL && traduz_pc(self, &endfis) == ERR_OK) {
+      bloco = jit_bloco(self->jit, endfis, &n_instrucoes);
+    }
+    if (bloco != NULL && n_instrucoes <= n - passos) {
+      passos += bloco(self);
+      cpu__trata_erro(self);
+    } else {
+      int antes = passos;
+      // uma instrução só, mas se for de bloco pode ir até o fim da sequência
+      passos = cpu__executa_predecod(self, passos, passos + 1, n);
+      // a instrução tem que ser a primeira de uma sequência (E/S)
+      if (passos == antes) break;
+    }
+  }
+  return passos;
+}
+
+// EXECUTA {{{1
+
 void cpu_executa_1(cpu_t *self)
+{
+  cpu_executa_n(self, 1);
+}
+
+int cpu_executa_n(cpu_t *self, int n)
 {
   // não executa se CPU já estiver em erro
-  if (self->erro != ERR_OK) return;
+  if (self->erro != ERR_OK) return 0;
+  pre_esquece_traducoes(self);
+  // com perfil ou trilha, todos os motores executam do mesmo jeito (o
+  //   resultado é o mesmo, só o desempenho muda)
+  if (self->perfil != NULL || self->trilha != NULL) {
+    return cpu__executa_instrumentado(self, n);
+  }
 
-  int opcode;
-  if (pega_opcode(self, &opcode)) {
-    executa_a_instrucao(self, opcode);
+  switch (self->motor) {
+    case CPU_MOTOR_PREDECOD:
+      return cpu__executa_predecod(self, 0, n, n);
+    case CPU_MOTOR_JIT:
+      return cpu__executa_jit(self, n);
+    default:
+      return cpu__executa_switch(self, n);
   }
+}
 
-  // se a CPU entrou em erro, causa uma interrupção
-  // a menos que a CPU tenha parado, porque a única forma de a CPU entrar nesse
-  //   estado é pela execução da instrução PARA em modo supervisor, e é a forma de
-  //   o SO dizer que não tem mais nada para fazer, e deve-se deixar a CPU dormindo
-  //   até que venha uma interrupção de E/S
-  if (self->erro != ERR_OK && self->erro != ERR_CPU_PARADA) {
-    // se a interrupção não é aceita nesse ponto, temos um problema grave...
-    assert(cpu_interrompe(self, IRQ_ERR_CPU));
+// CHECKPOINT {{{1
+
+void cpu_salva(cpu_t *self, ckpt_t *ckpt)
+{
+  int erro = self->erro;
+  int modo = self->modo;
+  int salvamento = self->salvamento;
+  ckpt_escreve(ckpt, &self->PC, sizeof(self->PC));
+  ckpt_escreve(ckpt, &self->A, sizeof(self->A));
+  ckpt_escreve(ckpt, &self->X, sizeof(self->X));
+  ckpt_escreve(ckpt, &self->SP, sizeof(self->SP));
+  ckpt_escreve(ckpt, &erro, sizeof(erro));
+  ckpt_escreve(ckpt, &self->complemento, sizeof(self->complemento));
+  ckpt_escreve(ckpt, &modo, sizeof(modo));
+  ckpt_escreve(ckpt, &salvamento, sizeof(salvamento));
+  ckpt_escreve(ckpt, &self->banco, sizeof(self->banco));
+}
+
+bool cpu_restaura(cpu_t *self, ckpt_t *ckpt)
+{
+  int erro, modo, salvamento;
+  ckpt_le(ckpt, &self->PC, sizeof(self->PC));
+  ckpt_le(ckpt, &self->A, sizeof(self->A));
+  ckpt_le(ckpt, &self->X, sizeof(self->X));
+  ckpt_le(ckpt, &self->SP, sizeof(self->SP));
+  ckpt_le(ckpt, &erro, sizeof(erro));
+  ckpt_le(ckpt, &self->complemento, sizeof(self->complemento));
+  ckpt_le(ckpt, &modo, sizeof(modo));
+  ckpt_le(ckpt, &salvamento, sizeof(salvamento));
+  if (!ckpt_le(ckpt, &self->banco, sizeof(self->banco))) return false;
+  if (erro < 0 || erro >= N_ERR || (modo != usuario && modo != supervisor)
+      || (salvamento != CPU_SALVA_NA_MEMORIA
+          && salvamento != CPU_SALVA_NO_BANCO)) {
+    return false;
   }
+  self->erro = erro;
+  self->modo = modo;
+  self->salvamento = salvamento;
+  // o que foi lido da memória antiga não vale mais
+  self->tem_A1 = false;
+  self->sequencia++;
+  for (int l = 0; l < PRE_N_LINHAS; l++) {
+    self->cache[l].num = -1;
+  }
+  if (self->jit != NULL) jit_descarta(self->jit);
+  return true;
 }
 
 // INTERRUPÇÃO {{{1
@@ -493,16 +1313,23 @@ bool cpu_interrompe(cpu_t *self, irq_t irq)
   //   acesso (para quando existir proteção de memória)
   self->modo = supervisor;
 
-  // esta é uma CPU boazinha, salva todo o estado interno da CPU no início da memória
+  // esta é uma CPU boazinha, salva todo o estado interno da CPU no início da
+  //   memória ou no banco de sombra
   // self->erro é alterado por poe_mem, copia antes!
-  int erro = self->erro;
-  int complemento = self->complemento;
-  poe_mem(self, IRQ_END_PC,          self->PC);
-  poe_mem(self, IRQ_END_A,           self->A);
-  poe_mem(self, IRQ_END_X,           self->X);
-  poe_mem(self, IRQ_END_erro,        erro);
-  poe_mem(self, IRQ_END_complemento, complemento);
-  poe_mem(self, IRQ_END_modo,        usuario);
+  cpu_estado_t estado = {
+    .PC = self->PC,
+    .A = self->A,
+    .X = self->X,
+    .SP = self->SP,
+    .erro = self->erro,
+    .complemento = self->complemento,
+    .modo = usuario,
+  };
+  if (self->salvamento == CPU_SALVA_NO_BANCO) {
+    self->banco = estado;
+  } else {
+    copia_para_memoria(self, &estado);
+  }
 
   // altera o estado da CPU para ela poder executar o tratador de interrupção
   // vai iniciar o tratamento da interrupção no endereço IRQ_END_TRATADOR,
@@ -522,19 +1349,44 @@ static void cpu_desinterrompe(cpu_t *self)
   // recupera o estado da CPU, para que volte a executar o que foi interrompido
   //   quando a interrupção foi atendida
   
-  // tem que estar em modo supervisor para ler nesses endereços
-  self->modo = supervisor;
-  pega_mem(self, IRQ_END_PC,          &self->PC);
-  pega_mem(self, IRQ_END_A,           &self->A);
-  pega_mem(self, IRQ_END_X,           &self->X);
-  // não dá para pegar o erro nem o modo diretamente porque eles não são int
-  int erro, modo;
-  pega_mem(self, IRQ_END_erro,        &erro);
-  pega_mem(self, IRQ_END_complemento, &self->complemento);
-  pega_mem(self, IRQ_END_modo,        &modo);
-  self->modo = modo;
+  cpu_estado_t estado;
+  if (self->salvamento == CPU_SALVA_NO_BANCO) {
+    estado = self->banco;
+  } else {
+    // tem que estar em modo supervisor para ler nesses endereços
+    self->modo = supervisor;
+    copia_da_memoria(self, &estado);
+  }
+  self->PC = estado.PC;
+  self->A = estado.A;
+  self->X = estado.X;
+  self->SP = estado.SP;
+  self->complemento = estado.complemento;
+  self->modo = estado.modo;
   // coloca o erro por último, porque pode ser alterado por pega_mem
-  self->erro = erro;
+  self->erro = estado.erro;
+}
+
+static void copia_da_memoria(cpu_t *self, cpu_estado_t *estado)
+{
+  pega_mem(self, IRQ_END_PC,          &estado->PC);
+  pega_mem(self, IRQ_END_A,           &estado->A);
+  pega_mem(self, IRQ_END_X,           &estado->X);
+  pega_mem(self, IRQ_END_SP,          &estado->SP);
+  pega_mem(self, IRQ_END_erro,        &estado->erro);
+  pega_mem(self, IRQ_END_complemento, &estado->complemento);
+  pega_mem(self, IRQ_END_modo,        &estado->modo);
+}
+
+static void copia_para_memoria(cpu_t *self, cpu_estado_t *estado)
+{
+  poe_mem(self, IRQ_END_PC,          estado->PC);
+  poe_mem(self, IRQ_END_A,           estado->A);
+  poe_mem(self, IRQ_END_X,           estado->X);
+  poe_mem(self, IRQ_END_SP,          estado->SP);
+  poe_mem(self, IRQ_END_erro,        estado->erro);
+  poe_mem(self, IRQ_END_complemento, estado->complemento);
+  poe_mem(self, IRQ_END_modo,        estado->modo);
 }
 
 // vim: foldmethod=marker
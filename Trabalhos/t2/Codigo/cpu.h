@@ -15,6 +15,37 @@ typedef enum { supervisor, usuario } cpu_modo_t;
 #include "err.h"
 #include "irq.h"
 #include "mmu.h"
+#include "checkpoint.h"
+#include "perfil.h"
+#include "trilha.h"
+
+// os motores de execução de instruções
+// todos produzem exatamente o mesmo resultado; diferem só no desempenho
+typedef enum {
+  CPU_MOTOR_SWITCH,  // decodifica cada instrução com um switch
+  CPU_MOTOR_PREDECOD,// despacho direto, com cache de instruções decodificadas
+  CPU_MOTOR_JIT,     // tradução de blocos para código nativo (se não for
+                     //   possível neste computador, é igual a PREDECOD)
+  N_CPU_MOTOR
+} cpu_motor_t;
+
+// o estado da CPU que é salvo quando ela aceita uma interrupção, e recuperado
+//   quando ela retorna (instrução RETI)
+typedef struct {
+  int PC;
+  int A;
+  int X;
+  int SP;
+  int erro;
+  int complemento;
+  int modo;
+} cpu_estado_t;
+
+// onde a CPU salva o estado em uma interrupção
+typedef enum {
+  CPU_SALVA_NA_MEMORIA, // nos endereços IRQ_END_* da memória (o inicial)
+  CPU_SALVA_NO_BANCO,   // no banco de registradores de sombra da CPU
+} cpu_salvamento_t;
 
 // tipo da função a ser chamada quando executar a instrução CHAMAC
 typedef int (*func_chamaC_t)(void *argC, int reg_A);
@@ -33,13 +64,61 @@ void cpu_destroi(cpu_t *self);
 //     e causa uma interrupção
 void cpu_executa_1(cpu_t *self);
 
+// executa até 'n' instruções em sequência, como 'n' chamadas a cpu_executa_1
+// a sequência termina antes se a CPU entrar em erro (inclusive por PARA) ou
+//   mudar de modo (por CHAMAS, RETI ou uma interrupção causada por erro);
+//   as instruções de E/S (LE, ESCR e CHAMAC) só são executadas como primeira
+//   instrução de uma sequência
+// retorna o número de instruções executadas (contando as que causaram erro, e
+//   cada palavra tratada por uma instrução de bloco como uma instrução; uma
+//   instrução de bloco para no meio se chegar a 'n', e continua na próxima
+//   execução); se a CPU já estiver em erro, não executa nada e retorna 0
+int cpu_executa_n(cpu_t *self, int n);
+
 // implementa uma interrupção
-// passa para modo supervisor, salva o estado da CPU no início da memória,
+// passa para modo supervisor, salva o estado da CPU no início da memória (ou
+//   no banco de registradores de sombra, ver cpu_define_salvamento),
 //   altera A para identificar a requisição de interrupção, altera PC para
 //   o endereço do tratador de interrupção
 // retorna true se interrupção foi aceita ou false caso contrário
 bool cpu_interrompe(cpu_t *self, irq_t irq);
 
+// define o motor de execução a usar nas próximas instruções
+// o motor inicial é CPU_MOTOR_SWITCH
+void cpu_define_motor(cpu_t *self, cpu_motor_t motor);
+
+// retorna o motor com o nome 'nome' ("switch", "predecod", "jit"), ou -1 se
+//   não existir
+cpu_motor_t cpu_motor_do_nome(char *nome);
+
+// define o perfil onde contar as instruções executadas (NULL para não contar)
+// com perfil, as instruções são executadas pelo motor switch, qualquer que
+//   seja o motor definido
+void cpu_define_perfil(cpu_t *self, perfil_t *perfil);
+
+// retorna o perfil da CPU (NULL se não tem)
+perfil_t *cpu_perfil(cpu_t *self);
+
+// define a trilha onde registrar as instruções executadas (NULL para não
+//   registrar)
+// como com perfil, as instruções são executadas pelo motor switch
+// quando uma instrução causa erro (exceto a parada da CPU), a trilha é gravada
+void cpu_define_trilha(cpu_t *self, trilha_t *trilha);
+
+// grava a trilha (se tiver), com as últimas instruções executadas
+void cpu_grava_trilha(cpu_t *self);
+
+// define onde a CPU salva o estado nas interrupções e de onde recupera no
+//   retorno; o estado que já está salvo é copiado para o novo lugar
+void cpu_define_salvamento(cpu_t *self, cpu_salvamento_t onde);
+
+// retorna o banco de registradores de sombra, com o estado salvo na última
+//   interrupção; o que for alterado nele é o que a CPU recupera no retorno
+// só vale quando a CPU salva no banco (CPU_SALVA_NO_BANCO); com isso, o SO
+//   troca o contexto de um processo com uma cópia de struct, sem acessar a
+//   memória
+cpu_estado_t *cpu_estado_salvo(cpu_t *self);
+
 // define a função a chamar quando executar a instrução CHAMAC
 // e o argumento a passar para ela (normalmente, um ponteiro para o SO)
 void cpu_define_chamaC(cpu_t *self, func_chamaC_t func, void *argC);
@@ -47,4 +126,12 @@ void cpu_define_chamaC(cpu_t *self, func_chamaC_t func, void *argC);
 // concatena a descrição do estado da CPU no final de str
 void cpu_concatena_descricao(cpu_t *self, char *str);
 
+// salva e restaura o estado da CPU (registradores, modo, erro e o banco de
+//   sombra) em um checkpoint
+// cpu_restaura esquece as instruções traduzidas e predecodificadas (a
+//   memória deve ter sido restaurada também); retorna false se não for
+//   possível
+void cpu_salva(cpu_t *self, ckpt_t *ckpt);
+bool cpu_restaura(cpu_t *self, ckpt_t *ckpt);
+
 #endif // CPU_H
@@ -0,0 +1,225 @@
+// gravacao.c
+// gravação e reprodução das entradas externas da simulação
+// simulador de computador
+// so24b
+
+#include "gravacao.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define N_TERMINAIS 4
+
+typedef struct {
+  long iteracao;
+  int instante;
+  char tipo;
+  char terminal;
+  int dado;
+} evento_t;
+
+struct gravacao_t {
+  grav_modo_t modo;
+  relogio_t *relogio;
+  long iteracao;
+  // para gravar
+  FILE *arquivo;
+  // para reproduzir: todos os eventos, e a posição do próximo evento de cada
+  //   tipo (e de cada terminal)
+  evento_t *eventos;
+  int n_eventos;
+  int prox_tempo_real;
+  int prox_comando;
+  int prox_entrada[N_TERMINAIS];
+  int prox_limpeza[N_TERMINAIS];
+  bool divergiu;
+};
+
+static bool le_eventos(gravacao_t *self, FILE *arquivo);
+
+gravacao_t *gravacao_cria(char *nome, grav_modo_t modo, relogio_t *relogio)
+{
+  FILE *arquivo = fopen(nome, modo == GRAV_GRAVA ? "w" : "r");
+  if (arquivo == NULL) return NULL;
+
+  gravacao_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->modo = modo;
+  self->relogio = relogio;
+  self->iteracao = 0;
+  self->arquivo = NULL;
+  self->eventos = NULL;
+  self->n_eventos = 0;
+  self->prox_tempo_real = 0;
+  self->prox_comando = 0;
+  for (int t = 0; t < N_TERMINAIS; t++) {
+    self->prox_entrada[t] = 0;
+    self->prox_limpeza[t] = 0;
+  }
+  self->divergiu = false;
+
+  if (modo == GRAV_GRAVA) {
+    self->arquivo = arquivo;
+  } else {
+    bool ok = le_eventos(self, arquivo);
+    fclose(arquivo);
+    if (!ok) {
+      gravacao_destroi(self);
+      return NULL;
+    }
+  }
+  return self;
+}
+
+void gravacao_destroi(gravacao_t *self)
+{
+  if (self->arquivo != NULL) fclose(self->arquivo);
+  free(self->eventos);
+  free(self);
+}
+
+bool gravacao_reproduzindo(gravacao_t *self)
+{
+  return self->modo == GRAV_REPRODUZ;
+}
+
+bool gravacao_divergiu(gravacao_t *self)
+{
+  return self->divergiu;
+}
+
+void gravacao_nova_iteracao(gravacao_t *self)
+{
+  self->iteracao++;
+}
+
+// GRAVAÇÃO {{{1
+
+static void registra(gravacao_t *self, char tipo, char terminal, int dado)
+{
+  assert(self->modo == GRAV_GRAVA);
+  fprintf(self->arquivo, "%ld %d %c", self->iteracao,
+          relogio_agora(self->relogio), tipo);
+  if (terminal != '\0') fprintf(self->arquivo, " %c", terminal);
+  fprintf(self->arquivo, " %d\n", dado);
+}
+
+void gravacao_registra_tempo_real(gravacao_t *self, int valor)
+{
+  registra(self, 'R', '\0', valor);
+}
+
+void gravacao_registra_entrada(gravacao_t *self, char terminal, char ch)
+{
+  registra(self, 'E', terminal, (unsigned char)ch);
+}
+
+void gravacao_registra_limpeza(gravacao_t *self, char terminal)
+{
+  registra(self, 'L', terminal, 0);
+}
+
+void gravacao_registra_comando(gravacao_t *self, char cmd)
+{
+  registra(self, 'C', '\0', (unsigned char)cmd);
+}
+
+// REPRODUÇÃO {{{1
+
+static bool le_eventos(gravacao_t *self, FILE *arquivo)
+{
+  int cap = 0;
+  evento_t ev;
+  for (;;) {
+    int n = fscanf(arquivo, "%ld %d %c", &ev.iteracao, &ev.instante, &ev.tipo);
+    if (n == EOF) break;
+    if (n != 3) return false;
+    ev.terminal = '\0';
+    if (ev.tipo == 'E' || ev.tipo == 'L') {
+      if (fscanf(arquivo, " %c", &ev.terminal) != 1) return false;
+      if (ev.terminal < 'A' || ev.terminal >= 'A' + N_TERMINAIS) return false;
+    } else if (ev.tipo != 'R' && ev.tipo != 'C') {
+      return false;
+    }
+    if (fscanf(arquivo, "%d", &ev.dado) != 1) return false;
+    if (self->n_eventos == cap) {
+      cap = cap == 0 ? 1024 : cap * 2;
+      self->eventos = realloc(self->eventos, cap * sizeof(evento_t));
+      assert(self->eventos != NULL);
+    }
+    self->eventos[self->n_eventos++] = ev;
+  }
+  return true;
+}
+
+// avança '*pprox' até o próximo evento do tipo (e terminal) pedido, retorna
+//   ele ou NULL se não tem mais
+static evento_t *proximo(gravacao_t *self, int *pprox, char tipo, char terminal)
+{
+  while (*pprox < self->n_eventos) {
+    evento_t *ev = &self->eventos[*pprox];
+    if (ev->tipo == tipo && ev->terminal == terminal) return ev;
+    (*pprox)++;
+  }
+  return NULL;
+}
+
+// retorna o próximo evento do tipo pedido se for da iteração corrente (ou de
+//   uma anterior, que não foi entregue na hora), e consome ele
+static evento_t *consome(gravacao_t *self, int *pprox, char tipo, char terminal)
+{
+  assert(self->modo == GRAV_REPRODUZ);
+  evento_t *ev = proximo(self, pprox, tipo, terminal);
+  if (ev == NULL || ev->iteracao > self->iteracao) return NULL;
+  if (ev->iteracao != self->iteracao
+      || ev->instante != relogio_agora(self->relogio)) {
+    self->divergiu = true;
+  }
+  (*pprox)++;
+  return ev;
+}
+
+bool gravacao_tempo_real(gravacao_t *self, int *pvalor)
+{
+  // a leitura do relógio acontece durante a execução de instruções: o
+  //   próximo valor gravado é o desta leitura, esteja na iteração que estiver
+  assert(self->modo == GRAV_REPRODUZ);
+  evento_t *ev = proximo(self, &self->prox_tempo_real, 'R', '\0');
+  if (ev == NULL) {
+    self->divergiu = true;
+    return false;
+  }
+  if (ev->iteracao != self->iteracao
+      || ev->instante != relogio_agora(self->relogio)) {
+    self->divergiu = true;
+  }
+  self->prox_tempo_real++;
+  *pvalor = ev->dado;
+  return true;
+}
+
+int gravacao_entrada(gravacao_t *self, char terminal)
+{
+  int t = terminal - 'A';
+  assert(t >= 0 && t < N_TERMINAIS);
+  evento_t *ev = consome(self, &self->prox_entrada[t], 'E', terminal);
+  if (ev == NULL) return -1;
+  return ev->dado;
+}
+
+bool gravacao_limpeza(gravacao_t *self, char terminal)
+{
+  int t = terminal - 'A';
+  assert(t >= 0 && t < N_TERMINAIS);
+  return consome(self, &self->prox_limpeza[t], 'L', terminal) != NULL;
+}
+
+char gravacao_comando(gravacao_t *self)
+{
+  evento_t *ev = consome(self, &self->prox_comando, 'C', '\0');
+  if (ev == NULL) return '\0';
+  return ev->dado;
+}
+
+// vim: foldmethod=marker
@@ -0,0 +1,79 @@
+// gravacao.h
+// gravação e reprodução das entradas externas da simulação
+// simulador de computador
+// so24b
+
+#ifndef GRAVACAO_H
+#define GRAVACAO_H
+
+// o que vem de fora da máquina simulada torna a simulação não reproduzível:
+//   o que é digitado nos terminais pela console, os comandos do operador ao
+//   controlador e as leituras do relógio real (o arquivo de entrada de um
+//   terminal, como os programas, faz parte da configuração da máquina)
+// no modo de gravação, cada um desses eventos é registrado em um arquivo,
+//   junto com o momento em que aconteceu; no modo de reprodução, os eventos
+//   são lidos do arquivo e entregues nos mesmos momentos, no lugar das
+//   entradas reais, e a simulação executa exatamente as mesmas instruções
+// o momento de um evento é a iteração do laço do controlador (o que
+//   acontece nos terminais depende do número de iterações, não só do número
+//   de instruções) e o instante do relógio (relogio_agora), que é conferido
+//   na reprodução
+// o arquivo é texto, com um evento por linha:
+//   iteração instante tipo dado
+//   tipo 'R' (leitura do relógio real, dado é o valor lido),
+//   'E' (entrada em terminal, dado é o terminal e o código do caractere),
+//   'L' (limpeza da saída de um terminal pelo operador, dado é o terminal e 0)
+//   ou 'C' (comando do operador, dado é o código do caractere do comando)
+
+typedef struct gravacao_t gravacao_t;
+
+#include "relogio.h"
+
+#include <stdbool.h>
+
+typedef enum { GRAV_GRAVA, GRAV_REPRODUZ } grav_modo_t;
+
+// cria uma gravação no arquivo 'nome', para gravar ou reproduzir, com os
+//   instantes dados pelo relógio 'relogio'
+// retorna NULL se não conseguir abrir o arquivo (ou se ele não tiver o
+//   formato esperado)
+gravacao_t *gravacao_cria(char *nome, grav_modo_t modo, relogio_t *relogio);
+void gravacao_destroi(gravacao_t *self);
+
+// retorna true se está reproduzindo
+bool gravacao_reproduzindo(gravacao_t *self);
+
+// retorna true se a reprodução encontrou um evento em um instante diferente
+//   do gravado (a simulação não está seguindo a gravação)
+bool gravacao_divergiu(gravacao_t *self);
+
+// deve ser chamada pelo controlador no início de cada iteração do laço
+void gravacao_nova_iteracao(gravacao_t *self);
+
+// leitura do relógio real
+// na gravação, registra o valor lido; na reprodução, coloca em '*pvalor' o
+//   valor gravado (retorna false se não tem)
+void gravacao_registra_tempo_real(gravacao_t *self, int valor);
+bool gravacao_tempo_real(gravacao_t *self, int *pvalor);
+
+// entrada no terminal 'terminal' ('A' a 'D')
+// na gravação, registra o caractere recebido; na reprodução, retorna o
+//   próximo caractere gravado para o terminal na iteração corrente, ou -1 se
+//   não tem
+void gravacao_registra_entrada(gravacao_t *self, char terminal, char ch);
+int gravacao_entrada(gravacao_t *self, char terminal);
+
+// limpeza da saída do terminal 'terminal' ('A' a 'D') pelo operador (que
+//   altera o estado da tela visto pela CPU)
+// na gravação, registra a limpeza; na reprodução, retorna true se tem uma
+//   limpeza gravada para o terminal na iteração corrente (e consome ela)
+void gravacao_registra_limpeza(gravacao_t *self, char terminal);
+bool gravacao_limpeza(gravacao_t *self, char terminal);
+
+// comando do operador para o controlador
+// na gravação, registra o comando; na reprodução, retorna o comando gravado
+//   para a iteração corrente, ou '\0' se não tem
+void gravacao_registra_comando(gravacao_t *self, char cmd);
+char gravacao_comando(gravacao_t *self);
+
+#endif // GRAVACAO_H
@@ -41,6 +41,13 @@ struct {
   { "RETI",   0,  RETI   },
   { "CHAMAC", 0,  CHAMAC },
   { "CHAMAS", 0,  CHAMAS },
+  { "MOVB",   1,  MOVB   },
+  { "PREB",   1,  PREB   },
+  { "PUSH",   0,  PUSH   },
+  { "POP",    0,  POP    },
+  { "CALL",   1,  CALL   },
+  { "RETS",   0,  RETS   },
+  { "TRASP",  0,  TRASP  },
   // pseudo-instrucoes
   { "VALOR",  1,  VALOR  },
   { "STRING", 1,  STRING },
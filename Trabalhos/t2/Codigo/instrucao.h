@@ -17,6 +17,24 @@
 //   DEFINE - define um valor para um símbolo (obrigatoriamente tem que ter
 //            um label, que é definido com o valor do argumento e não com a
 //            posição atual da memória)
+//
+// As instruções de bloco (MOVB e PREB) tratam uma palavra por vez, da última
+//   (A1+A-1) para a primeira, decrementando A a cada uma; terminam com A=0 e
+//   o PC na instrução seguinte. Podem ser interrompidas no meio (por falta de
+//   página ou no fim de uma sequência de instruções), com o PC ainda na
+//   instrução e A com o número de palavras que falta; executar de novo
+//   continua de onde parou. Cada palavra conta como uma instrução executada.
+//   Se as áreas de MOVB se sobrepõem, o destino deve estar depois da origem
+//   (A1 >= X); se começar antes (A1 < X < A1+A), MOVB causa ERR_OP_INV sem
+//   alterar nada.
+//
+// As instruções de pilha (PUSH, POP, CALL e RETS) usam o registrador SP, que
+//   aponta para o último valor empilhado; a pilha cresce para os endereços
+//   menores. Diferente de CHAMA, CALL não escreve na subrotina, então o código
+//   pode ser reentrante e ficar em páginas que não são alteradas. O SP não é
+//   inicializado pelo SO; o programa deve colocar nele (com TRASP) o endereço
+//   seguinte ao fim da área reservada para a pilha. Se um acesso à memória
+//   causa erro, SP não é alterado.
 
 typedef enum {
   // instruções normais
@@ -49,6 +67,13 @@ typedef enum {
   CHAMAS = 25, // 1   chama sistema          causa interrupção IRQ_SISTEMA
   RETI   = 26, // 1   retorno de interrupção restaura estado da CPU
   CHAMAC = 27, // 1   chama função C         simula código compilado
+  MOVB   = 28, // 2   move bloco             mem[A1..A1+A-1] = mem[X..X+A-1]
+  PREB   = 29, // 2   preenche bloco         mem[A1..A1+A-1] = X
+  PUSH   = 30, // 1   empilha A              SP--; mem[SP] = A
+  POP    = 31, // 1   desempilha para A      A = mem[SP]; SP++
+  CALL   = 32, // 2   chama com pilha        SP--; mem[SP] = PC+2; PC = A1
+  RETS   = 33, // 1   retorna com pilha      PC = mem[SP]; SP++
+  TRASP  = 34, // 1   troca A com SP         SP <-> A
   // pseudo-instruções
   VALOR,       // inicializa próxima posição de memória
   STRING,      // inicializa próximas posições de memória
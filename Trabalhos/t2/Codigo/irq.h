@@ -31,6 +31,7 @@ char *irq_nome(irq_t irq);
 #define IRQ_END_erro        3
 #define IRQ_END_complemento 4
 #define IRQ_END_modo        5
+#define IRQ_END_SP          6
 
 // endereço para onde desviar quando aceita uma interrupção
 #define IRQ_END_TRATADOR   10
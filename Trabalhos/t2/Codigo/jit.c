@@ -0,0 +1,487 @@
+// jit.c
+// tradutor de blocos de instruções para código nativo
+// simulador de computador
+// so24b
+
+// INCLUDES {{{1
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include "instrucao.h"
+#include "mmu.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/mman.h>
+
+// DECLARAÇÃO {{{1
+
+// tamanho da área de código gerado; quando enche, todos os blocos são
+//   descartados e a tradução recomeça
+#define JIT_TAM_CODIGO (4 * 1024 * 1024)
+// número de entradas da tabela de blocos (mapeamento direto pelo endereço)
+#define JIT_N_BLOCOS 4096
+// número máximo de instruções em um bloco
+#define JIT_MAX_INSTRUCOES 64
+// número máximo de bytes gerados para uma instrução, e para um bloco
+#define JIT_MAX_BYTES_INSTRUCAO 160
+#define JIT_MAX_BYTES_BLOCO (64 + JIT_MAX_INSTRUCOES * JIT_MAX_BYTES_INSTRUCAO)
+
+typedef struct {
+  // endereço físico do início do bloco, ou -1 se a entrada não está em uso
+  int endfis;
+  // número de instruções do bloco (0 se não foi possível traduzir)
+  int n_instrucoes;
+  jit_bloco_f codigo;
+} jit_entrada_t;
+
+struct jit_t {
+  mem_t *mem;
+  jit_cpu_t cpu;
+  // área executável onde o código é gerado, e quanto dela está em uso
+  uint8_t *codigo;
+  int usado;
+  jit_entrada_t blocos[JIT_N_BLOCOS];
+  // para cada endereço da memória física, se ele faz parte de algum bloco
+  bool *traduzido;
+  int tam_mem;
+  bool descarte_pendente;
+};
+
+// CRIAÇÃO {{{1
+
+static void jit__descarta_tudo(jit_t *self);
+
+jit_t *jit_cria(mem_t *mem, jit_cpu_t *cpu)
+{
+  void *codigo = mmap(NULL, JIT_TAM_CODIGO, PROT_READ | PROT_WRITE | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (codigo == MAP_FAILED) return NULL;
+
+  jit_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->mem = mem;
+  self->cpu = *cpu;
+  self->codigo = codigo;
+  self->tam_mem = mem_tam(mem);
+  self->traduzido = malloc(self->tam_mem * sizeof(*self->traduzido));
+  assert(self->traduzido != NULL);
+  jit__descarta_tudo(self);
+
+  return self;
+}
+
+void jit_destroi(jit_t *self)
+{
+  munmap(self->codigo, JIT_TAM_CODIGO);
+  free(self->traduzido);
+  free(self);
+}
+
+static void jit__descarta_tudo(jit_t *self)
+{
+  for (int i = 0; i < JIT_N_BLOCOS; i++) {
+    self->blocos[i].endfis = -1;
+  }
+  memset(self->traduzido, 0, self->tam_mem * sizeof(*self->traduzido));
+  self->usado = 0;
+  self->descarte_pendente = false;
+}
+
+// ALTERAÇÃO DA MEMÓRIA {{{1
+
+void jit_memoria_alterada(jit_t *self, int endereco)
+{
+  if (endereco >= 0 && endereco < self->tam_mem && self->traduzido[endereco]) {
+    // não dá para descartar agora, o código alterado pode estar em execução
+    self->descarte_pendente = true;
+  }
+}
+
+void jit_descarta(jit_t *self)
+{
+  self->descarte_pendente = true;
+}
+
+bool jit_descarte_pendente(jit_t *self)
+{
+  return self->descarte_pendente;
+}
+
+// GERAÇÃO DE CÓDIGO X86-64 {{{1
+
+// durante a execução do código gerado, os registradores do x86 contêm:
+//   r12: ponteiro para a CPU simulada
+//   ebx: registrador A
+//   r13d: registrador X
+// o PC da CPU não é alterado até o final do bloco, quando é somado a ele o
+//   deslocamento da instrução onde o bloco termina (o mesmo bloco físico pode
+//   estar em endereços virtuais diferentes)
+
+typedef struct {
+  uint8_t *p;
+  jit_cpu_t *cpu;
+} emissor_t;
+
+static void emite_bytes(emissor_t *e, int n, uint8_t bytes[n])
+{
+  memcpy(e->p, bytes, n);
+  e->p += n;
+}
+#define EMITE(e, ...) \
+  emite_bytes(e, sizeof((uint8_t[]){__VA_ARGS__}), (uint8_t[]){__VA_ARGS__})
+
+static void emite_32(emissor_t *e, int32_t v)
+{
+  memcpy(e->p, &v, sizeof(v));
+  e->p += sizeof(v);
+}
+
+static void emite_64(emissor_t *e, uint64_t v)
+{
+  memcpy(e->p, &v, sizeof(v));
+  e->p += sizeof(v);
+}
+
+// desvio curto para frente, com o destino ajustado depois por fixa_desvio
+static uint8_t *emite_desvio(emissor_t *e, uint8_t opcode)
+{
+  EMITE(e, opcode, 0);
+  return e->p - 1;
+}
+
+// faz o desvio emitido em 'desl' ir para a posição atual
+static void fixa_desvio(emissor_t *e, uint8_t *desl)
+{
+  int distancia = e->p - (desl + 1);
+  assert(distancia <= 127);
+  *desl = distancia;
+}
+
+static void emite_prologo(emissor_t *e)
+{
+  EMITE(e, 0x53);                                // push rbx
+  EMITE(e, 0x41, 0x54);                          // push r12
+  EMITE(e, 0x41, 0x55);                          // push r13
+  EMITE(e, 0x49, 0x89, 0xfc);                    // mov r12, rdi
+  EMITE(e, 0x41, 0x8b, 0x9c, 0x24);              // mov ebx, [r12+A]
+  emite_32(e, e->cpu->desl_A);
+  EMITE(e, 0x45, 0x8b, 0xac, 0x24);              // mov r13d, [r12+X]
+  emite_32(e, e->cpu->desl_X);
+}
+
+// guarda A e X na CPU, e retorna 'passos'
+static void emite_epilogo(emissor_t *e, int passos)
+{
+  EMITE(e, 0x41, 0x89, 0x9c, 0x24);              // mov [r12+A], ebx
+  emite_32(e, e->cpu->desl_A);
+  EMITE(e, 0x45, 0x89, 0xac, 0x24);              // mov [r12+X], r13d
+  emite_32(e, e->cpu->desl_X);
+  EMITE(e, 0xb8);                                // mov eax, passos
+  emite_32(e, passos);
+  EMITE(e, 0x41, 0x5d);                          // pop r13
+  EMITE(e, 0x41, 0x5c);                          // pop r12
+  EMITE(e, 0x5b);                                // pop rbx
+  EMITE(e, 0xc3);                                // ret
+}
+
+// termina o bloco com o PC 'desl' posições depois do início do bloco
+static void emite_saida_relativa(emissor_t *e, int desl, int passos)
+{
+  if (desl != 0) {
+    EMITE(e, 0x41, 0x81, 0x84, 0x24);            // add dword [r12+PC], desl
+    emite_32(e, e->cpu->desl_PC);
+    emite_32(e, desl);
+  }
+  emite_epilogo(e, passos);
+}
+
+// termina o bloco com o PC em 'pc'
+static void emite_saida_absoluta(emissor_t *e, int pc, int passos)
+{
+  EMITE(e, 0x41, 0xc7, 0x84, 0x24);              // mov dword [r12+PC], pc
+  emite_32(e, e->cpu->desl_PC);
+  emite_32(e, pc);
+  emite_epilogo(e, passos);
+}
+
+// termina o bloco com o PC no valor de eax
+static void emite_saida_eax(emissor_t *e, int passos)
+{
+  EMITE(e, 0x41, 0x89, 0x84, 0x24);              // mov [r12+PC], eax
+  emite_32(e, e->cpu->desl_PC);
+  emite_epilogo(e, passos);
+}
+
+// coloca o endereço de acesso à memória em esi: A1, ou A1+X se indexado
+static void emite_endereco(emissor_t *e, int A1, bool indexado)
+{
+  if (indexado) {
+    EMITE(e, 0x44, 0x89, 0xee);                  // mov esi, r13d
+    EMITE(e, 0x81, 0xc6);                        // add esi, A1
+  } else {
+    EMITE(e, 0xbe);                              // mov esi, A1
+  }
+  emite_32(e, A1);
+}
+
+static void emite_chamada(emissor_t *e, uintptr_t funcao)
+{
+  EMITE(e, 0x48, 0xb8);                          // mov rax, funcao
+  emite_64(e, funcao);
+  EMITE(e, 0xff, 0xd0);                          // call rax
+}
+
+// lê o valor da memória em A1 (ou A1+X) para eax
+// em caso de erro, termina o bloco na instrução 'desl'
+static void emite_leitura(emissor_t *e, int A1, bool indexado,
+                          int desl, int passos)
+{
+  EMITE(e, 0x4c, 0x89, 0xe7);                    // mov rdi, r12
+  emite_endereco(e, A1, indexado);
+  emite_chamada(e, (uintptr_t)e->cpu->le);
+  EMITE(e, 0x48, 0x85, 0xc0);                    // test rax, rax
+  uint8_t *ok = emite_desvio(e, 0x79);           // jns ok
+  emite_saida_relativa(e, desl, passos);
+  fixa_desvio(e, ok);
+}
+
+// escreve o valor de edx (já preenchido) na memória em A1 (ou A1+X)
+// em caso de erro, termina o bloco na instrução 'desl'
+// se o código traduzido foi alterado, termina o bloco com o PC em 'prox_pc'
+//   (relativo ao início do bloco, ou absoluto se 'prox_abs')
+static void emite_escrita(emissor_t *e, int A1, bool indexado,
+                          int desl, int passos, int prox_pc, bool prox_abs)
+{
+  EMITE(e, 0x4c, 0x89, 0xe7);                    // mov rdi, r12
+  emite_endereco(e, A1, indexado);
+  emite_chamada(e, (uintptr_t)e->cpu->escreve);
+  EMITE(e, 0x85, 0xc0);                          // test eax, eax
+  uint8_t *ok = emite_desvio(e, 0x74);           // jz ok
+  EMITE(e, 0x83, 0xf8, JIT_ESCR_ERRO);           // cmp eax, JIT_ESCR_ERRO
+  uint8_t *descartado = emite_desvio(e, 0x75);   // jne descartado
+  emite_saida_relativa(e, desl, passos);
+  fixa_desvio(e, descartado);
+  if (prox_abs) {
+    emite_saida_absoluta(e, prox_pc, passos);
+  } else {
+    emite_saida_relativa(e, prox_pc, passos);
+  }
+  fixa_desvio(e, ok);
+}
+
+// desvio condicional: 'jcc' é o opcode do desvio curto do x86 que é tomado
+//   quando o desvio da CPU simulada deve ser feito, testando A
+static void emite_desvio_cond(emissor_t *e, uint8_t jcc, int A1,
+                              int desl, int passos)
+{
+  EMITE(e, 0x85, 0xdb);                          // test ebx, ebx
+  uint8_t *desvia = emite_desvio(e, jcc);        // jcc desvia
+  emite_saida_relativa(e, desl + 2, passos);
+  fixa_desvio(e, desvia);
+  emite_saida_absoluta(e, A1, passos);
+}
+
+// TRADUÇÃO {{{1
+
+// retorna true se a instrução pode ser traduzida
+static bool traduzivel(int opcode)
+{
+  switch (opcode) {
+    case NOP:   case CARGI: case CARGM:  case CARGX: case ARMM:  case ARMX:
+    case TRAX:  case CPXA:  case INCX:   case SOMA:  case SUB:   case MULT:
+    case DIV:   case RESTO: case NEG:    case DESV:  case DESVZ: case DESVNZ:
+    case DESVN: case DESVP: case CHAMA:  case RET:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// gera o código de uma instrução, que está 'desl' posições depois do início
+//   do bloco e é a instrução número 'i' dele
+// retorna true se a instrução termina o bloco
+static bool traduz_instrucao(emissor_t *e, int opcode, int A1, int desl, int i)
+{
+  int passos = i + 1;
+  switch (opcode) {
+    case NOP:
+      break;
+    case CARGI:
+      EMITE(e, 0xbb);                            // mov ebx, A1
+      emite_32(e, A1);
+      break;
+    case CARGM:
+    case CARGX:
+      emite_leitura(e, A1, opcode == CARGX, desl, passos);
+      EMITE(e, 0x89, 0xc3);                      // mov ebx, eax
+      break;
+    case ARMM:
+    case ARMX:
+      EMITE(e, 0x89, 0xda);                      // mov edx, ebx
+      emite_escrita(e, A1, opcode == ARMX, desl, passos, desl + 2, false);
+      break;
+    case TRAX:
+      EMITE(e, 0x44, 0x87, 0xeb);                // xchg ebx, r13d
+      break;
+    case CPXA:
+      EMITE(e, 0x44, 0x89, 0xeb);                // mov ebx, r13d
+      break;
+    case INCX:
+      EMITE(e, 0x41, 0xff, 0xc5);                // inc r13d
+      break;
+    case SOMA:
+      emite_leitura(e, A1, false, desl, passos);
+      EMITE(e, 0x01, 0xc3);                      // add ebx, eax
+      break;
+    case SUB:
+      emite_leitura(e, A1, false, desl, passos);
+      EMITE(e, 0x29, 0xc3);                      // sub ebx, eax
+      break;
+    case MULT:
+      emite_leitura(e, A1, false, desl, passos);
+      EMITE(e, 0x0f, 0xaf, 0xd8);                // imul ebx, eax
+      break;
+    case DIV:
+    case RESTO:
+      // mesmo comportamento da divisão em C, inclusive na divisão por zero
+      emite_leitura(e, A1, false, desl, passos);
+      EMITE(e, 0x89, 0xc1);                      // mov ecx, eax
+      EMITE(e, 0x89, 0xd8);                      // mov eax, ebx
+      EMITE(e, 0x99);                            // cdq
+      EMITE(e, 0xf7, 0xf9);                      // idiv ecx
+      if (opcode == DIV) {
+        EMITE(e, 0x89, 0xc3);                    // mov ebx, eax
+      } else {
+        EMITE(e, 0x89, 0xd3);                    // mov ebx, edx
+      }
+      break;
+    case NEG:
+      EMITE(e, 0xf7, 0xdb);                      // neg ebx
+      break;
+    case DESV:
+      emite_saida_absoluta(e, A1, passos);
+      return true;
+    case DESVZ:
+      emite_desvio_cond(e, 0x74, A1, desl, passos);  // jz
+      return true;
+    case DESVNZ:
+      emite_desvio_cond(e, 0x75, A1, desl, passos);  // jnz
+      return true;
+    case DESVN:
+      emite_desvio_cond(e, 0x78, A1, desl, passos);  // js
+      return true;
+    case DESVP:
+      emite_desvio_cond(e, 0x7f, A1, desl, passos);  // jg
+      return true;
+    case CHAMA:
+      // o endereço de retorno é o endereço virtual da instrução seguinte
+      EMITE(e, 0x41, 0x8b, 0x94, 0x24);          // mov edx, [r12+PC]
+      emite_32(e, e->cpu->desl_PC);
+      EMITE(e, 0x81, 0xc2);                      // add edx, desl+2
+      emite_32(e, desl + 2);
+      emite_escrita(e, A1, false, desl, passos, A1 + 1, true);
+      emite_saida_absoluta(e, A1 + 1, passos);
+      return true;
+    case RET:
+      emite_leitura(e, A1, false, desl, passos);
+      emite_saida_eax(e, passos);
+      return true;
+  }
+  return false;
+}
+
+// traduz o bloco que começa em 'endfis', preenchendo 'entrada'
+static void jit__traduz(jit_t *self, int endfis, jit_entrada_t *entrada)
+{
+  emissor_t e = { self->codigo + self->usado, &self->cpu };
+  uint8_t *inicio = e.p;
+  // o bloco não passa do final da página (nem da memória)
+  int limite = endfis - endfis % TAM_PAGINA + TAM_PAGINA;
+  if (limite > self->tam_mem) limite = self->tam_mem;
+
+  entrada->endfis = endfis;
+  self->traduzido[endfis] = true;
+  emite_prologo(&e);
+  int n = 0;
+  int end = endfis;
+  bool fim = false;
+  while (!fim && n < JIT_MAX_INSTRUCOES && end < limite) {
+    int opcode, A1 = 0;
+    mem_le(self->mem, end, &opcode);
+    if (!traduzivel(opcode)) break;
+    int tam = 1 + instrucao_num_args(opcode);
+    if (tam == 2) {
+      if (end + 1 >= limite) break;
+      mem_le(self->mem, end + 1, &A1);
+    }
+    for (int i = 0; i < tam; i++) {
+      self->traduzido[end + i] = true;
+    }
+    fim = traduz_instrucao(&e, opcode, A1, end - endfis, n);
+    n++;
+    end += tam;
+  }
+  entrada->n_instrucoes = n;
+  if (n == 0) {
+    entrada->codigo = NULL;
+    return;
+  }
+  if (!fim) emite_saida_relativa(&e, end - endfis, n);
+  assert(e.p - inicio <= JIT_MAX_BYTES_BLOCO);
+  entrada->codigo = (jit_bloco_f)inicio;
+  self->usado += e.p - inicio;
+}
+
+jit_bloco_f jit_bloco(jit_t *self, int endfis, int *pn_instrucoes)
+{
+  if (endfis < 0 || endfis >= self->tam_mem) return NULL;
+  if (self->descarte_pendente) jit__descarta_tudo(self);
+  jit_entrada_t *entrada = &self->blocos[endfis % JIT_N_BLOCOS];
+  if (entrada->endfis != endfis) {
+    if (self->usado + JIT_MAX_BYTES_BLOCO > JIT_TAM_CODIGO) {
+      jit__descarta_tudo(self);
+    }
+    jit__traduz(self, endfis, entrada);
+  }
+  *pn_instrucoes = entrada->n_instrucoes;
+  return entrada->codigo;
+}
+
+#else // não é x86-64 com linux
+
+// CRIAÇÃO {{{1
+
+jit_t *jit_cria(mem_t *mem, jit_cpu_t *cpu)
+{
+  // não sabe gerar código para este computador
+  return NULL;
+}
+
+void jit_destroi(jit_t *self)
+{
+}
+
+jit_bloco_f jit_bloco(jit_t *self, int endfis, int *pn_instrucoes)
+{
+  return NULL;
+}
+
+void jit_memoria_alterada(jit_t *self, int endereco)
+{
+}
+
+void jit_descarta(jit_t *self)
+{
+}
+
+bool jit_descarte_pendente(jit_t *self)
+{
+  return false;
+}
+
+#endif
+
+// vim: foldmethod=marker
@@ -0,0 +1,84 @@
+// jit.h
+// tradutor de blocos de instruções para código nativo
+// simulador de computador
+// so24b
+
+#ifndef JIT_H
+#define JIT_H
+
+// tradução dinâmica ("JIT") de blocos básicos de instruções da CPU simulada
+//   para código x86-64, executado diretamente pelo processador hospedeiro
+// só existe em x86-64 com linux; nos outros, jit_cria retorna NULL
+//
+// um bloco é uma sequência de instruções que começa em um endereço físico,
+//   está toda dentro de uma página, e termina em um desvio (que é incluído no
+//   bloco) ou antes de uma instrução que não é traduzida (as privilegiadas, de
+//   E/S e de chamada de sistema, que continuam sendo interpretadas pela CPU)
+// o código gerado altera os registradores da CPU diretamente, e acessa a
+//   memória com funções fornecidas pela CPU, que fazem a tradução de endereços;
+//   um erro de acesso termina o bloco na instrução que causou o erro, com o
+//   mesmo estado que a CPU teria ao interpretar as instruções
+// uma escrita na memória física em um endereço que contém código traduzido
+//   descarta todos os blocos traduzidos; se a escrita for feita pelo próprio
+//   código gerado, o bloco termina logo após a instrução que escreveu
+
+#include "memoria.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct jit_t jit_t;
+
+// código de um bloco traduzido
+// executa as instruções do bloco sobre a CPU 'cpu' e retorna o número de
+//   instruções executadas (contando a que causou erro, se for o caso)
+typedef int (*jit_bloco_f)(void *cpu);
+
+// resultado da função de escrita na memória
+typedef enum {
+  JIT_ESCR_OK,          // escreveu
+  JIT_ESCR_ERRO,        // não escreveu, a CPU está em erro
+  JIT_ESCR_DESCARTADO,  // escreveu, e os blocos traduzidos foram descartados
+} jit_escr_t;
+
+// o que o código gerado precisa saber da CPU
+typedef struct {
+  // deslocamento dos registradores PC, A e X (int) na estrutura da CPU
+  int desl_PC;
+  int desl_A;
+  int desl_X;
+  // lê o valor no endereço virtual 'endereco'
+  // retorna o valor (convertido para unsigned) ou -1 em caso de erro, com a CPU
+  //   já em erro
+  int64_t (*le)(void *cpu, int endereco);
+  // escreve 'valor' no endereço virtual 'endereco'
+  jit_escr_t (*escreve)(void *cpu, int endereco, int valor);
+} jit_cpu_t;
+
+// cria um tradutor para o código que está na memória 'mem', gerando código
+//   para a CPU descrita em 'cpu'
+// retorna NULL se não for possível gerar código nativo neste computador
+jit_t *jit_cria(mem_t *mem, jit_cpu_t *cpu);
+
+// destrói o tradutor e todo o código gerado
+void jit_destroi(jit_t *self);
+
+// retorna o código do bloco que começa no endereço físico 'endfis', traduzindo
+//   o bloco se necessário, e coloca em '*pn_instrucoes' o número de instruções
+//   do bloco
+// retorna NULL se a instrução em 'endfis' não pode ser traduzida
+// não deve ser chamada durante a execução de um bloco
+jit_bloco_f jit_bloco(jit_t *self, int endfis, int *pn_instrucoes);
+
+// avisa que o endereço físico 'endereco' da memória foi alterado
+void jit_memoria_alterada(jit_t *self, int endereco);
+
+// descarta todos os blocos traduzidos (antes da execução do próximo bloco),
+//   porque a memória foi toda alterada
+void jit_descarta(jit_t *self);
+
+// retorna true se os blocos traduzidos vão ser descartados (por causa de uma
+//   escrita em código traduzido) antes da execução do próximo bloco
+bool jit_descarte_pendente(jit_t *self);
+
+#endif // JIT_H
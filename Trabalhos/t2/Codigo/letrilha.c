@@ -0,0 +1,79 @@
+// letrilha.c
+// mostra o conteúdo de um arquivo de trilha de instruções (ver trilha.h)
+// simulador de computador
+// so24b
+
+#include "trilha.h"
+#include "cpu.h"
+#include "instrucao.h"
+#include "err.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// verifica o cabeçalho do arquivo
+static bool le_cabecalho(FILE *arq)
+{
+  char assinatura[8];
+  uint64_t versao, tam_reg;
+  if (fread(assinatura, 1, sizeof(assinatura), arq) != sizeof(assinatura)
+      || fread(&versao, sizeof(versao), 1, arq) != 1
+      || fread(&tam_reg, sizeof(tam_reg), 1, arq) != 1) {
+    return false;
+  }
+  return memcmp(assinatura, TRILHA_ASSINATURA, 8) == 0
+         && versao == TRILHA_VERSAO && tam_reg == sizeof(trilha_reg_t);
+}
+
+// imprime um registro, no formato da descrição da CPU na console
+static void imprime_registro(trilha_reg_t *reg)
+{
+  printf("%8llu %s PC=%04d A=%06d X=%06d", (unsigned long long)reg->num,
+         reg->modo == supervisor ? "SUP " : "usu ", reg->PC, reg->A, reg->X);
+  if (reg->opcode == -1) {
+    printf(" -- ???");
+  } else if (instrucao_nome(reg->opcode) == NULL) {
+    printf(" %02d ???", reg->opcode);
+  } else if (instrucao_num_args(reg->opcode) == 1) {
+    printf(" %02d %s %d", reg->opcode, instrucao_nome(reg->opcode), reg->A1);
+  } else {
+    printf(" %02d %s", reg->opcode, instrucao_nome(reg->opcode));
+  }
+  if (reg->erro != ERR_OK) {
+    printf(" E=%d %s", reg->erro, err_nome(reg->erro));
+  }
+  printf("\n");
+}
+
+int main(int argc, char *argv[argc])
+{
+  if (argc != 2) {
+    fprintf(stderr, "ERRO: chame como '%s arquivo_de_trilha'\n", argv[0]);
+    exit(1);
+  }
+  FILE *arq = fopen(argv[1], "rb");
+  if (arq == NULL) {
+    fprintf(stderr, "ERRO: não consegui abrir '%s'\n", argv[1]);
+    exit(1);
+  }
+  if (!le_cabecalho(arq)) {
+    fprintf(stderr, "ERRO: '%s' não é um arquivo de trilha\n", argv[1]);
+    exit(1);
+  }
+  trilha_reg_t reg;
+  uint64_t esperado = 0;
+  bool primeiro = true;
+  while (fread(&reg, sizeof(reg), 1, arq) == 1) {
+    // na gravação sob demanda, os registros sobrescritos no anel faltam
+    if (!primeiro && reg.num != esperado) {
+      printf("... %llu instruções não gravadas\n",
+             (unsigned long long)(reg.num - esperado));
+    }
+    imprime_registro(&reg);
+    esperado = reg.num + 1;
+    primeiro = false;
+  }
+  fclose(arq);
+  return 0;
+}
@@ -0,0 +1,51 @@
+// log.h
+// mensagens de log na console, com níveis de detalhe
+// simulador de computador
+// so24b
+
+#ifndef LOG_H
+#define LOG_H
+
+#include "console.h"
+
+// níveis das mensagens, do mais importante ao mais detalhado
+typedef enum {
+  LOG_ERRO,    // algo deu errado
+  LOG_INFO,    // acontecimentos importantes (carga de programa, fim...)
+  LOG_DEPURA,  // detalhes para depuração (despacho de processos...)
+  LOG_RASTRO,  // acontecimentos frequentes (cada interrupção, cada chamada...)
+  N_LOG_NIVEL
+} log_nivel_t;
+
+// nível mais detalhado que é compilado; as mensagens de níveis mais detalhados
+//   que ele são removidas do código (por exemplo, com
+//   'make CFLAGS+=-DLOG_NIVEL_COMPILADO=LOG_ERRO', só as de erro ficam)
+#ifndef LOG_NIVEL_COMPILADO
+#define LOG_NIVEL_COMPILADO LOG_RASTRO
+#endif
+
+// o nível mais detalhado que é mostrado durante a execução é definido em cada
+//   console, com console_define_nivel_log (inicialmente, LOG_RASTRO)
+
+// retorna o nível que tem o nome 'nome' ("erro", "info", "depura" ou
+//   "rastro"), ou -1 se não existir
+log_nivel_t log_nivel_do_nome(char *nome);
+
+// imprime uma mensagem na console 'console', formatada como em
+//   console_printf, se o nível da mensagem estiver habilitado
+// os argumentos só são avaliados (e a mensagem só é formatada) se o nível
+//   estiver habilitado
+#define log_msg(console, nivel, ...)                                  \
+  do {                                                                \
+    if ((nivel) <= LOG_NIVEL_COMPILADO                                \
+        && (nivel) <= console_nivel_log(console)) {                   \
+      console_printf((console), __VA_ARGS__);                         \
+    }                                                                 \
+  } while (0)
+
+#define log_erro(console, ...)   log_msg(console, LOG_ERRO, __VA_ARGS__)
+#define log_info(console, ...)   log_msg(console, LOG_INFO, __VA_ARGS__)
+#define log_depura(console, ...) log_msg(console, LOG_DEPURA, __VA_ARGS__)
+#define log_rastro(console, ...) log_msg(console, LOG_RASTRO, __VA_ARGS__)
+
+#endif // LOG_H
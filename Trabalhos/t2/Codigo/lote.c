@@ -0,0 +1,200 @@
+// lote.c
+// executa várias máquinas simuladas independentes, em várias threads
+// simulador de computador
+// so24b
+
+// cada máquina tem sua carga de trabalho, uma lista de programas que são
+//   executados um após o outro, cada um como programa inicial do SO em uma
+//   máquina recém criada, sem tela, até o SO terminar
+// as máquinas são distribuídas entre as threads, e no final é informado o
+//   número de instruções executadas por cada máquina e no total
+
+#include "maquina.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <assert.h>
+
+// uma carga de trabalho: a lista de programas a executar
+typedef struct {
+  char *descricao;   // como veio na linha de comando
+  int n_programas;
+  char **programas;
+} carga_t;
+
+// o resultado da execução de uma máquina
+typedef struct {
+  carga_t *carga;
+  long instrucoes;
+} resultado_t;
+
+// o que é compartilhado pelas threads
+typedef struct {
+  maquina_opcoes_t opcoes;
+  int n_maquinas;
+  resultado_t *resultados;
+  atomic_int proxima;    // próxima máquina a executar
+} lote_t;
+
+// ARGUMENTOS {{{1
+
+static void erro_uso(char *nome_prog)
+{
+  fprintf(stderr, "ERRO: chame como '%s [-j threads] [-n máquinas]"
+                  " [-m switch|predecod|jit]"
+                  " [-l erro|info|depura|rastro] [-v] carga...'\n", nome_prog);
+  fprintf(stderr, "  carga: programas separados por vírgula,"
+                  " por exemplo 'init.maq,p1.maq'\n");
+  fprintf(stderr, "  -j: número de threads (o padrão é o número de"
+                  " processadores)\n");
+  fprintf(stderr, "  -n: número de máquinas (o padrão é uma por carga;"
+                  " as cargas são repetidas se tiver mais máquinas)\n");
+  fprintf(stderr, "  -v: o SO usa uma tabela de páginas invertida no lugar da"
+                  " tabela de páginas\n");
+  exit(1);
+}
+
+// separa a descrição da carga nos nomes dos programas
+static void carga_inicializa(carga_t *self, char *descricao)
+{
+  self->descricao = descricao;
+  self->n_programas = 0;
+  self->programas = NULL;
+  char *copia = strdup(descricao);
+  assert(copia != NULL);
+  char *resto;
+  for (char *nome = strtok_r(copia, ",", &resto); nome != NULL;
+       nome = strtok_r(NULL, ",", &resto)) {
+    self->programas = realloc(self->programas,
+                              (self->n_programas + 1) * sizeof(char *));
+    assert(self->programas != NULL);
+    self->programas[self->n_programas++] = nome;
+  }
+}
+
+static int numero_positivo(char *nome_prog, char *arg)
+{
+  char *fim;
+  long n = strtol(arg, &fim, 10);
+  if (*fim != '\0' || n < 1) erro_uso(nome_prog);
+  return n;
+}
+
+// EXECUÇÃO {{{1
+
+// executa todos os programas da carga, retorna o número de instruções
+static long executa_carga(carga_t *carga, maquina_opcoes_t *opcoes_lote)
+{
+  long instrucoes = 0;
+  for (int i = 0; i < carga->n_programas; i++) {
+    maquina_opcoes_t opcoes = *opcoes_lote;
+    opcoes.programa = carga->programas[i];
+    maquina_t *maquina = maquina_cria(&opcoes);
+    maquina_executa(maquina);
+    instrucoes += maquina_instrucoes(maquina);
+    maquina_destroi(maquina);
+  }
+  return instrucoes;
+}
+
+// cada thread pega a próxima máquina a executar, até acabarem
+static void *trabalhadora(void *arg)
+{
+  lote_t *lote = arg;
+  for (;;) {
+    int m = atomic_fetch_add(&lote->proxima, 1);
+    if (m >= lote->n_maquinas) break;
+    resultado_t *r = &lote->resultados[m];
+    r->instrucoes = executa_carga(r->carga, &lote->opcoes);
+  }
+  return NULL;
+}
+
+static double agora(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// MAIN {{{1
+
+int main(int argc, char *argv[argc])
+{
+  lote_t lote;
+  int n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int n_maquinas = 0;
+  int n_cargas = 0;
+  carga_t cargas[argc];
+
+  maquina_opcoes_padrao(&lote.opcoes);
+  lote.opcoes.com_tela = false;
+  lote.opcoes.nivel_log = LOG_ERRO;
+  lote.opcoes.nome_log = NULL;
+  lote.opcoes.saida_padrao = false;
+
+  for (int argi = 1; argi < argc; argi++) {
+    if (strcmp(argv[argi], "-j") == 0 && argi + 1 < argc) {
+      n_threads = numero_positivo(argv[0], argv[++argi]);
+    } else if (strcmp(argv[argi], "-n") == 0 && argi + 1 < argc) {
+      n_maquinas = numero_positivo(argv[0], argv[++argi]);
+    } else if (strcmp(argv[argi], "-m") == 0 && argi + 1 < argc) {
+      lote.opcoes.motor = cpu_motor_do_nome(argv[++argi]);
+      if (lote.opcoes.motor == -1) erro_uso(argv[0]);
+    } else if (strcmp(argv[argi], "-l") == 0 && argi + 1 < argc) {
+      lote.opcoes.nivel_log = log_nivel_do_nome(argv[++argi]);
+      if (lote.opcoes.nivel_log == -1) erro_uso(argv[0]);
+    } else if (strcmp(argv[argi], "-v") == 0) {
+      lote.opcoes.tabela_invertida = true;
+    } else if (argv[argi][0] == '-') {
+      erro_uso(argv[0]);
+    } else {
+      carga_inicializa(&cargas[n_cargas++], argv[argi]);
+    }
+  }
+  if (n_cargas == 0) erro_uso(argv[0]);
+  if (n_maquinas == 0) n_maquinas = n_cargas;
+  if (n_threads > n_maquinas) n_threads = n_maquinas;
+
+  lote.n_maquinas = n_maquinas;
+  lote.resultados = malloc(n_maquinas * sizeof(resultado_t));
+  assert(lote.resultados != NULL);
+  for (int m = 0; m < n_maquinas; m++) {
+    lote.resultados[m].carga = &cargas[m % n_cargas];
+    lote.resultados[m].instrucoes = 0;
+  }
+  atomic_init(&lote.proxima, 0);
+
+  double inicio = agora();
+  pthread_t threads[n_threads];
+  for (int t = 0; t < n_threads; t++) {
+    int r = pthread_create(&threads[t], NULL, trabalhadora, &lote);
+    assert(r == 0);
+  }
+  for (int t = 0; t < n_threads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  double tempo = agora() - inicio;
+
+  long total = 0;
+  for (int m = 0; m < n_maquinas; m++) {
+    resultado_t *r = &lote.resultados[m];
+    printf("máquina %d (%s): %ld instruções\n", m, r->carga->descricao,
+           r->instrucoes);
+    total += r->instrucoes;
+  }
+  printf("total: %ld instruções em %.3f s com %d threads"
+         " (%.0f instruções/s)\n", total, tempo, n_threads,
+         tempo > 0 ? total / tempo : 0);
+
+  free(lote.resultados);
+  return 0;
+}
+
+// vim: foldmethod=marker
@@ -3,113 +3,182 @@
 // simulador de computador
 // so24b
 
-#include "controle.h"
-#include "memoria.h"
-#include "mmu.h"
-#include "cpu.h"
-#include "relogio.h"
-#include "console.h"
-#include "terminal.h"
-#include "es.h"
-#include "dispositivos.h"
-#include "so.h"
+#include "maquina.h"
+#include "log.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
 
-// constantes
-#define MEM_TAM 10000        // tamanho da memória principal
-
-// estrutura com os componentes do computador simulado
-typedef struct {
-  mem_t *mem;
-  mmu_t *mmu;
-  cpu_t *cpu;
-  relogio_t *relogio;
-  console_t *console;
-  es_t *es;
-  controle_t *controle;
-} hardware_t;
-
-static void cria_hardware(hardware_t *hw)
+static void erro_uso(char *nome_prog)
 {
-  // cria a memória e a MMU
-  hw->mem = mem_cria(MEM_TAM);
-  hw->mmu = mmu_cria(hw->mem);
-
-  // cria dispositivos de E/S
-  hw->console = console_cria();
-  hw->relogio = relogio_cria();
+  fprintf(stderr, "ERRO: chame como '%s [-m switch|predecod|jit] [-s]"
+                  " [-l erro|info|depura|rastro]"
+                  " [-e T=arquivo] [-o T=arquivo]"
+                  " [-r arquivo] [-g N=arquivo]"
+                  " [-i arquivo | -p arquivo] [-f arquivo]"
+                  " [-t arquivo | -T arquivo]"
+                  " [-b N,A,lru|fifo|aleatoria] [-v]'\n", nome_prog);
+  fprintf(stderr, "  -s: executa sem tela, até o SO terminar\n");
+  fprintf(stderr, "  -l: nível de detalhe das mensagens na console\n");
+  fprintf(stderr, "  -e: entrada do terminal T (A-D) vem do arquivo\n");
+  fprintf(stderr, "  -o: saída do terminal T (A-D) é copiada para o arquivo"
+                  " (sem tela, o padrão é a saída padrão)\n");
+  fprintf(stderr, "  -r: inicia no estado salvo no checkpoint\n");
+  fprintf(stderr, "  -g: grava um checkpoint quando o relógio chegar a N\n");
+  fprintf(stderr, "  -i: grava as entradas (terminais, comandos, relógio real)"
+                  " no arquivo\n");
+  fprintf(stderr, "  -p: reproduz as entradas gravadas no arquivo\n");
+  fprintf(stderr, "  -f: conta as instruções executadas e escreve o perfil de"
+                  " execução no arquivo, no final\n");
+  fprintf(stderr, "  -t: guarda a trilha das últimas instruções executadas, e"
+                  " grava no arquivo quando a CPU entra em erro ou com o"
+                  " comando T\n");
+  fprintf(stderr, "  -T: grava a trilha de todas as instruções executadas no"
+                  " arquivo\n");
+  fprintf(stderr, "  -b: TLB com N entradas (0 para não ter), em conjuntos de"
+                  " A, com a política de substituição (padrão 16,4,lru)\n");
+  fprintf(stderr, "  -v: o SO usa uma tabela de páginas invertida no lugar da"
+                  " tabela de páginas\n");
+  exit(1);
+}
 
-  // cria o controlador de E/S e registra os dispositivos
-  //   por exemplo, o dispositivo 8 do controlador de E/S (e da CPU) será o
-  //   dispositivo 0 do relógio (que é o contador de instruções)
-  hw->es = es_cria();
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal A
-  terminal_t *terminal;
-  terminal = console_terminal(hw->console, 'A');
-  es_registra_dispositivo(hw->es, D_TERM_A_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_A_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_A_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_A_TELA_OK    , terminal, 3, terminal_leitura, NULL);
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal B
-  terminal = console_terminal(hw->console, 'B');
-  es_registra_dispositivo(hw->es, D_TERM_B_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_B_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_B_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_B_TELA_OK    , terminal, 3, terminal_leitura, NULL);
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal C
-  terminal = console_terminal(hw->console, 'C');
-  es_registra_dispositivo(hw->es, D_TERM_C_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_C_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_C_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_C_TELA_OK    , terminal, 3, terminal_leitura, NULL);
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal D
-  terminal = console_terminal(hw->console, 'D');
-  es_registra_dispositivo(hw->es, D_TERM_D_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_D_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_D_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_D_TELA_OK    , terminal, 3, terminal_leitura, NULL);
-  // lê relógio virtual, relógio real
-  es_registra_dispositivo(hw->es, D_RELOGIO_INSTRUCOES, hw->relogio, 0, relogio_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_RELOGIO_REAL      , hw->relogio, 1, relogio_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_RELOGIO_TIMER     , hw->relogio, 2, relogio_leitura, relogio_escrita);
-  es_registra_dispositivo(hw->es, D_RELOGIO_INTERRUPCAO,hw->relogio, 3, relogio_leitura, relogio_escrita);
+// interpreta um argumento do tipo "T=arquivo", coloca o nome do arquivo na
+//   posição do terminal T em 'arquivos'
+static void verifica_arg_terminal(char *arg, char *arquivos[N_TERMINAIS])
+{
+  int terminal = toupper(arg[0]) - 'A';
+  if (terminal < 0 || terminal >= N_TERMINAIS || arg[1] != '=' || arg[2] == '\0') {
+    fprintf(stderr, "ERRO: terminal e arquivo inválidos: '%s'\n", arg);
+    exit(1);
+  }
+  arquivos[terminal] = &arg[2];
+}
 
-  // cria a unidade de execução e inicializa com a MMU e E/S
-  hw->cpu = cpu_cria(hw->mmu, hw->es);
+// interpreta um argumento do tipo "N=arquivo", para gravar um checkpoint
+//   no instante N
+static void verifica_arg_checkpoint(char *arg, maquina_opcoes_t *opcoes)
+{
+  char *fim;
+  long instante = strtol(arg, &fim, 10);
+  if (fim == arg || *fim != '=' || fim[1] == '\0' || instante < 0) {
+    fprintf(stderr, "ERRO: instante e arquivo inválidos: '%s'\n", arg);
+    exit(1);
+  }
+  opcoes->instante_grava = instante;
+  opcoes->grava = fim + 1;
+}
 
-  // cria o controlador da CPU e inicializa com a unidade de execução, a console e
-  //   o relógio
-  hw->controle = controle_cria(hw->cpu, hw->console, hw->relogio);
+// interpreta um argumento do tipo "N,A,politica", para configurar a TLB
+static void verifica_arg_tlb(char *arg, maquina_opcoes_t *opcoes)
+{
+  char *fim;
+  long entradas = strtol(arg, &fim, 10);
+  long associatividade = 1;
+  tlb_politica_t politica = TLB_LRU;
+  bool ok = fim != arg && entradas >= 0;
+  if (ok && entradas > 0) {
+    char *ini = fim + 1;
+    ok = *fim == ',';
+    if (ok) associatividade = strtol(ini, &fim, 10);
+    ok = ok && fim != ini && *fim == ','
+         && associatividade > 0 && entradas % associatividade == 0;
+    if (ok) politica = tlb_politica_do_nome(fim + 1);
+    ok = ok && politica != -1;
+  } else if (ok) {
+    ok = *fim == '\0';
+  }
+  if (!ok) {
+    fprintf(stderr, "ERRO: configuração de TLB inválida: '%s'\n", arg);
+    exit(1);
+  }
+  opcoes->tlb_entradas = entradas;
+  opcoes->tlb_associatividade = associatividade;
+  opcoes->tlb_politica = politica;
 }
 
-static void destroi_hardware(hardware_t *hw)
+static void verifica_args(int argc, char *argv[argc], maquina_opcoes_t *opcoes)
 {
-  controle_destroi(hw->controle);
-  cpu_destroi(hw->cpu);
-  es_destroi(hw->es);
-  relogio_destroi(hw->relogio);
-  console_destroi(hw->console);
-  mmu_destroi(hw->mmu);
-  mem_destroi(hw->mem);
+  maquina_opcoes_padrao(opcoes);
+  for (int argi = 1; argi < argc; argi++) {
+    if (strcmp(argv[argi], "-m") == 0) {
+      argi++;
+      if (argi >= argc) {
+        fprintf(stderr, "ERRO: falta o nome do motor após '-m'\n");
+        exit(1);
+      }
+      opcoes->motor = cpu_motor_do_nome(argv[argi]);
+      if (opcoes->motor == -1) {
+        fprintf(stderr, "ERRO: motor desconhecido: '%s'\n", argv[argi]);
+        exit(1);
+      }
+    } else if (strcmp(argv[argi], "-l") == 0 && argi + 1 < argc) {
+      argi++;
+      log_nivel_t nivel = log_nivel_do_nome(argv[argi]);
+      if (nivel == -1) {
+        fprintf(stderr, "ERRO: nível de log desconhecido: '%s'\n", argv[argi]);
+        exit(1);
+      }
+      opcoes->nivel_log = nivel;
+    } else if (strcmp(argv[argi], "-s") == 0) {
+      opcoes->com_tela = false;
+    } else if (strcmp(argv[argi], "-e") == 0 && argi + 1 < argc) {
+      argi++;
+      verifica_arg_terminal(argv[argi], opcoes->entrada);
+    } else if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) {
+      argi++;
+      verifica_arg_terminal(argv[argi], opcoes->saida);
+    } else if (strcmp(argv[argi], "-r") == 0 && argi + 1 < argc) {
+      argi++;
+      opcoes->restaura = argv[argi];
+    } else if (strcmp(argv[argi], "-i") == 0 && argi + 1 < argc) {
+      argi++;
+      opcoes->grava_entradas = argv[argi];
+    } else if (strcmp(argv[argi], "-p") == 0 && argi + 1 < argc) {
+      argi++;
+      opcoes->reproduz_entradas = argv[argi];
+    } else if (strcmp(argv[argi], "-f") == 0 && argi + 1 < argc) {
+      argi++;
+      opcoes->perfil = argv[argi];
+    } else if (strcmp(argv[argi], "-t") == 0 && argi + 1 < argc) {
+      argi++;
+      opcoes->trilha = argv[argi];
+      opcoes->trilha_continua = false;
+    } else if (strcmp(argv[argi], "-T") == 0 && argi + 1 < argc) {
+      argi++;
+      opcoes->trilha = argv[argi];
+      opcoes->trilha_continua = true;
+    } else if (strcmp(argv[argi], "-g") == 0 && argi + 1 < argc) {
+      argi++;
+      verifica_arg_checkpoint(argv[argi], opcoes);
+    } else if (strcmp(argv[argi], "-b") == 0 && argi + 1 < argc) {
+      argi++;
+      verifica_arg_tlb(argv[argi], opcoes);
+    } else if (strcmp(argv[argi], "-v") == 0) {
+      opcoes->tabela_invertida = true;
+    } else {
+      erro_uso(argv[0]);
+    }
+  }
+  if (opcoes->grava_entradas != NULL && opcoes->reproduz_entradas != NULL) {
+    erro_uso(argv[0]);
+  }
 }
 
-int main()
+int main(int argc, char *argv[argc])
 {
-  hardware_t hw;
-  so_t *so;
+  maquina_opcoes_t opcoes;
+
+  verifica_args(argc, argv, &opcoes);
+  // cria o hardware e o sistema operacional
+  maquina_t *maquina = maquina_cria(&opcoes);
 
-  // cria o hardware
-  cria_hardware(&hw);
-  // cria o sistema operacional
-  so = so_cria(hw.cpu, hw.mem, hw.mmu, hw.es, hw.console);
-  
   // executa o laço principal do controlador
-  controle_laco(hw.controle);
+  maquina_executa(maquina);
 
   // destroi tudo
-  so_destroi(so);
-  destroi_hardware(&hw);
+  maquina_destroi(maquina);
 }
 
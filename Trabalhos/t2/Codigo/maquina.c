@@ -0,0 +1,379 @@
+// maquina.c
+// um computador simulado completo (hardware e SO)
+// simulador de computador
+// so24b
+
+#include "maquina.h"
+#include "controle.h"
+#include "memoria.h"
+#include "mmu.h"
+#include "relogio.h"
+#include "console.h"
+#include "terminal.h"
+#include "es.h"
+#include "dispositivos.h"
+#include "so.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+// constantes
+#define MEM_TAM 10000        // tamanho da memória principal
+#define TAM_TRILHA 65536     // número de instruções no anel da trilha
+
+// estrutura com os componentes do computador simulado
+struct maquina_t {
+  mem_t *mem;
+  mmu_t *mmu;
+  cpu_t *cpu;
+  relogio_t *relogio;
+  console_t *console;
+  es_t *es;
+  controle_t *controle;
+  so_t *so;
+  // gravação ou reprodução das entradas externas (ou NULL)
+  gravacao_t *gravacao;
+  // perfil de execução (ou NULL), e onde escrever o relatório dele
+  perfil_t *perfil;
+  char *relatorio_perfil;
+  // trilha das instruções executadas (ou NULL)
+  trilha_t *trilha;
+  // true se termina quando o SO terminar (quando não tem tela)
+  bool termina_com_so;
+  // checkpoint a gravar, e quando
+  char *grava;
+  int instante_grava;
+  // arquivos de entrada e de saída dos terminais (NULL se não tem)
+  FILE *entrada[N_TERMINAIS];
+  FILE *saida[N_TERMINAIS];
+};
+
+void maquina_opcoes_padrao(maquina_opcoes_t *opcoes)
+{
+  opcoes->motor = CPU_MOTOR_SWITCH;
+  opcoes->com_tela = true;
+  opcoes->nivel_log = LOG_RASTRO;
+  opcoes->nome_log = "log_da_console";
+  opcoes->programa = NULL;
+  for (int t = 0; t < N_TERMINAIS; t++) {
+    opcoes->entrada[t] = NULL;
+    opcoes->saida[t] = NULL;
+  }
+  opcoes->saida_padrao = true;
+  opcoes->restaura = NULL;
+  opcoes->grava = NULL;
+  opcoes->instante_grava = 0;
+  opcoes->grava_entradas = NULL;
+  opcoes->reproduz_entradas = NULL;
+  opcoes->perfil = NULL;
+  opcoes->trilha = NULL;
+  opcoes->trilha_continua = false;
+  opcoes->tlb_entradas = 16;
+  opcoes->tlb_associatividade = 4;
+  opcoes->tlb_politica = TLB_LRU;
+  opcoes->tabela_invertida = false;
+}
+
+// CRIAÇÃO {{{1
+
+static FILE *abre_arquivo(char *nome, char *modo)
+{
+  FILE *arquivo = fopen(nome, modo);
+  if (arquivo == NULL) {
+    fprintf(stderr, "ERRO: não consegui abrir '%s'\n", nome);
+    exit(1);
+  }
+  return arquivo;
+}
+
+// liga os terminais aos arquivos de entrada e saída
+static void liga_terminais(maquina_t *self, maquina_opcoes_t *opcoes)
+{
+  static char *prefixos[N_TERMINAIS] = { "A: ", "B: ", "C: ", "D: " };
+  for (int t = 0; t < N_TERMINAIS; t++) {
+    terminal_t *terminal = console_terminal(self->console, 'A' + t);
+    self->entrada[t] = NULL;
+    self->saida[t] = NULL;
+    if (opcoes->entrada[t] != NULL) {
+      self->entrada[t] = abre_arquivo(opcoes->entrada[t], "r");
+      terminal_define_arquivo_entrada(terminal, self->entrada[t]);
+    }
+    if (opcoes->saida[t] != NULL) {
+      self->saida[t] = abre_arquivo(opcoes->saida[t], "w");
+      terminal_define_copia_saida(terminal, self->saida[t], "");
+    } else if (!opcoes->com_tela && opcoes->saida_padrao) {
+      // sem tela, a saída de todos os terminais vai para a saída padrão
+      terminal_define_copia_saida(terminal, stdout, prefixos[t]);
+    }
+  }
+}
+
+static void cria_hardware(maquina_t *self, maquina_opcoes_t *opcoes)
+{
+  // cria a memória e a MMU
+  self->mem = mem_cria(MEM_TAM);
+  self->mmu = mmu_cria(self->mem);
+  mmu_define_tlb(self->mmu, opcoes->tlb_entradas, opcoes->tlb_associatividade,
+                 opcoes->tlb_politica);
+
+  // cria dispositivos de E/S
+  self->console = console_cria(opcoes->com_tela, opcoes->nome_log);
+  console_define_nivel_log(self->console, opcoes->nivel_log);
+  liga_terminais(self, opcoes);
+  self->relogio = relogio_cria();
+  for (int t = 0; t < N_TERMINAIS; t++) {
+    terminal_define_relogio(console_terminal(self->console, 'A' + t),
+                            self->relogio);
+  }
+
+  // cria o controlador de E/S e registra os dispositivos
+  //   por exemplo, o dispositivo 8 do controlador de E/S (e da CPU) será o
+  //   dispositivo 0 do relógio (que é o contador de instruções)
+  self->es = es_cria();
+  // lê teclado, testa teclado, escreve tela, testa tela do terminal A
+  terminal_t *terminal;
+  terminal = console_terminal(self->console, 'A');
+  es_registra_dispositivo(self->es, D_TERM_A_TECLADO    , terminal, 0, terminal_leitura, NULL);
+  es_registra_dispositivo(self->es, D_TERM_A_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
+  es_registra_dispositivo(self->es, D_TERM_A_TELA       , terminal, 2, NULL, terminal_escrita);
+  es_registra_dispositivo(self->es, D_TERM_A_TELA_OK    , terminal, 3, terminal_leitura, NULL);
+  // lê teclado, testa teclado, escreve tela, testa tela do terminal B
+  terminal = console_terminal(self->console, 'B');
+  es_registra_dispositivo(self->es, D_TERM_B_TECLADO    , terminal, 0, terminal_leitura, NULL);
+  es_registra_dispositivo(self->es, D_TERM_B_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
+  es_registra_dispositivo(self->es, D_TERM_B_TELA       , terminal, 2, NULL, terminal_escrita);
+  es_registra_dispositivo(self->es, D_TERM_B_TELA_OK    , terminal, 3, terminal_leitura, NULL);
+  // lê teclado, testa teclado, escreve tela, testa tela do terminal C
+  terminal = console_terminal(self->console, 'C');
+  es_registra_dispositivo(self->es, D_TERM_C_TECLADO    , terminal, 0, terminal_leitura, NULL);
+  es_registra_dispositivo(self->es, D_TERM_C_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
+  es_registra_dispositivo(self->es, D_TERM_C_TELA       , terminal, 2, NULL, terminal_escrita);
+  es_registra_dispositivo(self->es, D_TERM_C_TELA_OK    , terminal, 3, terminal_leitura, NULL);
+  // lê teclado, testa teclado, escreve tela, testa tela do terminal D
+  terminal = console_terminal(self->console, 'D');
+  es_registra_dispositivo(self->es, D_TERM_D_TECLADO    , terminal, 0, terminal_leitura, NULL);
+  es_registra_dispositivo(self->es, D_TERM_D_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
+  es_registra_dispositivo(self->es, D_TERM_D_TELA       , terminal, 2, NULL, terminal_escrita);
+  es_registra_dispositivo(self->es, D_TERM_D_TELA_OK    , terminal, 3, terminal_leitura, NULL);
+  // lê relógio virtual, relógio real
+  es_registra_dispositivo(self->es, D_RELOGIO_INSTRUCOES, self->relogio, 0, relogio_leitura, NULL);
+  es_registra_dispositivo(self->es, D_RELOGIO_REAL      , self->relogio, 1, relogio_leitura, NULL);
+  es_registra_dispositivo(self->es, D_RELOGIO_TIMER     , self->relogio, 2, relogio_leitura, relogio_escrita);
+  es_registra_dispositivo(self->es, D_RELOGIO_INTERRUPCAO,self->relogio, 3, relogio_leitura, relogio_escrita);
+
+  // cria a unidade de execução e inicializa com a MMU e E/S
+  self->cpu = cpu_cria(self->mmu, self->es);
+  cpu_define_motor(self->cpu, opcoes->motor);
+  // o perfil tem que existir antes do SO, para saber das cargas de programas
+  self->perfil = NULL;
+  self->relatorio_perfil = opcoes->perfil;
+  if (opcoes->perfil != NULL) {
+    self->perfil = perfil_cria(MEM_TAM);
+    cpu_define_perfil(self->cpu, self->perfil);
+  }
+  self->trilha = NULL;
+  if (opcoes->trilha != NULL) {
+    self->trilha = trilha_cria(opcoes->trilha, TAM_TRILHA,
+                               opcoes->trilha_continua);
+    if (self->trilha == NULL) {
+      fprintf(stderr, "ERRO: não consegui criar a trilha '%s'\n",
+              opcoes->trilha);
+      exit(1);
+    }
+    cpu_define_trilha(self->cpu, self->trilha);
+  }
+
+  // cria o controlador da CPU e inicializa com a unidade de execução, a console e
+  //   o relógio
+  self->controle = controle_cria(self->cpu, self->console, self->relogio);
+}
+
+// cria a gravação ou reprodução das entradas externas, se pedida, e liga ela
+//   aos componentes que têm entradas externas
+static void liga_gravacao(maquina_t *self, maquina_opcoes_t *opcoes)
+{
+  self->gravacao = NULL;
+  char *nome = opcoes->grava_entradas;
+  grav_modo_t modo = GRAV_GRAVA;
+  if (opcoes->reproduz_entradas != NULL) {
+    nome = opcoes->reproduz_entradas;
+    modo = GRAV_REPRODUZ;
+  }
+  if (nome == NULL) return;
+  self->gravacao = gravacao_cria(nome, modo, self->relogio);
+  if (self->gravacao == NULL) {
+    fprintf(stderr, "ERRO: não consegui usar a gravação '%s'\n", nome);
+    exit(1);
+  }
+  relogio_define_gravacao(self->relogio, self->gravacao);
+  for (int t = 0; t < N_TERMINAIS; t++) {
+    terminal_define_gravacao(console_terminal(self->console, 'A' + t),
+                             self->gravacao, 'A' + t);
+  }
+  controle_define_gravacao(self->controle, self->gravacao);
+}
+
+static void destroi_hardware(maquina_t *self)
+{
+  controle_destroi(self->controle);
+  cpu_destroi(self->cpu);
+  es_destroi(self->es);
+  relogio_destroi(self->relogio);
+  console_destroi(self->console);
+  mmu_destroi(self->mmu);
+  mem_destroi(self->mem);
+  // os terminais já foram destruídos, pode fechar os arquivos
+  for (int t = 0; t < N_TERMINAIS; t++) {
+    if (self->entrada[t] != NULL) fclose(self->entrada[t]);
+    if (self->saida[t] != NULL) fclose(self->saida[t]);
+  }
+}
+
+// função chamada pelo controlador após cada sequência de instruções, para
+//   saber se a simulação terminou
+// aproveita para gravar o checkpoint, quando chega a hora
+static bool simulacao_terminou(void *arg)
+{
+  maquina_t *self = arg;
+  if (self->grava != NULL && maquina_instrucoes(self) >= self->instante_grava) {
+    if (maquina_salva(self, self->grava)) {
+      log_info(self->console, "checkpoint '%s' gravado no instante %d",
+               self->grava, maquina_instrucoes(self));
+    } else {
+      log_erro(self->console, "erro na gravação do checkpoint '%s'",
+               self->grava);
+    }
+    self->grava = NULL;
+  }
+  return self->termina_com_so && so_terminou(self->so);
+}
+
+maquina_t *maquina_cria(maquina_opcoes_t *opcoes)
+{
+  maquina_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+
+  // cria o hardware
+  cria_hardware(self, opcoes);
+  liga_gravacao(self, opcoes);
+  // cria o sistema operacional
+  self->so = so_cria(self->cpu, self->mem, self->mmu, self->es, self->console);
+  if (opcoes->tabela_invertida) so_usa_tabela_invertida(self->so);
+  if (opcoes->programa != NULL) {
+    so_define_programa_inicial(self->so, opcoes->programa);
+  }
+  if (opcoes->restaura != NULL && !maquina_restaura(self, opcoes->restaura)) {
+    fprintf(stderr, "ERRO: não consegui restaurar o checkpoint '%s'\n",
+            opcoes->restaura);
+    exit(1);
+  }
+  // sem tela, não tem operador para mandar terminar
+  self->termina_com_so = !opcoes->com_tela;
+  self->grava = opcoes->grava;
+  self->instante_grava = opcoes->instante_grava;
+  controle_define_fim(self->controle, simulacao_terminou, self);
+
+  return self;
+}
+
+// escreve o relatório do perfil de execução
+static void escreve_relatorio_perfil(maquina_t *self)
+{
+  FILE *arq = fopen(self->relatorio_perfil, "w");
+  if (arq == NULL) {
+    fprintf(stderr, "ERRO: não consegui criar o relatório do perfil '%s'\n",
+            self->relatorio_perfil);
+    return;
+  }
+  perfil_relatorio(self->perfil, arq);
+  fclose(arq);
+}
+
+// coloca as estatísticas da TLB na console
+static void informa_tlb(maquina_t *self)
+{
+  tlb_t *tlb = mmu_tlb(self->mmu);
+  if (tlb == NULL) return;
+  tlb_estatisticas_t estat = tlb_estatisticas(tlb);
+  long traducoes = estat.acertos + estat.faltas;
+  log_info(self->console, "TLB: %ld acertos, %ld faltas (%.1f%% de acertos),"
+           " %ld esvaziamentos", estat.acertos, estat.faltas,
+           traducoes == 0 ? 0.0 : 100.0 * estat.acertos / traducoes,
+           estat.esvaziamentos);
+}
+
+// coloca as estatísticas da tabela invertida na console
+static void informa_tabinv(maquina_t *self)
+{
+  tabinv_t *tabinv = mmu_tabinv(self->mmu);
+  if (tabinv == NULL) return;
+  tabinv_estatisticas_t estat = tabinv_estatisticas(tabinv);
+  log_info(self->console, "tabela invertida: %ld buscas, %.2f comparações"
+           " por busca", estat.buscas,
+           estat.buscas == 0 ? 0.0 : (double)estat.comparacoes / estat.buscas);
+}
+
+void maquina_destroi(maquina_t *self)
+{
+  informa_tlb(self);
+  informa_tabinv(self);
+  if (self->perfil != NULL) {
+    escreve_relatorio_perfil(self);
+    cpu_define_perfil(self->cpu, NULL);
+  }
+  so_destroi(self->so);
+  destroi_hardware(self);
+  if (self->gravacao != NULL) gravacao_destroi(self->gravacao);
+  if (self->perfil != NULL) perfil_destroi(self->perfil);
+  if (self->trilha != NULL) trilha_destroi(self->trilha);
+  free(self);
+}
+
+// EXECUÇÃO {{{1
+
+void maquina_executa(maquina_t *self)
+{
+  // executa o laço principal do controlador
+  controle_laco(self->controle);
+}
+
+int maquina_instrucoes(maquina_t *self)
+{
+  return relogio_agora(self->relogio);
+}
+
+// CHECKPOINT {{{1
+
+bool maquina_salva(maquina_t *self, char *nome)
+{
+  ckpt_t *ckpt = ckpt_cria(nome);
+  if (ckpt == NULL) return false;
+  cpu_salva(self->cpu, ckpt);
+  mmu_salva(self->mmu, ckpt);
+  relogio_salva(self->relogio, ckpt);
+  for (int t = 0; t < N_TERMINAIS; t++) {
+    terminal_salva(console_terminal(self->console, 'A' + t), ckpt);
+  }
+  so_salva(self->so, ckpt);
+  // a memória fica por último, alinhada a página no arquivo
+  mem_salva(self->mem, ckpt);
+  return ckpt_fecha(ckpt);
+}
+
+bool maquina_restaura(maquina_t *self, char *nome)
+{
+  ckpt_t *ckpt = ckpt_abre(nome);
+  if (ckpt == NULL) return false;
+  bool ok = cpu_restaura(self->cpu, ckpt)
+            && mmu_restaura(self->mmu, ckpt)
+            && relogio_restaura(self->relogio, ckpt);
+  for (int t = 0; ok && t < N_TERMINAIS; t++) {
+    ok = terminal_restaura(console_terminal(self->console, 'A' + t), ckpt);
+  }
+  ok = ok && so_restaura(self->so, ckpt) && mem_restaura(self->mem, ckpt);
+  return ckpt_fecha(ckpt) && ok;
+}
+
+// vim: foldmethod=marker
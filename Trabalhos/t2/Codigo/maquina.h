@@ -0,0 +1,92 @@
+// maquina.h
+// um computador simulado completo (hardware e SO)
+// simulador de computador
+// so24b
+
+#ifndef MAQUINA_H
+#define MAQUINA_H
+
+// a máquina não usa variáveis globais: várias máquinas podem existir e
+//   executar ao mesmo tempo, cada uma em sua thread (desde que só uma delas
+//   use a tela)
+
+#include "cpu.h"
+#include "tlb.h"
+
+#include <stdbool.h>
+
+#define N_TERMINAIS 4        // número de terminais ('A' a 'D')
+
+typedef struct maquina_t maquina_t;
+
+// opções de criação da máquina
+typedef struct {
+  cpu_motor_t motor;   // motor de execução da CPU
+  bool com_tela;       // false para executar sem a tela (em lote)
+  int nivel_log;       // nível de detalhe das mensagens na console (log.h)
+  char *nome_log;      // arquivo de log da console (NULL para não ter)
+  char *programa;      // programa inicial do SO (NULL para o padrão)
+  // nomes dos arquivos de entrada e de saída dos terminais (NULL se não tem)
+  char *entrada[N_TERMINAIS];
+  char *saida[N_TERMINAIS];
+  // sem tela, se a saída dos terminais sem arquivo vai para a saída padrão
+  bool saida_padrao;
+  // checkpoint de onde restaurar o estado inicial (NULL para iniciar do zero)
+  char *restaura;
+  // checkpoint a gravar quando o relógio chegar a 'instante_grava' (NULL
+  //   para não gravar)
+  char *grava;
+  int instante_grava;
+  // arquivo onde gravar as entradas externas (terminais, comandos, relógio
+  //   real), ou de onde reproduzi-las (NULL para nenhum; ver gravacao.h)
+  char *grava_entradas;
+  char *reproduz_entradas;
+  // arquivo onde escrever o relatório do perfil de execução, no fim da
+  //   simulação (NULL para não ter perfil; ver perfil.h)
+  char *perfil;
+  // arquivo onde gravar a trilha das instruções executadas (NULL para não
+  //   ter trilha), e se é gravada continuamente ou só quando a CPU entra em
+  //   erro ou o operador pede (ver trilha.h)
+  char *trilha;
+  bool trilha_continua;
+  // TLB da MMU: número de entradas (0 para não ter), associatividade e
+  //   política de substituição (ver tlb.h)
+  int tlb_entradas;
+  int tlb_associatividade;
+  tlb_politica_t tlb_politica;
+  // se o SO usa uma tabela de páginas invertida no lugar da tabela de
+  //   páginas (ver tabinv.h)
+  bool tabela_invertida;
+} maquina_opcoes_t;
+
+// coloca em 'opcoes' os valores padrão: motor switch, com tela, todas as
+//   mensagens, log em "log_da_console", programa padrão, sem arquivos nos
+//   terminais, sem perfil, sem trilha, TLB de 16 entradas associativa por
+//   conjuntos de 4, LRU, tabela de páginas normal
+void maquina_opcoes_padrao(maquina_opcoes_t *opcoes);
+
+// cria a máquina, com o hardware e o SO
+// sem tela, a simulação termina quando o SO terminar
+// se tiver checkpoint a restaurar ou gravação a reproduzir e não conseguir,
+//   imprime erro e termina o programa
+maquina_t *maquina_cria(maquina_opcoes_t *opcoes);
+// destrói a máquina; se tiver perfil, escreve o relatório antes, e se tiver
+//   TLB ou tabela invertida, coloca as estatísticas delas na console
+void maquina_destroi(maquina_t *self);
+
+// executa a simulação, até o fim
+void maquina_executa(maquina_t *self);
+
+// retorna o número de instruções executadas pela máquina
+int maquina_instrucoes(maquina_t *self);
+
+// salva o estado completo da máquina no checkpoint 'nome', ou restaura o
+//   estado dele
+// o estado dos componentes é salvo e restaurado nesta ordem: CPU, MMU,
+//   relógio, terminais, SO, memória
+// retornam false em caso de erro (uma restauração com erro pode deixar a
+//   máquina em um estado inconsistente)
+bool maquina_salva(maquina_t *self, char *nome);
+bool maquina_restaura(maquina_t *self, char *nome);
+
+#endif // MAQUINA_H
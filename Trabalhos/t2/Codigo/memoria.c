@@ -6,12 +6,18 @@
 #include "memoria.h"
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <assert.h>
 
 // tipo de dados para representar uma região de memória
 struct mem_t {
   int tam;
   int *conteudo;
+  // true se o conteúdo é um mapeamento de um checkpoint (e não foi alocado)
+  bool mapeado;
+  // função a chamar em cada alteração, e seu argumento
+  mem_f_alteracao_t observador;
+  void *arg_observador;
 };
 
 mem_t *mem_cria(int tam)
@@ -24,6 +30,8 @@ mem_t *mem_cria(int tam)
   assert(self->conteudo != NULL);
 
   self->tam = tam;
+  self->mapeado = false;
+  self->observador = NULL;
 
   return self;
 }
@@ -31,7 +39,9 @@ mem_t *mem_cria(int tam)
 void mem_destroi(mem_t *self)
 {
   if (self != NULL) {
-    if (self->conteudo != NULL) {
+    if (self->mapeado) {
+      ckpt_desmapeia(self->conteudo, self->tam * sizeof(*(self->conteudo)));
+    } else if (self->conteudo != NULL) {
       free(self->conteudo);
     }
     free(self);
@@ -66,6 +76,38 @@ err_t mem_escreve(mem_t *self, int endereco, int valor)
   err_t err = verifica_permissao(self, endereco);
   if (err == ERR_OK) {
     self->conteudo[endereco] = valor;
+    if (self->observador != NULL) {
+      self->observador(self->arg_observador, endereco);
+    }
   }
   return err;
 }
+
+void mem_define_observador(mem_t *self, mem_f_alteracao_t func, void *arg)
+{
+  self->observador = func;
+  self->arg_observador = arg;
+}
+
+void mem_salva(mem_t *self, ckpt_t *ckpt)
+{
+  ckpt_escreve(ckpt, &self->tam, sizeof(self->tam));
+  ckpt_escreve_paginas(ckpt, self->conteudo, self->tam * sizeof(*(self->conteudo)));
+}
+
+bool mem_restaura(mem_t *self, ckpt_t *ckpt)
+{
+  int tam;
+  if (!ckpt_le(ckpt, &tam, sizeof(tam)) || tam != self->tam) return false;
+  // o conteúdo não é copiado, a memória passa a usar o mapeamento
+  int *conteudo = ckpt_mapeia(ckpt, tam * sizeof(*conteudo));
+  if (conteudo == NULL) return false;
+  if (self->mapeado) {
+    ckpt_desmapeia(self->conteudo, self->tam * sizeof(*(self->conteudo)));
+  } else {
+    free(self->conteudo);
+  }
+  self->conteudo = conteudo;
+  self->mapeado = true;
+  return true;
+}
@@ -7,6 +7,7 @@
 #define MEMORIA_H
 
 #include "err.h"
+#include "checkpoint.h"
 
 // tipo opaco que representa a memória
 typedef struct mem_t mem_t;
@@ -31,4 +32,24 @@ err_t mem_le(mem_t *self, int endereco, int *pvalor);
 // retorna erro ERR_END_INV se endereço inválido
 err_t mem_escreve(mem_t *self, int endereco, int valor);
 
+// tipo da função chamada quando a memória é alterada, com o endereço alterado
+typedef void (*mem_f_alteracao_t)(void *arg, int endereco);
+
+// define a função a chamar após cada escrita bem sucedida na memória, e o
+//   argumento a passar para ela (para quem mantém cópias do conteúdo da
+//   memória, como a cache de instruções da CPU)
+// se 'func' for NULL, não chama nada
+void mem_define_observador(mem_t *self, mem_f_alteracao_t func, void *arg);
+
+// salva o conteúdo da memória no checkpoint
+void mem_salva(mem_t *self, ckpt_t *ckpt);
+
+// restaura o conteúdo da memória do checkpoint, que deve ter sido salvo por
+//   uma memória do mesmo tamanho; retorna false se não for possível
+// o conteúdo não é copiado: a memória passa a usar um mapeamento privado do
+//   arquivo, e as páginas só são lidas quando acessadas
+// quem tem cópia do conteúdo da memória não é avisado (o observador não é
+//   chamado)
+bool mem_restaura(mem_t *self, ckpt_t *ckpt);
+
 #endif // MEMORIA_H
@@ -13,6 +13,19 @@ struct mmu_t {
   mem_t *mem;
   // tabela de páginas
   tabpag_t *tabpag;
+  // tabela invertida, usada no lugar da tabela de páginas (NULL se não)
+  tabinv_t *tabinv;
+  // tabela invertida cujas alterações são observadas (continua sendo
+  //   observada quando deixa de ser usada, até ser trocada ou destruída)
+  tabinv_t *tabinv_observada;
+  // identificador das traduções da tabela na TLB
+  int asid;
+  // tabela de páginas de cada ASID (NULL se nenhuma), para saber quais
+  //   traduções invalidar quando uma tabela é alterada
+  tabpag_t **tabpag_do_asid;
+  int n_asids;
+  // cache das traduções (NULL se não tem)
+  tlb_t *tlb;
 };
 
 mmu_t *mmu_cria(mem_t *mem)
@@ -22,6 +35,12 @@ mmu_t *mmu_cria(mem_t *mem)
   assert(self != NULL);
   self->mem = mem;
   self->tabpag = NULL;
+  self->tabinv = NULL;
+  self->tabinv_observada = NULL;
+  self->asid = 0;
+  self->tabpag_do_asid = NULL;
+  self->n_asids = 0;
+  self->tlb = NULL;
   return self;
 }
 
@@ -29,35 +48,239 @@ void mmu_destroi(mmu_t *self)
 {
   if (self != NULL) {
     // nem a tabela de páginas nem a memória pertencem à MMU, não são liberadas aqui
+    // as tabelas deixam de avisar a MMU
+    for (int asid = 0; asid < self->n_asids; asid++) {
+      tabpag_t *tabpag = self->tabpag_do_asid[asid];
+      if (tabpag != NULL) tabpag_define_observador(tabpag, NULL, NULL);
+    }
+    if (self->tabinv_observada != NULL) {
+      tabinv_define_observador(self->tabinv_observada, NULL, NULL);
+    }
+    free(self->tabpag_do_asid);
+    if (self->tlb != NULL) tlb_destroi(self->tlb);
     free(self);
   }
 }
 
-void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag)
+void mmu_define_tlb(mmu_t *self, int entradas, int associatividade,
+                    tlb_politica_t politica)
+{
+  if (self->tlb != NULL) {
+    tlb_destroi(self->tlb);
+    self->tlb = NULL;
+  }
+  if (entradas > 0) {
+    self->tlb = tlb_cria(entradas, associatividade, politica);
+  }
+}
+
+tlb_t *mmu_tlb(mmu_t *self)
+{
+  return self->tlb;
+}
+
+tabinv_t *mmu_tabinv(mmu_t *self)
+{
+  return self->tabinv;
+}
+
+// função chamada pelas tabelas de páginas registradas quando a tradução de
+//   uma página muda (ou a tabela é destruída, com página -1)
+static void mmu__tabpag_alterada(void *arg, tabpag_t *tabpag, int pagina)
+{
+  mmu_t *self = arg;
+  for (int asid = 0; asid < self->n_asids; asid++) {
+    if (self->tabpag_do_asid[asid] != tabpag) continue;
+    if (pagina < 0) {
+      mmu_invalida_asid(self, asid);
+      self->tabpag_do_asid[asid] = NULL;
+    } else {
+      mmu_invalida_pagina(self, asid, pagina);
+    }
+  }
+}
+
+// associa a tabela ao ASID, e passa a observar as alterações nela
+static void mmu__registra_asid(mmu_t *self, int asid, tabpag_t *tabpag)
+{
+  if (asid >= self->n_asids) {
+    self->tabpag_do_asid = realloc(self->tabpag_do_asid,
+                                   (asid + 1) * sizeof(tabpag_t *));
+    assert(self->tabpag_do_asid != NULL);
+    while (self->n_asids <= asid) {
+      self->tabpag_do_asid[self->n_asids++] = NULL;
+    }
+  }
+  tabpag_t *antiga = self->tabpag_do_asid[asid];
+  if (antiga == tabpag) return;
+  self->tabpag_do_asid[asid] = tabpag;
+  if (antiga != NULL) {
+    // as traduções do ASID que estão na TLB são da tabela antiga
+    mmu_invalida_asid(self, asid);
+    // a tabela antiga deixa de avisar a MMU, se não está em outro ASID
+    bool em_uso = false;
+    for (int a = 0; a < self->n_asids; a++) {
+      if (self->tabpag_do_asid[a] == antiga) em_uso = true;
+    }
+    if (!em_uso) tabpag_define_observador(antiga, NULL, NULL);
+  }
+  tabpag_define_observador(tabpag, mmu__tabpag_alterada, self);
+}
+
+void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag, int asid)
 {
+  assert(asid >= 0);
+  if (tabpag != NULL) mmu__registra_asid(self, asid, tabpag);
   self->tabpag = tabpag;
+  self->tabinv = NULL;
+  self->asid = asid;
+}
+
+// função chamada pela tabela invertida observada quando a tradução de uma
+//   página muda (página -1 para todas do ASID, ASID -1 quando a tabela é
+//   destruída)
+static void mmu__tabinv_alterada(void *arg, int asid, int pagina)
+{
+  mmu_t *self = arg;
+  if (asid < 0) {
+    mmu_esvazia_tlb(self);
+    if (self->tabinv == self->tabinv_observada) self->tabinv = NULL;
+    self->tabinv_observada = NULL;
+  } else if (pagina < 0) {
+    mmu_invalida_asid(self, asid);
+  } else {
+    mmu_invalida_pagina(self, asid, pagina);
+  }
+}
+
+void mmu_define_tabinv(mmu_t *self, tabinv_t *tabinv, int asid)
+{
+  assert(asid >= 0);
+  if (tabinv != NULL && tabinv != self->tabinv_observada) {
+    // as traduções da TLB podem ser da tabela antiga
+    if (self->tabinv_observada != NULL) {
+      tabinv_define_observador(self->tabinv_observada, NULL, NULL);
+      mmu_esvazia_tlb(self);
+    }
+    tabinv_define_observador(tabinv, mmu__tabinv_alterada, self);
+    self->tabinv_observada = tabinv;
+  }
+  self->tabpag = NULL;
+  self->tabinv = tabinv;
+  self->asid = asid;
+}
+
+void mmu_invalida_pagina(mmu_t *self, int asid, int pagina)
+{
+  if (self->tlb != NULL) tlb_invalida_pagina(self->tlb, asid, pagina);
+}
+
+void mmu_invalida_asid(mmu_t *self, int asid)
+{
+  if (self->tlb != NULL) tlb_invalida_asid(self->tlb, asid);
+}
+
+void mmu_esvazia_tlb(mmu_t *self)
+{
+  if (self->tlb != NULL) tlb_esvazia(self->tlb);
+}
+
+mem_t *mmu_memoria(mmu_t *self)
+{
+  return self->mem;
+}
+
+void mmu_salva(mmu_t *self, ckpt_t *ckpt)
+{
+  bool tem_tlb = self->tlb != NULL;
+  ckpt_escreve(ckpt, &self->asid, sizeof(self->asid));
+  ckpt_escreve(ckpt, &tem_tlb, sizeof(tem_tlb));
+  if (tem_tlb) tlb_salva(self->tlb, ckpt);
+}
+
+bool mmu_restaura(mmu_t *self, ckpt_t *ckpt)
+{
+  int asid;
+  bool tem_tlb;
+  ckpt_le(ckpt, &asid, sizeof(asid));
+  if (!ckpt_le(ckpt, &tem_tlb, sizeof(tem_tlb)) || asid < 0) return false;
+  tlb_t *tlb = NULL;
+  if (tem_tlb) {
+    tlb = tlb_restaura(ckpt);
+    if (tlb == NULL) return false;
+  }
+  if (self->tlb != NULL) tlb_destroi(self->tlb);
+  self->tlb = tlb;
+  self->asid = asid;
+  return true;
 }
 
 // tradur o endereço virtual 'endvirt', colocando o endereço físico
 //   correspondente em 'pendfis'.
 // retorna ERR_OK ou um erro se a tradução não for possível
+// a tradução é procurada primeiro na TLB, e só se não estiver lá é feita
+//   pela tabela de páginas (e colocada na TLB)
 static err_t mmu__traduz(mmu_t *self, int endvirt, int *pendfis)
 {
   int pagina = endvirt / TAM_PAGINA;
   int deslocamento = endvirt % TAM_PAGINA;
   int quadro;
-  err_t err = tabpag_traduz(self->tabpag, pagina, &quadro);
-  if (err == ERR_OK) {
-    *pendfis = quadro * TAM_PAGINA + deslocamento;
+  if (self->tlb == NULL || !tlb_traduz(self->tlb, self->asid, pagina, &quadro)) {
+    err_t err;
+    if (self->tabinv != NULL) {
+      err = tabinv_traduz(self->tabinv, self->asid, pagina, &quadro);
+    } else {
+      err = tabpag_traduz(self->tabpag, pagina, &quadro);
+    }
+    if (err != ERR_OK) return err;
+    if (self->tlb != NULL) tlb_insere(self->tlb, self->asid, pagina, quadro);
   }
-  return err;
+  *pendfis = quadro * TAM_PAGINA + deslocamento;
+  return ERR_OK;
+}
+
+// marca o acesso à página (e a alteração, se 'alteracao' for true)
+// com TLB, a tabela de páginas só é alterada se a entrada da TLB ainda não
+//   tinha o bit marcado
+static void mmu__marca_acesso(mmu_t *self, int pagina, bool alteracao)
+{
+  if (self->tlb == NULL
+      || tlb_marca_bit_acesso(self->tlb, self->asid, pagina, alteracao)) {
+    if (self->tabinv != NULL) {
+      tabinv_marca_bit_acesso(self->tabinv, self->asid, pagina, alteracao);
+    } else {
+      tabpag_marca_bit_acesso(self->tabpag, pagina, alteracao);
+    }
+  }
+}
+
+// retorna true se o acesso no modo 'modo' é feito sem tradução de endereços
+//   (em modo supervisor, ou sem tabela de páginas)
+static bool mmu__sem_traducao(mmu_t *self, cpu_modo_t modo)
+{
+  return modo == supervisor || (self->tabpag == NULL && self->tabinv == NULL);
+}
+
+err_t mmu_traduz(mmu_t *self, int endvirt, int *pendfis, cpu_modo_t modo)
+{
+  int endfis = endvirt;
+  if (!mmu__sem_traducao(self, modo)) {
+    err_t err = mmu__traduz(self, endvirt, &endfis);
+    if (err != ERR_OK) return err;
+  }
+  if (endfis < 0 || endfis >= mem_tam(self->mem)) return ERR_END_INV;
+  if (!mmu__sem_traducao(self, modo)) {
+    mmu__marca_acesso(self, endvirt / TAM_PAGINA, false);
+  }
+  *pendfis = endfis;
+  return ERR_OK;
 }
 
 err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo)
 {
   // em modo supervisor ou se não tiver tabela de páginas,
   //   não faz tradução de endereços, nem marca o acesso
-  if (modo == supervisor || self->tabpag == NULL) {
+  if (mmu__sem_traducao(self, modo)) {
     return mem_le(self->mem, endvirt, pvalor);
   }
   int endfis;
@@ -65,9 +288,75 @@ err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo)
   if (err == ERR_OK) {
     err = mem_le(self->mem, endfis, pvalor);
     if (err == ERR_OK) {
-      tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, false);
+      mmu__marca_acesso(self, endvirt / TAM_PAGINA, false);
+    }
+  }
+  return err;
+}
+
+err_t mmu_le_bloco(mmu_t *self, int endvirt, int n, int valores[n],
+                   int *plidos, cpu_modo_t modo)
+{
+  err_t err = ERR_OK;
+  int lidos;
+  if (mmu__sem_traducao(self, modo)) {
+    for (lidos = 0; lidos < n; lidos++) {
+      err = mem_le(self->mem, endvirt + lidos, &valores[lidos]);
+      if (err != ERR_OK) break;
+    }
+    *plidos = lidos;
+    return err;
+  }
+  int endfis = 0;
+  for (lidos = 0; lidos < n; lidos++) {
+    int end = endvirt + lidos;
+    // só traduz no início do bloco e quando muda de página
+    bool nova_pagina = (lidos == 0 || end % TAM_PAGINA == 0);
+    if (nova_pagina) {
+      err = mmu__traduz(self, end, &endfis);
+      if (err != ERR_OK) break;
+    }
+    err = mem_le(self->mem, endfis, &valores[lidos]);
+    if (err != ERR_OK) break;
+    if (nova_pagina) {
+      mmu__marca_acesso(self, end / TAM_PAGINA, false);
+    }
+    endfis++;
+  }
+  *plidos = lidos;
+  return err;
+}
+
+err_t mmu_escreve_bloco(mmu_t *self, int endvirt, int n, int valores[n],
+                        int *pescritos, cpu_modo_t modo)
+{
+  err_t err = ERR_OK;
+  int escritos;
+  if (mmu__sem_traducao(self, modo)) {
+    for (escritos = 0; escritos < n; escritos++) {
+      err = mem_escreve(self->mem, endvirt + escritos, valores[escritos]);
+      if (err != ERR_OK) break;
+    }
+    *pescritos = escritos;
+    return err;
+  }
+  int endfis = 0;
+  for (escritos = 0; escritos < n; escritos++) {
+    int end = endvirt + escritos;
+    // só traduz no início do bloco e quando muda de página
+    bool nova_pagina = (escritos == 0 || end % TAM_PAGINA == 0);
+    if (nova_pagina) {
+      err = mmu__traduz(self, end, &endfis);
+      if (err != ERR_OK) break;
+    }
+    err = mem_escreve(self->mem, endfis, valores[escritos]);
+    if (err != ERR_OK) break;
+    if (nova_pagina) {
+      mmu__marca_acesso(self, end / TAM_PAGINA, true);
     }
+    endfis++;
   }
+  *pescritos = escritos;
   return err;
 }
 
@@ -75,7 +364,7 @@ err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo)
 {
   // em modo supervisor ou se não tiver tabela de páginas,
   //   não faz tradução de endereços, nem marca o acesso
-  if (modo == supervisor || self->tabpag == NULL) {
+  if (mmu__sem_traducao(self, modo)) {
     return mem_escreve(self->mem, endvirt, valor);
   }
   int endfis;
@@ -83,7 +372,7 @@ err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo)
   if (err == ERR_OK) {
     err = mem_escreve(self->mem, endfis, valor);
     if (err == ERR_OK) {
-      tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, true);
+      mmu__marca_acesso(self, endvirt / TAM_PAGINA, true);
     }
   }
   return err;
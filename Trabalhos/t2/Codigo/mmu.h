@@ -10,11 +10,28 @@
 // realiza a tradução de endereços virtuais do espaço de endereçamento
 //   de um processo em endereços físicos da memória principal
 // implementa memória virtual por paginação
+// pode ter uma TLB (ver tlb.h), que guarda as traduções mais recentes
+// cada tabela de páginas entregue à MMU vem com um identificador de espaço de
+//   endereçamento (ASID), que marca as traduções dela na TLB; com um ASID
+//   diferente para cada processo, as traduções de um processo continuam na
+//   TLB enquanto outros executam, e são reaproveitadas quando ele volta
+// a MMU se registra como observadora das tabelas que recebe, e as alterações
+//   feitas com tabpag_define_quadro, tabpag_invalida_pagina e
+//   tabpag_zera_bit_acesso (e a destruição da tabela) retiram da TLB as
+//   traduções afetadas; as funções mmu_invalida_* permitem invalidar
+//   explicitamente
+// no lugar das tabelas por processo, a MMU pode usar uma tabela de páginas
+//   invertida (ver tabinv.h), comum a todos os espaços de endereçamento; a
+//   MMU também observa as alterações nessa tabela
+// um mesmo ASID não deve ser usado com os dois tipos de tabela sem que as
+//   traduções dele sejam antes invalidadas (mmu_invalida_asid)
 
 // tipo opaco que representa a MMU
 typedef struct mmu_t mmu_t;
 
 #include "tabpag.h"
+#include "tabinv.h"
+#include "tlb.h"
 #include "memoria.h"
 #include "err.h"
 #include "cpu.h"
@@ -34,9 +51,57 @@ mmu_t *mmu_cria(mem_t *mem);
 // nenhuma outra operação pode ser realizada na MMU após esta chamada
 void mmu_destroi(mmu_t *self);
 
-// define a tabela de páginas a usar nas próximas traduções
+// define a TLB da MMU, com 'entradas' entradas em conjuntos de
+//   'associatividade' entradas, substituídas conforme 'politica'
+// com 0 entradas, a MMU fica sem TLB (o padrão)
+// a TLB anterior, se houver, é esvaziada e descartada
+void mmu_define_tlb(mmu_t *self, int entradas, int associatividade,
+                    tlb_politica_t politica);
+
+// retorna a TLB da MMU (para consultar as estatísticas), ou NULL se não tem
+tlb_t *mmu_tlb(mmu_t *self);
+
+// retorna a tabela invertida em uso pela MMU (para consultar as
+//   estatísticas), ou NULL se ela usa uma tabela de páginas
+tabinv_t *mmu_tabinv(mmu_t *self);
+
+// define a tabela de páginas a usar nas próximas traduções, e o ASID
+//   (>= 0) que identifica as traduções dela na TLB
 // se tabpag for NULL, os acessos serão repassados sem alteração à memória
-void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag);
+// a TLB não é esvaziada; se o ASID estava sendo usado com outra tabela, as
+//   traduções dele são retiradas da TLB
+// a tabela invertida, se estava em uso, deixa de ser usada
+void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag, int asid);
+
+// define a tabela de páginas invertida a usar nas próximas traduções, e o
+//   ASID do espaço de endereçamento a traduzir
+// se tabinv for NULL, os acessos serão repassados sem alteração à memória
+// a tabela de páginas, se estava em uso, deixa de ser usada
+// a TLB só é esvaziada se a tabela invertida for outra
+void mmu_define_tabinv(mmu_t *self, tabinv_t *tabinv, int asid);
+
+// retira da TLB a página 'pagina' do espaço 'asid'
+void mmu_invalida_pagina(mmu_t *self, int asid, int pagina);
+
+// retira da TLB todas as páginas do espaço 'asid' (para quando o ASID for
+//   reaproveitado por outro processo sem que a tabela antiga tenha sido
+//   destruída, por exemplo)
+void mmu_invalida_asid(mmu_t *self, int asid);
+
+// retira todas as páginas da TLB, de todos os espaços
+void mmu_esvazia_tlb(mmu_t *self);
+
+// retorna a memória física gerenciada pela MMU
+mem_t *mmu_memoria(mmu_t *self);
+
+// traduz o endereço virtual 'endvirt' para o endereço físico correspondente,
+//   colocado em '*pendfis', como seria feito em uma leitura (inclusive marcando
+//   a página como acessada)
+// retorna erro se a tradução não for possível ou se o endereço físico
+//   resultante não existir na memória
+// em modo supervisor ou sem tabela de páginas (nem invertida), o endereço não
+//   é traduzido
+err_t mmu_traduz(mmu_t *self, int endvirt, int *pendfis, cpu_modo_t modo);
 
 // coloca na posição apontada por 'pvalor' o valor que está na memória
 //   no endereço físico correspondente ao endereço virtual 'endvirt'
@@ -48,6 +113,27 @@ void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag);
 //   à memória sem tradução
 err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo);
 
+// lê 'n' valores de posições consecutivas da memória virtual, a partir de
+//   'endvirt', e coloca no vetor 'valores'
+// a tradução de endereço é feita uma vez por página, não uma vez por valor
+// coloca em '*plidos' o número de valores lidos com sucesso; em caso de erro,
+//   os valores anteriores ao que causou o erro foram lidos e as páginas deles
+//   foram marcadas como acessadas, como em chamadas a mmu_le
+// retorna o erro do primeiro acesso que não foi possível, ou ERR_OK
+err_t mmu_le_bloco(mmu_t *self, int endvirt, int n, int valores[n],
+                   int *plidos, cpu_modo_t modo);
+
+// coloca os 'n' valores do vetor 'valores' em posições consecutivas da
+//   memória virtual, a partir de 'endvirt'
+// a tradução de endereço é feita uma vez por página, não uma vez por valor
+// coloca em '*pescritos' o número de valores escritos com sucesso; em caso de
+//   erro, os valores anteriores ao que causou o erro foram escritos e as
+//   páginas deles foram marcadas como acessadas e alteradas, como em chamadas
+//   a mmu_escreve
+// retorna o erro do primeiro acesso que não foi possível, ou ERR_OK
+err_t mmu_escreve_bloco(mmu_t *self, int endvirt, int n, int valores[n],
+                        int *pescritos, cpu_modo_t modo);
+
 // coloca 'valor' no endereço físico da memória correspondente ao endereço
 //   virtual 'endvirt'
 // marca a página como acessada e alterada se o acesso for bem sucedido
@@ -58,4 +144,10 @@ err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo);
 //   à memória sem tradução
 err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo);
 
+// salva e restaura o estado da MMU (o ASID em uso e a TLB) em um checkpoint
+// a tabela de páginas é do SO, e não é salva aqui
+// mmu_restaura retorna false se não for possível
+void mmu_salva(mmu_t *self, ckpt_t *ckpt);
+bool mmu_restaura(mmu_t *self, ckpt_t *ckpt);
+
 #endif // MMU_H
@@ -34,128 +34,184 @@ bool tem_numero(char *s, int *num)
   return false;
 }
 
-// MEMÓRIA DE SAÍDA {{{1
-
-// representa a memória do programa -- a saída do montador é colocada aqui
+// ESTADO DO MONTADOR {{{1
 
 #define MEM_TAM 10000    // aumentar para programas maiores
-int mem[MEM_TAM];
-int mem_pos = 0;        // próxima posição livre da memória
-int mem_min = -1;       // menor endereço preenchido
-int mem_max = -1;       // maior endereço preenchido
+#define SIMB_TAM 1000
+#define REF_TAM 1000
+
+// todo o estado de uma montagem -- as funções recebem um ponteiro para ele
+typedef struct {
+  // representa a memória do programa -- a saída do montador é colocada aqui
+  int mem[MEM_TAM];
+  int mem_pos;        // próxima posição livre da memória
+  int mem_min;        // menor endereço preenchido
+  int mem_max;        // maior endereço preenchido
+  int linha[MEM_TAM]; // linha do fonte que gerou cada posição da memória
+  int linha_atual;    // linha do fonte sendo montada
+
+  // tabela com os símbolos (labels) já definidos pelo programa, e o valor
+  //   (endereço) deles
+  struct {
+    char *nome;
+    int valor;
+    bool rotulo;      // true se é um label de endereço, false se DEFINE
+  } simbolo[SIMB_TAM];
+  int simb_num;       // número d símbolos na tabela
+
+  // tabela com referências a símbolos
+  //   contém a linha e o endereço correspondente onde o símbolo foi
+  //   referenciado
+  struct {
+    char *nome;
+    int linha;
+    int endereco;
+  } ref[REF_TAM];
+  int ref_num;        // numero de referências criadas
+
+  char *nome_fonte;   // nome do arquivo fonte a montar
+  char *nome_mapa;    // onde gravar o mapa de símbolos (NULL se não grava)
+} montador_t;
+
+montador_t *montador_cria(void)
+{
+  montador_t *self = malloc(sizeof(*self));
+  if (self == NULL) erro_brabo("sem memória para o montador");
+  self->mem_pos = 0;
+  self->mem_min = -1;
+  self->mem_max = -1;
+  self->simb_num = 0;
+  self->ref_num = 0;
+  self->linha_atual = 0;
+  self->nome_fonte = NULL;
+  self->nome_mapa = NULL;
+  return self;
+}
+
+void montador_destroi(montador_t *self)
+{
+  for (int i = 0; i < self->simb_num; i++) free(self->simbolo[i].nome);
+  for (int i = 0; i < self->ref_num; i++) free(self->ref[i].nome);
+  free(self);
+}
 
-char *nome_fonte;   // nome do arquivo fonte a montar
+// MEMÓRIA DE SAÍDA {{{1
 
 // coloca um valor no final da memória
-void mem_insere(int val)
+void mem_insere(montador_t *self, int val)
 {
-  if (mem_pos >= MEM_TAM-1) {
+  if (self->mem_pos >= MEM_TAM-1) {
     erro_brabo("programa muito grande! Aumente MEM_TAM no montador.");
   }
-  if (mem_min == -1 || mem_pos < mem_min) mem_min = mem_pos;
-  if (mem_max == -1 || mem_pos > mem_max) mem_max = mem_pos;
-  mem[mem_pos++] = val;
+  if (self->mem_min == -1 || self->mem_pos < self->mem_min) self->mem_min = self->mem_pos;
+  if (self->mem_max == -1 || self->mem_pos > self->mem_max) self->mem_max = self->mem_pos;
+  self->linha[self->mem_pos] = self->linha_atual;
+  self->mem[self->mem_pos++] = val;
 }
 
 // altera o valor em uma posição já ocupada da memória
-void mem_altera(int pos, int val)
+void mem_altera(montador_t *self, int pos, int val)
 {
-  if (pos < mem_min || pos > mem_max) {
+  if (pos < self->mem_min || pos > self->mem_max) {
     erro_brabo("erro interno, alteração de região não inicializada");
   }
-  mem[pos] = val;
+  self->mem[pos] = val;
 }
 
 // imprime o conteúdo da memória
-void mem_imprime(void)
+void mem_imprime(montador_t *self)
 {
-  printf("MAQ %d %d\n", mem_max - mem_min + 1, mem_min);
-  for (int i = mem_min; i <= mem_max; i+=10) {
+  printf("MAQ %d %d\n", self->mem_max - self->mem_min + 1, self->mem_min);
+  for (int i = self->mem_min; i <= self->mem_max; i+=10) {
     printf("[%4d] =", i);
-    for (int j = i; j < i+10 && j <= mem_max; j++) {
-      printf(" %d,", mem[j]);
+    for (int j = i; j < i+10 && j <= self->mem_max; j++) {
+      printf(" %d,", self->mem[j]);
     }
     printf("\n");
   }
 }
 
-// SÍMBOLOS {{{1
-
-// tabela com os símbolos (labels) já definidos pelo programa, e o valor (endereço) deles
+// grava o mapa de símbolos, para o perfil de execução do simulador poder
+//   associar os endereços aos labels e linhas do fonte (ver perfil.c)
+void mapa_grava(montador_t *self)
+{
+  FILE *arq = fopen(self->nome_mapa, "w");
+  if (arq == NULL) {
+    fprintf(stderr, "Não foi possível criar o arquivo '%s'\n", self->nome_mapa);
+    return;
+  }
+  fprintf(arq, "FONTE %s\n", self->nome_fonte);
+  for (int i = 0; i < self->simb_num; i++) {
+    if (self->simbolo[i].rotulo) {
+      fprintf(arq, "ROTULO %s %d\n", self->simbolo[i].nome,
+              self->simbolo[i].valor);
+    }
+  }
+  for (int i = self->mem_min; i <= self->mem_max; i++) {
+    if (i >= 0) fprintf(arq, "LINHA %d %d\n", i, self->linha[i]);
+  }
+  fclose(arq);
+}
 
-#define SIMB_TAM 1000
-struct {
-  char *nome;
-  int valor;
-} simbolo[SIMB_TAM];
-int simb_num;             // número d símbolos na tabela
+// SÍMBOLOS {{{1
 
 // retorna o valor de um símbolo, ou -1 se não existir na tabela
-int simb_valor(char *nome)
+int simb_valor(montador_t *self, char *nome)
 {
-  for (int i=0; i<simb_num; i++) {
-    if (strcmp(nome, simbolo[i].nome) == 0) {
-      return simbolo[i].valor;
+  for (int i=0; i<self->simb_num; i++) {
+    if (strcmp(nome, self->simbolo[i].nome) == 0) {
+      return self->simbolo[i].valor;
     }
   }
   return -1;
 }
 
 // insere um novo símbolo na tabela
-void simb_novo(char *nome, int valor)
+// 'rotulo' diz se o símbolo é um label (o valor é um endereço)
+void simb_novo(montador_t *self, char *nome, int valor, bool rotulo)
 {
   if (nome == NULL) return;
-  if (simb_valor(nome) != -1) {
+  if (simb_valor(self, nome) != -1) {
     fprintf(stderr, "ERRO: redefinicao do simbolo '%s'\n", nome);
     return;
   }
-  if (simb_num >= SIMB_TAM) {
+  if (self->simb_num >= SIMB_TAM) {
     erro_brabo("Excesso de símbolos. Aumente SIMB_TAM no montador.");
   }
-  simbolo[simb_num].nome = strdup(nome);
-  simbolo[simb_num].valor = valor;
-  simb_num++;
+  self->simbolo[self->simb_num].nome = strdup(nome);
+  self->simbolo[self->simb_num].valor = valor;
+  self->simbolo[self->simb_num].rotulo = rotulo;
+  self->simb_num++;
 }
 
 
 // REFERÊNCIAS {{{1
 
-// tabela com referências a símbolos
-//   contém a linha e o endereço correspondente onde o símbolo foi referenciado
-
-#define REF_TAM 1000
-struct {
-  char *nome;
-  int linha;
-  int endereco;
-} ref[REF_TAM];
-int ref_num;      // numero de referências criadas
-
 // insere uma nova referência na tabela
-void ref_nova(char *nome, int linha, int endereco)
+void ref_nova(montador_t *self, char *nome, int linha, int endereco)
 {
   if (nome == NULL) return;
-  if (ref_num >= REF_TAM) {
+  if (self->ref_num >= REF_TAM) {
     erro_brabo("excesso de referências. Aumente REF_TAM no montador.");
   }
-  ref[ref_num].nome = strdup(nome);
-  ref[ref_num].linha = linha;
-  ref[ref_num].endereco = endereco;
-  ref_num++;
+  self->ref[self->ref_num].nome = strdup(nome);
+  self->ref[self->ref_num].linha = linha;
+  self->ref[self->ref_num].endereco = endereco;
+  self->ref_num++;
 }
 
 // resolve as referências -- para cada referência, coloca o valor do símbolo
 //   no endereço onde ele é referenciado
-void ref_resolve(void)
+void ref_resolve(montador_t *self)
 {
-  for (int i=0; i<ref_num; i++) {
-    int valor = simb_valor(ref[i].nome);
+  for (int i=0; i<self->ref_num; i++) {
+    int valor = simb_valor(self, self->ref[i].nome);
     if (valor == -1) {
       fprintf(stderr, 
               "ERRO: simbolo '%s' referenciado na linha %d não foi definido\n",
-              ref[i].nome, ref[i].linha);
+              self->ref[i].nome, self->ref[i].linha);
     }
-    mem_altera(ref[i].endereco, valor);
+    mem_altera(self, self->ref[i].endereco, valor);
   }
 }
 
@@ -165,7 +221,7 @@ void ref_resolve(void)
 
 // realiza a montagem de uma instrução (gera o código para ela na memória),
 //   tendo opcode da instrução e o argumento
-void monta_instrucao(int linha, int opcode, char *arg)
+void monta_instrucao(montador_t *self, int linha, int opcode, char *arg)
 {
   int argn;  // para conter o valor numérico do argumento
   int num_args = instrucao_num_args(opcode);
@@ -173,7 +229,7 @@ void monta_instrucao(int linha, int opcode, char *arg)
   // trata pseudo-opcodes antes
   if (opcode == ESPACO) {
     if (!tem_numero(arg, &argn)) {
-      argn = simb_valor(arg);
+      argn = simb_valor(self, arg);
     }
     if (argn < 1) {
       fprintf(stderr, "ERRO: linha %d 'ESPACO' deve ter valor positivo\n",
@@ -181,7 +237,7 @@ void monta_instrucao(int linha, int opcode, char *arg)
       return;
     }
     for (int i = 0; i < argn; i++) {
-      mem_insere(0);
+      mem_insere(self, 0);
     }
     return;
   } else if (opcode == VALOR) {
@@ -190,27 +246,27 @@ void monta_instrucao(int linha, int opcode, char *arg)
     char c;
     do {
       c = *++arg;
-      mem_insere(c);
+      mem_insere(self, c);
     } while(c != '\0');
     return;
   } else {
     // instrução real, coloca o opcode da instrução na memória
-    mem_insere(opcode);
+    mem_insere(self, opcode);
   }
   if (num_args == 0) {
     return;
   }
   if (tem_numero(arg, &argn)) {
-    mem_insere(argn);
+    mem_insere(self, argn);
   } else {
     // não é número, põe um 0 e insere uma referência para alterar depois
-    ref_nova(arg, linha, mem_pos);
-    mem_insere(0);
+    ref_nova(self, arg, linha, self->mem_pos);
+    mem_insere(self, 0);
   }
 }
 
 // monta uma linha "label DEFINE arg", define o símbolo 'label' com valor 'arg'
-void monta_define(int linha, char *label, char *arg)
+void monta_define(montador_t *self, int linha, char *label, char *arg)
 {
   int argn;  // para conter o valor numérico do argumento
   if (label == NULL) {
@@ -219,24 +275,24 @@ void monta_define(int linha, char *label, char *arg)
     fprintf(stderr, "ERRO: linha %d 'DEFINE' exige valor numérico\n", linha);
   } else {
     // tudo OK, define o símbolo
-    simb_novo(label, argn);
+    simb_novo(self, label, argn, false);
   }
 }
 
 // monta uma linha "label instrucao arg"
-void monta_linha(int linha, char *label, char *instrucao, char *arg)
+void monta_linha(montador_t *self, int linha, char *label, char *instrucao, char *arg)
 {
   int opcode = instrucao_opcode(instrucao);
   // pseudo-instrução DEFINE tem que ser tratada antes, porque não pode
   //   definir o label de forma normal
   if (opcode == DEFINE) {
-    monta_define(linha, label, arg);
+    monta_define(self, linha, label, arg);
     return;
   }
   
   // cria símbolo correspondente ao label, se for o caso
   if (label != NULL) {
-    simb_novo(label, mem_pos);
+    simb_novo(self, label, self->mem_pos, true);
   }
   
   // verifica a existência de instrução e número correto de argumentos
@@ -258,7 +314,7 @@ void monta_linha(int linha, char *label, char *instrucao, char *arg)
     return;
   }
   // tudo OK, monta a instrução
-  monta_instrucao(linha, opcode, arg);
+  monta_instrucao(self, linha, opcode, arg);
 }
 
 // retorna true se o caractere for um espaço (ou tab)
@@ -317,11 +373,12 @@ void tira_comentario(char *s)
 // de ';' em diante, ignora-se (comentário)
 // a string é alterada, colocando-se NULs no lugar dos espaços, para separá-la em substrings
 // quem precisar guardar essas substrings, deve copiá-las.
-void monta_string(int linha, char *str)
+void monta_string(montador_t *self, int linha, char *str)
 {
   char *label = NULL;
   char *instrucao = NULL;
   char *arg = NULL;
+  self->linha_atual = linha;
   tira_comentario(str);
   if (*str == '\0') return;
   if (!espaco(*str)) {
@@ -347,11 +404,11 @@ void monta_string(int linha, char *str)
     fprintf(stderr, "linha %d: ignorando '%s'\n", linha, str);
   }
   if (label != NULL || instrucao != NULL) {
-    monta_linha(linha, label, instrucao, arg);
+    monta_linha(self, linha, label, instrucao, arg);
   }
 }
 
-void monta_arquivo(char *nome)
+void monta_arquivo(montador_t *self, char *nome)
 {
   FILE *arq;
   arq = fopen(nome, "r");
@@ -363,17 +420,17 @@ void monta_arquivo(char *nome)
   char *linha = NULL;
   size_t nbytes;
   while (getline(&linha, &nbytes, arq) != -1) {
-    monta_string(nlinha, linha);
+    monta_string(self, nlinha, linha);
     nlinha++;
   }
   free(linha);
   fclose(arq);
-  ref_resolve();
+  ref_resolve(self);
 }
 
 // MAIN {{{1
 
-void verifica_args(int argc, char *argv[argc])
+void verifica_args(montador_t *self, int argc, char *argv[argc])
 {
   for (int argi = 1; argi < argc; argi++) {
     if (strcmp(argv[argi], "-e") == 0) {
@@ -383,27 +440,37 @@ void verifica_args(int argc, char *argv[argc])
         exit(1);
       }
       char *fim = argv[argi];
-      mem_pos = strtol(fim, &fim, 0);
+      self->mem_pos = strtol(fim, &fim, 0);
       if (*fim != '\0') {
         fprintf(stderr, "ERRO: endereço inválido: '%s'\n", argv[argi]);
         exit(1);
       }
+    } else if (strcmp(argv[argi], "-s") == 0) {
+      argi++;
+      if (argi >= argc) {
+        fprintf(stderr, "ERRO: falta o nome do mapa de símbolos após '-s'\n");
+        exit(1);
+      }
+      self->nome_mapa = argv[argi];
     } else {
-      nome_fonte = argv[argi];
+      self->nome_fonte = argv[argi];
     }
   }
-  if (nome_fonte == NULL) {
-    fprintf(stderr, "ERRO: chame como '%s [-e end.inicial] nome_do_arquivo'\n",
-            argv[0]);
+  if (self->nome_fonte == NULL) {
+    fprintf(stderr, "ERRO: chame como '%s [-e end.inicial] [-s mapa.sim]"
+                    " nome_do_arquivo'\n", argv[0]);
     exit(1);
   }
 }
 
 int main(int argc, char *argv[argc])
 {
-  verifica_args(argc, argv);
-  monta_arquivo(nome_fonte);
-  mem_imprime();
+  montador_t *montador = montador_cria();
+  verifica_args(montador, argc, argv);
+  monta_arquivo(montador, montador->nome_fonte);
+  mem_imprime(montador);
+  if (montador->nome_mapa != NULL) mapa_grava(montador);
+  montador_destroi(montador);
   return 0;
 }
 
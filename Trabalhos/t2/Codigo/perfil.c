@@ -0,0 +1,436 @@
+// perfil.c
+// perfil de execução: contagem de instruções por PC e por opcode
+// simulador de computador
+// so24b
+
+#include "perfil.h"
+#include "instrucao.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// número de endereços listados nas seções de mais executados do relatório
+#define N_MAIS_EXECUTADOS 20
+
+// índices extras nas contagens por opcode
+#define OP_INVALIDO N_OPCODE        // opcode que não é de instrução
+#define OP_FORA     (N_OPCODE + 1)  // acessos fora de instruções
+#define N_OP        (N_OPCODE + 2)
+
+// mapa de símbolos de um programa, lido do arquivo gerado pelo montador
+typedef struct {
+  char *nome;         // nome do programa (.maq)
+  char *fonte;        // nome do arquivo fonte, NULL se não tem o mapa
+  int n_rotulos;
+  struct {
+    char *nome;
+    int endereco;
+  } *rotulo;          // em ordem de endereço
+  int n_linhas;
+  int *linha;         // linha do fonte de cada endereço (0 se não tem)
+} simbolos_t;
+
+// uma carga de programa na memória
+typedef struct {
+  int processo;       // -1 se não é de processo
+  simbolos_t *simbolos;
+  int end_virt;
+  int end_fis;
+  int tam;
+  // instruções executadas em modo usuário, por endereço virtual a partir de
+  //   end_virt, e fora da região do programa
+  long *instrucoes;
+  long fora;
+} carga_t;
+
+struct perfil_t {
+  int tam_mem;
+  long total;
+  long *por_end_fis;
+  long por_opcode[N_OP];
+  long leituras[N_OP];
+  long escritas[N_OP];
+  // índice do opcode da instrução em execução (ou OP_FORA)
+  int op_corrente;
+  // programas cujos símbolos já foram lidos
+  int n_simbolos;
+  simbolos_t **simbolos;
+  // cargas, na ordem em que foram feitas
+  int n_cargas;
+  carga_t *cargas;
+  // carga executada pelo processo corrente (-1 se não tem)
+  int carga_corrente;
+};
+
+static void simbolos_destroi(simbolos_t *simb);
+
+perfil_t *perfil_cria(int tam_mem)
+{
+  perfil_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->tam_mem = tam_mem;
+  self->total = 0;
+  self->por_end_fis = calloc(tam_mem, sizeof(long));
+  assert(self->por_end_fis != NULL);
+  memset(self->por_opcode, 0, sizeof(self->por_opcode));
+  memset(self->leituras, 0, sizeof(self->leituras));
+  memset(self->escritas, 0, sizeof(self->escritas));
+  self->op_corrente = OP_FORA;
+  self->n_simbolos = 0;
+  self->simbolos = NULL;
+  self->n_cargas = 0;
+  self->cargas = NULL;
+  self->carga_corrente = -1;
+  return self;
+}
+
+void perfil_destroi(perfil_t *self)
+{
+  for (int i = 0; i < self->n_simbolos; i++) {
+    simbolos_destroi(self->simbolos[i]);
+  }
+  for (int i = 0; i < self->n_cargas; i++) {
+    free(self->cargas[i].instrucoes);
+  }
+  free(self->simbolos);
+  free(self->cargas);
+  free(self->por_end_fis);
+  free(self);
+}
+
+// MAPA DE SÍMBOLOS {{{1
+
+// o nome do mapa de símbolos do programa: troca ".maq" por ".sim"
+static char *nome_do_mapa(char *nome)
+{
+  int n = strlen(nome);
+  if (n > 4 && strcmp(nome + n - 4, ".maq") == 0) n -= 4;
+  char *nome_mapa = malloc(n + 5);
+  assert(nome_mapa != NULL);
+  memcpy(nome_mapa, nome, n);
+  strcpy(nome_mapa + n, ".sim");
+  return nome_mapa;
+}
+
+// lê o mapa gerado pelo montador, que tem uma linha por informação:
+//   FONTE nome      -- nome do arquivo fonte
+//   ROTULO nome end -- o rótulo 'nome' foi definido no endereço 'end'
+//   LINHA end linha -- o endereço 'end' foi gerado pela linha 'linha'
+// os rótulos estão em ordem crescente de endereço
+static void simbolos_le_mapa(simbolos_t *simb, FILE *arq)
+{
+  char *linha = NULL;
+  size_t tam_linha;
+  while (getline(&linha, &tam_linha, arq) != -1) {
+    char nome[100];
+    int a, b;
+    if (sscanf(linha, "FONTE %99s", nome) == 1) {
+      free(simb->fonte);
+      simb->fonte = strdup(nome);
+      assert(simb->fonte != NULL);
+    } else if (sscanf(linha, "ROTULO %99s %d", nome, &a) == 2) {
+      simb->rotulo = realloc(simb->rotulo,
+                             (simb->n_rotulos + 1) * sizeof(*simb->rotulo));
+      assert(simb->rotulo != NULL);
+      simb->rotulo[simb->n_rotulos].nome = strdup(nome);
+      assert(simb->rotulo[simb->n_rotulos].nome != NULL);
+      simb->rotulo[simb->n_rotulos].endereco = a;
+      simb->n_rotulos++;
+    } else if (sscanf(linha, "LINHA %d %d", &a, &b) == 2 && a >= 0) {
+      if (a >= simb->n_linhas) {
+        simb->linha = realloc(simb->linha, (a + 1) * sizeof(int));
+        assert(simb->linha != NULL);
+        memset(simb->linha + simb->n_linhas, 0,
+               (a + 1 - simb->n_linhas) * sizeof(int));
+        simb->n_linhas = a + 1;
+      }
+      simb->linha[a] = b;
+    }
+  }
+  free(linha);
+}
+
+static simbolos_t *simbolos_cria(char *nome)
+{
+  simbolos_t *simb = malloc(sizeof(*simb));
+  assert(simb != NULL);
+  simb->nome = strdup(nome);
+  assert(simb->nome != NULL);
+  simb->fonte = NULL;
+  simb->n_rotulos = 0;
+  simb->rotulo = NULL;
+  simb->n_linhas = 0;
+  simb->linha = NULL;
+
+  char *nome_mapa = nome_do_mapa(nome);
+  FILE *arq = fopen(nome_mapa, "r");
+  if (arq != NULL) {
+    simbolos_le_mapa(simb, arq);
+    fclose(arq);
+  }
+  free(nome_mapa);
+  return simb;
+}
+
+static void simbolos_destroi(simbolos_t *simb)
+{
+  for (int i = 0; i < simb->n_rotulos; i++) free(simb->rotulo[i].nome);
+  free(simb->rotulo);
+  free(simb->linha);
+  free(simb->fonte);
+  free(simb->nome);
+  free(simb);
+}
+
+// os símbolos do programa 'nome', lidos só na primeira vez
+static simbolos_t *perfil_simbolos(perfil_t *self, char *nome)
+{
+  for (int i = 0; i < self->n_simbolos; i++) {
+    if (strcmp(self->simbolos[i]->nome, nome) == 0) return self->simbolos[i];
+  }
+  self->simbolos = realloc(self->simbolos,
+                           (self->n_simbolos + 1) * sizeof(simbolos_t *));
+  assert(self->simbolos != NULL);
+  self->simbolos[self->n_simbolos] = simbolos_cria(nome);
+  return self->simbolos[self->n_simbolos++];
+}
+
+// escreve em 'str' a localização do endereço 'end' no programa:
+//   rótulo+deslocamento (fonte:linha)
+static void simbolos_descreve(simbolos_t *simb, int end, char *str, int tam)
+{
+  int r = -1;
+  for (int i = 0; i < simb->n_rotulos && simb->rotulo[i].endereco <= end; i++) {
+    r = i;
+  }
+  int n = snprintf(str, tam, "%s:", simb->nome);
+  if (r == -1) {
+    n += snprintf(str + n, tam - n, " %d", end);
+  } else if (simb->rotulo[r].endereco == end) {
+    n += snprintf(str + n, tam - n, " %s", simb->rotulo[r].nome);
+  } else {
+    n += snprintf(str + n, tam - n, " %s+%d", simb->rotulo[r].nome,
+                  end - simb->rotulo[r].endereco);
+  }
+  if (simb->fonte != NULL && end >= 0 && end < simb->n_linhas
+      && simb->linha[end] != 0) {
+    snprintf(str + n, tam - n, " (%s:%d)", simb->fonte, simb->linha[end]);
+  }
+}
+
+// COLETA {{{1
+
+void perfil_carga(perfil_t *self, int processo, char *nome,
+                  int end_virt, int end_fis, int tam)
+{
+  self->cargas = realloc(self->cargas, (self->n_cargas + 1) * sizeof(carga_t));
+  assert(self->cargas != NULL);
+  carga_t *carga = &self->cargas[self->n_cargas++];
+  carga->processo = processo;
+  carga->simbolos = perfil_simbolos(self, nome);
+  carga->end_virt = end_virt;
+  carga->end_fis = end_fis;
+  carga->tam = tam;
+  carga->instrucoes = calloc(tam > 0 ? tam : 1, sizeof(long));
+  assert(carga->instrucoes != NULL);
+  carga->fora = 0;
+}
+
+void perfil_define_processo(perfil_t *self, int processo)
+{
+  // o processo executa o último programa carregado para ele
+  self->carga_corrente = -1;
+  for (int i = self->n_cargas - 1; i >= 0; i--) {
+    if (self->cargas[i].processo == processo) {
+      self->carga_corrente = i;
+      break;
+    }
+  }
+}
+
+void perfil_inicia_instrucao(perfil_t *self, int opcode, int pc_fis,
+                             int pc_virt, bool usuario)
+{
+  if (opcode < 0 || opcode >= N_OPCODE) opcode = OP_INVALIDO;
+  self->op_corrente = opcode;
+  self->por_opcode[opcode]++;
+  self->total++;
+  if (pc_fis >= 0 && pc_fis < self->tam_mem) self->por_end_fis[pc_fis]++;
+  if (usuario && self->carga_corrente != -1) {
+    carga_t *carga = &self->cargas[self->carga_corrente];
+    int desl = pc_virt - carga->end_virt;
+    if (desl >= 0 && desl < carga->tam) {
+      carga->instrucoes[desl]++;
+    } else {
+      carga->fora++;
+    }
+  }
+}
+
+void perfil_termina_instrucao(perfil_t *self)
+{
+  self->op_corrente = OP_FORA;
+}
+
+void perfil_conta_leitura(perfil_t *self)
+{
+  self->leituras[self->op_corrente]++;
+}
+
+void perfil_conta_escrita(perfil_t *self)
+{
+  self->escritas[self->op_corrente]++;
+}
+
+// RELATÓRIO {{{1
+
+// contagem de um endereço, para ordenar
+typedef struct {
+  int endereco;
+  long n;
+} contagem_t;
+
+static int compara_contagens(const void *a, const void *b)
+{
+  const contagem_t *ca = a, *cb = b;
+  if (ca->n != cb->n) return ca->n < cb->n ? 1 : -1;
+  return ca->endereco - cb->endereco;
+}
+
+// ordena as 'n' contagens em 'v', das maiores para as menores, e retorna
+//   quantas não são 0
+static int ordena_contagens(int n, contagem_t v[n])
+{
+  qsort(v, n, sizeof(contagem_t), compara_contagens);
+  int nao_zero = 0;
+  while (nao_zero < n && v[nao_zero].n != 0) nao_zero++;
+  return nao_zero;
+}
+
+static double porcento(long n, long total)
+{
+  return total == 0 ? 0 : 100.0 * n / total;
+}
+
+static char *nome_op(int op)
+{
+  if (op == OP_INVALIDO) return "(inválida)";
+  if (op == OP_FORA) return "(fora de instrução)";
+  return instrucao_nome(op);
+}
+
+static void relatorio_opcodes(perfil_t *self, FILE *arq)
+{
+  fprintf(arq, "\n== instruções e acessos à memória por opcode\n");
+  fprintf(arq, "%-20s %12s %7s %12s %12s\n",
+          "opcode", "instruções", "%", "leituras", "escritas");
+  for (int op = 0; op < N_OP; op++) {
+    if (self->por_opcode[op] == 0 && self->leituras[op] == 0
+        && self->escritas[op] == 0) continue;
+    fprintf(arq, "%-20s %12ld %6.2f%% %12ld %12ld\n", nome_op(op),
+            self->por_opcode[op], porcento(self->por_opcode[op], self->total),
+            self->leituras[op], self->escritas[op]);
+  }
+}
+
+// descreve o endereço físico 'end': a última carga que o contém
+static void descreve_end_fis(perfil_t *self, int end, char *str, int tam)
+{
+  for (int i = self->n_cargas - 1; i >= 0; i--) {
+    carga_t *carga = &self->cargas[i];
+    if (end >= carga->end_fis && end < carga->end_fis + carga->tam) {
+      simbolos_descreve(carga->simbolos, end - carga->end_fis + carga->end_virt,
+                        str, tam);
+      return;
+    }
+  }
+  snprintf(str, tam, "?");
+}
+
+static void relatorio_end_fis(perfil_t *self, FILE *arq)
+{
+  contagem_t *v = malloc(self->tam_mem * sizeof(contagem_t));
+  assert(v != NULL);
+  for (int end = 0; end < self->tam_mem; end++) {
+    v[end].endereco = end;
+    v[end].n = self->por_end_fis[end];
+  }
+  int n = ordena_contagens(self->tam_mem, v);
+  if (n > N_MAIS_EXECUTADOS) n = N_MAIS_EXECUTADOS;
+  fprintf(arq, "\n== endereços físicos mais executados\n");
+  fprintf(arq, "%8s %12s %7s  %s\n", "endereço", "instruções", "%", "local");
+  for (int i = 0; i < n; i++) {
+    char local[200];
+    descreve_end_fis(self, v[i].endereco, local, sizeof(local));
+    fprintf(arq, "%8d %12ld %6.2f%%  %s\n", v[i].endereco, v[i].n,
+            porcento(v[i].n, self->total), local);
+  }
+  free(v);
+}
+
+static void relatorio_carga(perfil_t *self, carga_t *carga, FILE *arq)
+{
+  simbolos_t *simb = carga->simbolos;
+  long total = carga->fora;
+  for (int d = 0; d < carga->tam; d++) total += carga->instrucoes[d];
+  if (total == 0) return;
+  fprintf(arq, "\nprocesso %d, programa %s: %ld instruções (%.2f%%)",
+          carga->processo, simb->nome, total, porcento(total, self->total));
+  if (carga->fora != 0) {
+    fprintf(arq, ", %ld fora do programa", carga->fora);
+  }
+  fprintf(arq, "\n");
+
+  // instruções por rótulo: cada endereço conta para o último rótulo antes dele
+  if (simb->n_rotulos > 0) {
+    contagem_t v[simb->n_rotulos];
+    for (int r = 0; r < simb->n_rotulos; r++) {
+      v[r].endereco = r;
+      v[r].n = 0;
+    }
+    int r = -1;
+    for (int d = 0; d < carga->tam; d++) {
+      int end = carga->end_virt + d;
+      while (r + 1 < simb->n_rotulos && simb->rotulo[r + 1].endereco <= end) r++;
+      if (r >= 0) v[r].n += carga->instrucoes[d];
+    }
+    int n = ordena_contagens(simb->n_rotulos, v);
+    fprintf(arq, "  %-20s %12s %7s\n", "rótulo", "instruções", "%");
+    for (int i = 0; i < n; i++) {
+      fprintf(arq, "  %-20s %12ld %6.2f%%\n", simb->rotulo[v[i].endereco].nome,
+              v[i].n, porcento(v[i].n, total));
+    }
+  }
+
+  contagem_t v[carga->tam];
+  for (int d = 0; d < carga->tam; d++) {
+    v[d].endereco = carga->end_virt + d;
+    v[d].n = carga->instrucoes[d];
+  }
+  int n = ordena_contagens(carga->tam, v);
+  if (n > N_MAIS_EXECUTADOS) n = N_MAIS_EXECUTADOS;
+  fprintf(arq, "  %8s %12s %7s  %s\n", "endereço", "instruções", "%", "local");
+  for (int i = 0; i < n; i++) {
+    char local[200];
+    simbolos_descreve(simb, v[i].endereco, local, sizeof(local));
+    fprintf(arq, "  %8d %12ld %6.2f%%  %s\n", v[i].endereco, v[i].n,
+            porcento(v[i].n, total), local);
+  }
+}
+
+void perfil_relatorio(perfil_t *self, FILE *arq)
+{
+  fprintf(arq, "PERFIL DE EXECUÇÃO\n");
+  fprintf(arq, "instruções executadas: %ld\n", self->total);
+  relatorio_opcodes(self, arq);
+  relatorio_end_fis(self, arq);
+  fprintf(arq, "\n== instruções por processo e endereço virtual\n");
+  for (int i = 0; i < self->n_cargas; i++) {
+    if (self->cargas[i].processo != -1) {
+      relatorio_carga(self, &self->cargas[i], arq);
+    }
+  }
+}
+
+// vim: foldmethod=marker
@@ -0,0 +1,54 @@
+// perfil.h
+// perfil de execução: contagem de instruções por PC e por opcode
+// simulador de computador
+// so24b
+
+#ifndef PERFIL_H
+#define PERFIL_H
+
+// O perfil conta as instruções executadas por endereço físico, por endereço
+//   virtual de cada processo e por opcode, e os acessos de dados à memória
+//   (leituras e escritas, fora a busca da instrução) feitos por cada opcode.
+// A CPU só conta no perfil se tiver um (ver cpu_define_perfil); sem perfil, o
+//   custo é um teste por acesso à memória.
+// O SO informa o perfil da carga dos programas e de qual processo está em
+//   execução. No relatório, os endereços são associados aos rótulos e linhas
+//   do fonte do programa, se existir o mapa de símbolos gerado pelo montador
+//   (o arquivo com o nome do programa terminado em ".sim" em vez de ".maq").
+
+#include <stdio.h>
+#include <stdbool.h>
+
+typedef struct perfil_t perfil_t;
+
+// cria um perfil para uma memória física de 'tam_mem' palavras
+perfil_t *perfil_cria(int tam_mem);
+void perfil_destroi(perfil_t *self);
+
+// informa que o programa 'nome' foi carregado na memória, com 'tam' palavras
+//   a partir do endereço físico 'end_fis' (e virtual 'end_virt')
+// 'processo' é o processo que vai executar o programa, ou -1 se a carga não
+//   é para um processo (o programa executa em modo supervisor)
+void perfil_carga(perfil_t *self, int processo, char *nome,
+                  int end_virt, int end_fis, int tam);
+
+// informa qual processo executa as próximas instruções em modo usuário
+void perfil_define_processo(perfil_t *self, int processo);
+
+// conta a execução de uma instrução, que está no endereço físico 'pc_fis' e
+//   no endereço virtual 'pc_virt' (que só é usado em modo usuário)
+// os acessos à memória até perfil_termina_instrucao são contados para essa
+//   instrução; os acessos fora de instruções (interrupções causadas por
+//   erro ou por dispositivos) são contados à parte
+void perfil_inicia_instrucao(perfil_t *self, int opcode, int pc_fis,
+                             int pc_virt, bool usuario);
+void perfil_termina_instrucao(perfil_t *self);
+
+// contam um acesso de dados à memória
+void perfil_conta_leitura(perfil_t *self);
+void perfil_conta_escrita(perfil_t *self);
+
+// escreve o relatório do perfil no arquivo
+void perfil_relatorio(perfil_t *self, FILE *arq);
+
+#endif // PERFIL_H
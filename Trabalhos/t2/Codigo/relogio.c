@@ -6,16 +6,23 @@
 #include "relogio.h"
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <time.h>
 #include <assert.h>
 
 struct relogio_t {
   // que horas são (em tics)
   int agora;
-  // quanto tempo até gerar uma interrupção
-  int t_ate_interrupcao;
+  // eventos futuros dos dispositivos
+  agenda_t *agenda;
+  // se o timer está programado, e o instante em que ele vai gerar uma
+  //   interrupção (o evento fica na agenda)
+  bool timer_programado;
+  int instante_interrupcao;
   // 1 se está gerando interrupção, 0 se não
   int interrupcao;
+  // gravação ou reprodução das leituras do relógio real (ou NULL)
+  gravacao_t *gravacao;
 };
 
 relogio_t *relogio_cria(void)
@@ -25,25 +32,29 @@ relogio_t *relogio_cria(void)
   assert(self != NULL);
 
   self->agora = 0;
+  self->agenda = agenda_cria();
+  self->timer_programado = false;
+  self->interrupcao = 0;
+  self->gravacao = NULL;
 
   return self;
 }
 
 void relogio_destroi(relogio_t *self)
 {
+  agenda_destroi(self->agenda);
   free(self);
 }
 
 void relogio_tictac(relogio_t *self)
 {
-  self->agora++;
-  // vê se tem que gerar interrupção
-  if (self->t_ate_interrupcao != 0) {
-    self->t_ate_interrupcao--;
-    if (self->t_ate_interrupcao == 0) {
-      self->interrupcao = 1;
-    }
-  }
+  relogio_avanca(self, 1);
+}
+
+void relogio_avanca(relogio_t *self, int n)
+{
+  self->agora += n;
+  agenda_dispara(self->agenda, self->agora);
 }
 
 int relogio_agora(relogio_t *self)
@@ -51,6 +62,54 @@ int relogio_agora(relogio_t *self)
   return self->agora;
 }
 
+agenda_t *relogio_agenda(relogio_t *self)
+{
+  return self->agenda;
+}
+
+int relogio_ate_proximo_evento(relogio_t *self)
+{
+  int instante;
+  if (!agenda_proximo(self->agenda, &instante)) return 0;
+  if (instante <= self->agora) return 1;
+  return instante - self->agora;
+}
+
+// TIMER
+
+// evento da agenda, quando o timer expira
+static void relogio_expira_timer(void *arg)
+{
+  relogio_t *self = arg;
+  self->timer_programado = false;
+  self->interrupcao = 1;
+}
+
+// programa o timer para gerar interrupção daqui a 't' tics (0 desliga)
+static void relogio_programa_timer(relogio_t *self, int t)
+{
+  agenda_remove(self->agenda, relogio_expira_timer, self);
+  self->timer_programado = (t != 0);
+  if (!self->timer_programado) return;
+  // um tempo negativo expira no próximo avanço
+  if (t < 0) t = 0;
+  self->instante_interrupcao = self->agora + t;
+  agenda_insere(self->agenda, self->instante_interrupcao,
+                relogio_expira_timer, self);
+}
+
+// quanto tempo falta para o timer gerar interrupção (0 se não programado)
+static int relogio_t_ate_interrupcao(relogio_t *self)
+{
+  if (!self->timer_programado) return 0;
+  return self->instante_interrupcao - self->agora;
+}
+
+void relogio_define_gravacao(relogio_t *self, gravacao_t *gravacao)
+{
+  self->gravacao = gravacao;
+}
+
 err_t relogio_leitura(void *disp, int id, int *pvalor)
 {
   relogio_t *self = disp;
@@ -60,10 +119,17 @@ err_t relogio_leitura(void *disp, int id, int *pvalor)
       *pvalor = self->agora;
       break;
     case 1:
+      if (self->gravacao != NULL && gravacao_reproduzindo(self->gravacao)
+          && gravacao_tempo_real(self->gravacao, pvalor)) {
+        break;
+      }
       *pvalor = clock()/(CLOCKS_PER_SEC/1000);
+      if (self->gravacao != NULL && !gravacao_reproduzindo(self->gravacao)) {
+        gravacao_registra_tempo_real(self->gravacao, *pvalor);
+      }
       break;
     case 2:
-      *pvalor = self->t_ate_interrupcao;
+      *pvalor = relogio_t_ate_interrupcao(self);
       break;
     case 3:
       *pvalor = self->interrupcao;
@@ -80,7 +146,7 @@ err_t relogio_escrita(void *disp, int id, int pvalor)
   err_t err = ERR_OK;
   switch (id) {
     case 2:
-      self->t_ate_interrupcao = pvalor;
+      relogio_programa_timer(self, pvalor);
       break;
     case 3:
       self->interrupcao = (pvalor == 0) ? 0 : 1;
@@ -90,3 +156,26 @@ err_t relogio_escrita(void *disp, int id, int pvalor)
   }
   return err;
 }
+
+// salvamento e restauração em checkpoint
+// do timer, é salvo o tempo que falta; na restauração ele é reprogramado
+
+void relogio_salva(relogio_t *self, ckpt_t *ckpt)
+{
+  int t_ate_interrupcao = relogio_t_ate_interrupcao(self);
+  ckpt_escreve(ckpt, &self->agora, sizeof(self->agora));
+  ckpt_escreve(ckpt, &t_ate_interrupcao, sizeof(t_ate_interrupcao));
+  ckpt_escreve(ckpt, &self->interrupcao, sizeof(self->interrupcao));
+}
+
+bool relogio_restaura(relogio_t *self, ckpt_t *ckpt)
+{
+  int t_ate_interrupcao;
+  ckpt_le(ckpt, &self->agora, sizeof(self->agora));
+  ckpt_le(ckpt, &t_ate_interrupcao, sizeof(t_ate_interrupcao));
+  if (!ckpt_le(ckpt, &self->interrupcao, sizeof(self->interrupcao))) {
+    return false;
+  }
+  relogio_programa_timer(self, t_ate_interrupcao);
+  return true;
+}
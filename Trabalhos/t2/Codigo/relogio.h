@@ -10,9 +10,13 @@
 // registra a passagem do tempo
 
 #include "err.h"
+#include "checkpoint.h"
+#include "agenda.h"
 
 typedef struct relogio_t relogio_t;
 
+#include "gravacao.h"
+
 // cria e inicializa um relógio
 relogio_t *relogio_cria(void);
 
@@ -24,9 +28,28 @@ void relogio_destroi(relogio_t *self);
 // esta função é chamada pelo controlador após a execução de cada instrução
 void relogio_tictac(relogio_t *self);
 
+// registra a passagem de 'n' unidades de tempo, como 'n' chamadas a
+//   relogio_tictac
+// é usada pelo controlador após a execução de uma sequência de instruções
+// dispara os eventos da agenda que venceram
+void relogio_avanca(relogio_t *self, int n);
+
 // retorna a hora atual do sistema, em unidades de tempo
 int relogio_agora(relogio_t *self);
 
+// retorna a agenda de eventos, onde os dispositivos colocam o que vai
+//   acontecer no futuro, em instantes deste relógio (ver agenda.h)
+// o timer do relógio é um desses eventos
+agenda_t *relogio_agenda(relogio_t *self);
+
+// retorna quanto tempo falta até o próximo evento da agenda (pelo menos 1),
+//   ou 0 se a agenda está vazia
+int relogio_ate_proximo_evento(relogio_t *self);
+
+// define a gravação onde as leituras do relógio real são registradas, ou de
+//   onde são reproduzidas (NULL para nenhuma)
+void relogio_define_gravacao(relogio_t *self, gravacao_t *gravacao);
+
 // Funções para acessar o relógio como dispositivo de E/S, com id:
 //   '0' para ler o relógio local (contador de instruções)
 //   '1' para ler o tempo de CPU consumido pelo simulador (em ms)
@@ -36,4 +59,9 @@ int relogio_agora(relogio_t *self);
 err_t relogio_leitura(void *disp, int id, int *pvalor);
 err_t relogio_escrita(void *disp, int id, int pvalor);
 
+// salva e restaura o estado do relógio em um checkpoint
+// relogio_restaura retorna false se não for possível
+void relogio_salva(relogio_t *self, ckpt_t *ckpt);
+bool relogio_restaura(relogio_t *self, ckpt_t *ckpt);
+
 #endif // RELOGIO_H
@@ -9,6 +9,8 @@
 #include "irq.h"
 #include "programa.h"
 #include "tabpag.h"
+#include "tabinv.h"
+#include "log.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -46,6 +48,8 @@ struct so_t {
   es_t *es;
   console_t *console;
   bool erro_interno;
+  // nome do arquivo com o programa inicial
+  char *programa_inicial;
   // t1: tabela de processos, processo corrente, pendências, etc
 
   // primeiro quadro da memória que está livre (quadros anteriores estão ocupados)
@@ -56,6 +60,11 @@ struct so_t {
   // t2: com processos, não tem esta tabela global, tem que ter uma para
   //     cada processo
   tabpag_t *tabpag_global;
+  // a tabela invertida, com uma entrada por quadro da memória, se a MMU usa
+  //   ela no lugar da tabela de páginas (NULL se não; ver
+  //   so_usa_tabela_invertida)
+  // t2: com processos, as páginas de cada um são identificadas pelo ASID
+  tabinv_t *tabinv;
 };
 
 
@@ -86,14 +95,18 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu,
   self->es = es;
   self->console = console;
   self->erro_interno = false;
+  self->programa_inicial = "init.maq";
 
   // quando a CPU executar uma instrução CHAMAC, deve chamar a função
   //   so_trata_interrupcao, com primeiro argumento um ptr para o SO
   cpu_define_chamaC(self->cpu, so_trata_interrupcao, self);
+  // a CPU salva seu estado no banco de registradores de sombra, e o SO acessa
+  //   esse estado com cpu_estado_salvo, sem passar pela memória
+  cpu_define_salvamento(self->cpu, CPU_SALVA_NO_BANCO);
 
   // coloca o tratador de interrupção na memória
   // quando a CPU aceita uma interrupção, passa para modo supervisor, 
-  //   salva seu estado à partir do endereço 0, e desvia para o endereço
+  //   salva seu estado (no banco de sombra), e desvia para o endereço
   //   IRQ_END_TRATADOR
   // colocamos no endereço IRQ_END_TRATADOR o programa de tratamento
   //   de interrupção (escrito em asm). esse programa deve conter a 
@@ -101,21 +114,23 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu,
   //   foi definido acima)
   int ender = so_carrega_programa(self, NENHUM_PROCESSO, "trata_int.maq");
   if (ender != IRQ_END_TRATADOR) {
-    console_printf("SO: problema na carga do programa de tratamento de interrupção");
+    log_erro(self->console, "SO: problema na carga do programa de tratamento de interrupção");
     self->erro_interno = true;
   }
 
   // programa o relógio para gerar uma interrupção após INTERVALO_INTERRUPCAO
   if (es_escreve(self->es, D_RELOGIO_TIMER, INTERVALO_INTERRUPCAO) != ERR_OK) {
-    console_printf("SO: problema na programação do timer");
+    log_erro(self->console, "SO: problema na programação do timer");
     self->erro_interno = true;
   }
 
   // inicializa a tabela de páginas global, e entrega ela para a MMU
   // t2: com processos, essa tabela não existiria, teria uma por processo, que
-  //     deve ser colocada na MMU quando o processo é despachado para execução
+  //     deve ser colocada na MMU quando o processo é despachado para execução,
+  //     com um ASID diferente para cada processo (o pid, por exemplo)
   self->tabpag_global = tabpag_cria();
-  mmu_define_tabpag(self->mmu, self->tabpag_global);
+  self->tabinv = NULL;
+  mmu_define_tabpag(self->mmu, self->tabpag_global, 0);
   // define o primeiro quadro livre de memória como o seguinte àquele que
   //   contém o endereço 99 (as 100 primeiras posições de memória (pelo menos)
   //   não vão ser usadas por programas de usuário)
@@ -127,9 +142,61 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu,
 void so_destroi(so_t *self)
 {
   cpu_define_chamaC(self->cpu, NULL, NULL);
+  mmu_define_tabpag(self->mmu, NULL, 0);
+  tabpag_destroi(self->tabpag_global);
+  if (self->tabinv != NULL) tabinv_destroi(self->tabinv);
   free(self);
 }
 
+void so_define_programa_inicial(so_t *self, char *nome)
+{
+  self->programa_inicial = nome;
+}
+
+void so_usa_tabela_invertida(so_t *self)
+{
+  if (self->tabinv != NULL) return;
+  self->tabinv = tabinv_cria(mem_tam(self->mem) / TAM_PAGINA);
+  mmu_define_tabinv(self->mmu, self->tabinv, 0);
+}
+
+bool so_terminou(so_t *self)
+{
+  // t1: com processos, termina quando não tiver mais nenhum processo
+  // sem processos, o SO deixa de executar programas quando tem um erro interno
+  //   (so_despacha faz a CPU parar)
+  return self->erro_interno;
+}
+
+
+// CHECKPOINT {{{1
+
+void so_salva(so_t *self, ckpt_t *ckpt)
+{
+  // t2: com processos, a tabela de processos (e a tabela de páginas de cada
+  //     um) também devem ser salvas
+  ckpt_escreve(ckpt, &self->erro_interno, sizeof(self->erro_interno));
+  ckpt_escreve(ckpt, &self->quadro_livre, sizeof(self->quadro_livre));
+  tabpag_salva(self->tabpag_global, ckpt);
+  bool tem_tabinv = self->tabinv != NULL;
+  ckpt_escreve(ckpt, &tem_tabinv, sizeof(tem_tabinv));
+  if (tem_tabinv) tabinv_salva(self->tabinv, ckpt);
+}
+
+bool so_restaura(so_t *self, ckpt_t *ckpt)
+{
+  ckpt_le(ckpt, &self->erro_interno, sizeof(self->erro_interno));
+  ckpt_le(ckpt, &self->quadro_livre, sizeof(self->quadro_livre));
+  if (!tabpag_restaura(self->tabpag_global, ckpt)) return false;
+  // o checkpoint só serve para um SO com o mesmo tipo de tabela
+  bool tem_tabinv;
+  if (!ckpt_le(ckpt, &tem_tabinv, sizeof(tem_tabinv))
+      || tem_tabinv != (self->tabinv != NULL)) {
+    return false;
+  }
+  return self->tabinv == NULL || tabinv_restaura(self->tabinv, ckpt);
+}
+
 
 // TRATAMENTO DE INTERRUPÇÃO {{{1
 
@@ -159,7 +226,7 @@ static int so_trata_interrupcao(void *argC, int reg_A)
   so_t *self = argC;
   irq_t irq = reg_A;
   // esse print polui bastante, recomendo tirar quando estiver com mais confiança
-  console_printf("SO: recebi IRQ %d (%s)", irq, irq_nome(irq));
+  log_rastro(self->console, "SO: recebi IRQ %d (%s)", irq, irq_nome(irq));
   // salva o estado da cpu no descritor do processo que foi interrompido
   so_salva_estado_da_cpu(self);
   // faz o atendimento da interrupção
@@ -176,7 +243,7 @@ static void so_salva_estado_da_cpu(so_t *self)
 {
   // t1: salva os registradores que compõem o estado da cpu no descritor do
   //   processo corrente. os valores dos registradores foram colocados pela
-  //   CPU na memória, nos endereços IRQ_END_*
+  //   CPU no banco de sombra (cpu_estado_salvo); basta copiar a struct
   // se não houver processo corrente, não faz nada
 }
 
@@ -200,10 +267,13 @@ static void so_escalona(so_t *self)
 static int so_despacha(so_t *self)
 {
   // t1: se houver processo corrente, coloca o estado desse processo onde ele
-  //   será recuperado pela CPU (em IRQ_END_*) e retorna 0, senão retorna 1
+  //   será recuperado pela CPU (no banco de sombra, cpu_estado_salvo) e
+  //   retorna 0, senão retorna 1
   // o valor retornado será o valor de retorno de CHAMAC
+  // t1: com perfil de execução (cpu_perfil), informar o processo despachado
+  //   com perfil_define_processo
   // passa o processador para modo usuário
-  mem_escreve(self->mem, IRQ_END_erro, ERR_OK);
+  cpu_estado_salvo(self->cpu)->erro = ERR_OK;
   if (self->erro_interno) return 1;
   else return 0;
 }
@@ -244,40 +314,44 @@ static void so_trata_irq_reset(so_t *self)
   // t1: deveria criar um processo para o init, e inicializar o estado do
   //   processador para esse processo com os registradores zerados, exceto
   //   o PC e o modo.
-  // como não tem suporte a processos, está carregando os valores dos
-  //   registradores diretamente para a memória, de onde a CPU vai carregar
-  //   para os seus registradores quando executar a instrução RETI
+  // como não tem suporte a processos, está colocando os valores dos
+  //   registradores diretamente no banco de sombra, de onde a CPU vai
+  //   carregar para os seus registradores quando executar a instrução RETI
 
   // coloca o programa "init" na memória
   // t2: deveria criar um processo, e programar a tabela de páginas dele
   processo_t processo = 1; // deveria inicializar um processo...
-  int ender = so_carrega_programa(self, processo, "init.maq");
+  int ender = so_carrega_programa(self, processo, self->programa_inicial);
   if (ender != 0) {
-    console_printf("SO: problema na carga do programa inicial");
+    log_erro(self->console, "SO: problema na carga do programa inicial");
     self->erro_interno = true;
     return;
   }
 
+  // o perfil de execução (se houver) conta as instruções para esse processo
+  // t1: com processos, isso deve ser feito no despacho
+  if (cpu_perfil(self->cpu) != NULL) {
+    perfil_define_processo(cpu_perfil(self->cpu), processo);
+  }
+
   // altera o PC para o endereço de carga (deve ter sido o endereço virtual 0)
-  mem_escreve(self->mem, IRQ_END_PC, ender);
+  cpu_estado_salvo(self->cpu)->PC = ender;
   // passa o processador para modo usuário
-  mem_escreve(self->mem, IRQ_END_modo, usuario);
+  cpu_estado_salvo(self->cpu)->modo = usuario;
 }
 
 // interrupção gerada quando a CPU identifica um erro
 static void so_trata_irq_err_cpu(so_t *self)
 {
   // Ocorreu um erro interno na CPU
-  // O erro está codificado em IRQ_END_erro
+  // O erro está no registrador erro salvo pela CPU
   // Em geral, causa a morte do processo que causou o erro
   // Ainda não temos processos, causa a parada da CPU
-  int err_int;
   // t1: com suporte a processos, deveria pegar o valor do registrador erro
   //   no descritor do processo corrente, e reagir de acordo com esse erro
   //   (em geral, matando o processo)
-  mem_le(self->mem, IRQ_END_erro, &err_int);
-  err_t err = err_int;
-  console_printf("SO: IRQ não tratada -- erro na CPU: %s", err_nome(err));
+  err_t err = cpu_estado_salvo(self->cpu)->erro;
+  log_erro(self->console, "SO: IRQ não tratada -- erro na CPU: %s", err_nome(err));
   self->erro_interno = true;
 }
 
@@ -289,19 +363,19 @@ static void so_trata_irq_relogio(so_t *self)
   e1 = es_escreve(self->es, D_RELOGIO_INTERRUPCAO, 0); // desliga o sinalizador de interrupção
   e2 = es_escreve(self->es, D_RELOGIO_TIMER, INTERVALO_INTERRUPCAO);
   if (e1 != ERR_OK || e2 != ERR_OK) {
-    console_printf("SO: problema da reinicialização do timer");
+    log_erro(self->console, "SO: problema da reinicialização do timer");
     self->erro_interno = true;
   }
   // t1: deveria tratar a interrupção
   //   por exemplo, decrementa o quantum do processo corrente, quando se tem
   //   um escalonador com quantum
-  console_printf("SO: interrupção do relógio (não tratada)");
+  log_rastro(self->console, "SO: interrupção do relógio (não tratada)");
 }
 
 // foi gerada uma interrupção para a qual o SO não está preparado
 static void so_trata_irq_desconhecida(so_t *self, int irq)
 {
-  console_printf("SO: não sei tratar IRQ %d (%s)", irq, irq_nome(irq));
+  log_erro(self->console, "SO: não sei tratar IRQ %d (%s)", irq, irq_nome(irq));
   self->erro_interno = true;
 }
 
@@ -318,13 +392,8 @@ static void so_trata_irq_chamada_sistema(so_t *self)
 {
   // a identificação da chamada está no registrador A
   // t1: com processos, o reg A tá no descritor do processo corrente
-  int id_chamada;
-  if (mem_le(self->mem, IRQ_END_A, &id_chamada) != ERR_OK) {
-    console_printf("SO: erro no acesso ao id da chamada de sistema");
-    self->erro_interno = true;
-    return;
-  }
-  console_printf("SO: chamada de sistema %d", id_chamada);
+  int id_chamada = cpu_estado_salvo(self->cpu)->A;
+  log_rastro(self->console, "SO: chamada de sistema %d", id_chamada);
   switch (id_chamada) {
     case SO_LE:
       so_chamada_le(self);
@@ -342,7 +411,7 @@ static void so_trata_irq_chamada_sistema(so_t *self)
       so_chamada_espera_proc(self);
       break;
     default:
-      console_printf("SO: chamada de sistema desconhecida (%d)", id_chamada);
+      log_erro(self->console, "SO: chamada de sistema desconhecida (%d)", id_chamada);
       // t1: deveria matar o processo
       self->erro_interno = true;
   }
@@ -364,7 +433,7 @@ static void so_chamada_le(so_t *self)
   for (;;) {
     int estado;
     if (es_le(self->es, D_TERM_A_TECLADO_OK, &estado) != ERR_OK) {
-      console_printf("SO: problema no acesso ao estado do teclado");
+      log_erro(self->console, "SO: problema no acesso ao estado do teclado");
       self->erro_interno = true;
       return;
     }
@@ -377,16 +446,17 @@ static void so_chamada_le(so_t *self)
   }
   int dado;
   if (es_le(self->es, D_TERM_A_TECLADO, &dado) != ERR_OK) {
-    console_printf("SO: problema no acesso ao teclado");
+    log_erro(self->console, "SO: problema no acesso ao teclado");
     self->erro_interno = true;
     return;
   }
   // escreve no reg A do processador
-  // (na verdade, na posição onde o processador vai pegar o A quando retornar da int)
+  // (na verdade, no banco de sombra, de onde o processador vai pegar o A quando
+  //   retornar da int)
   // T1: se houvesse processo, deveria escrever no reg A do processo
   // T1: o acesso só deve ser feito nesse momento se for possível; se não, o processo
   //   é bloqueado, e o acesso só deve ser feito mais tarde (e o processo desbloqueado)
-  mem_escreve(self->mem, IRQ_END_A, dado);
+  cpu_estado_salvo(self->cpu)->A = dado;
 }
 
 // implementação da chamada se sistema SO_ESCR
@@ -400,7 +470,7 @@ static void so_chamada_escr(so_t *self)
   for (;;) {
     int estado;
     if (es_le(self->es, D_TERM_A_TELA_OK, &estado) != ERR_OK) {
-      console_printf("SO: problema no acesso ao estado da tela");
+      log_erro(self->console, "SO: problema no acesso ao estado da tela");
       self->erro_interno = true;
       return;
     }
@@ -416,13 +486,13 @@ static void so_chamada_escr(so_t *self)
   // T1: deveria usar os registradores do processo que está realizando a E/S
   // T1: caso o processo tenha sido bloqueado, esse acesso deve ser realizado em outra execução
   //   do SO, quando ele verificar que esse acesso já pode ser feito.
-  mem_le(self->mem, IRQ_END_X, &dado);
+  dado = cpu_estado_salvo(self->cpu)->X;
   if (es_escreve(self->es, D_TERM_A_TELA, dado) != ERR_OK) {
-    console_printf("SO: problema no acesso à tela");
+    log_erro(self->console, "SO: problema no acesso à tela");
     self->erro_interno = true;
     return;
   }
-  mem_escreve(self->mem, IRQ_END_A, 0);
+  cpu_estado_salvo(self->cpu)->A = 0;
 }
 
 // implementação da chamada se sistema SO_CRIA_PROC
@@ -435,23 +505,24 @@ static void so_chamada_cria_proc(so_t *self)
   processo_t processo = 1; // T2: o processo criado
 
   // em X está o endereço onde está o nome do arquivo
-  int ender_proc;
   // t1: deveria ler o X do descritor do processo criador
-  if (mem_le(self->mem, IRQ_END_X, &ender_proc) == ERR_OK) {
-    char nome[100];
-    if (so_copia_str_do_processo(self, 100, nome, ender_proc, processo)) {
-      int ender_carga = so_carrega_programa(self, processo, nome);
-      // o endereço de carga é endereço virtual, deve ser 0
-      if (ender_carga == 0) {
-        // deveria escrever no PC do descritor do processo criado
-        mem_escreve(self->mem, IRQ_END_PC, ender_carga);
-        return;
-      } // else?
-    }
+  int ender_proc = cpu_estado_salvo(self->cpu)->X;
+  char nome[100];
+  if (so_copia_str_do_processo(self, 100, nome, ender_proc, processo)) {
+    int ender_carga = so_carrega_programa(self, processo, nome);
+    // o endereço de carga é endereço virtual, deve ser 0
+    if (ender_carga == 0) {
+      // deveria escrever no PC do descritor do processo criado
+      cpu_estado_salvo(self->cpu)->PC = ender_carga;
+      if (cpu_perfil(self->cpu) != NULL) {
+        perfil_define_processo(cpu_perfil(self->cpu), processo);
+      }
+      return;
+    } // else?
   }
   // deveria escrever -1 (se erro) ou o PID do processo criado (se OK) no reg A
   //   do processo que pediu a criação
-  mem_escreve(self->mem, IRQ_END_A, -1);
+  cpu_estado_salvo(self->cpu)->A = -1;
 }
 
 // implementação da chamada se sistema SO_MATA_PROC
@@ -460,8 +531,8 @@ static void so_chamada_mata_proc(so_t *self)
 {
   // T1: deveria matar um processo
   // ainda sem suporte a processos, retorna erro -1
-  console_printf("SO: SO_MATA_PROC não implementada");
-  mem_escreve(self->mem, IRQ_END_A, -1);
+  log_erro(self->console, "SO: SO_MATA_PROC não implementada");
+  cpu_estado_salvo(self->cpu)->A = -1;
 }
 
 // implementação da chamada se sistema SO_ESPERA_PROC
@@ -470,60 +541,70 @@ static void so_chamada_espera_proc(so_t *self)
 {
   // T1: deveria bloquear o processo se for o caso (e desbloquear na morte do esperado)
   // ainda sem suporte a processos, retorna erro -1
-  console_printf("SO: SO_ESPERA_PROC não implementada");
-  mem_escreve(self->mem, IRQ_END_A, -1);
+  log_erro(self->console, "SO: SO_ESPERA_PROC não implementada");
+  cpu_estado_salvo(self->cpu)->A = -1;
 }
 
 // CARGA DE PROGRAMA {{{1
 
 // funções auxiliares
-static int so_carrega_programa_na_memoria_fisica(so_t *self, programa_t *programa);
+static int so_carrega_programa_na_memoria_fisica(so_t *self, programa_t *programa,
+                                                 char *nome);
 static int so_carrega_programa_na_memoria_virtual(so_t *self,
                                                   programa_t *programa,
-                                                  processo_t processo);
+                                                  processo_t processo,
+                                                  char *nome);
 
 // carrega o programa na memória de um processo ou na memória física se NENHUM_PROCESSO
 // retorna o endereço de carga ou -1
 static int so_carrega_programa(so_t *self, processo_t processo,
                                char *nome_do_executavel)
 {
-  console_printf("SO: carga de '%s'", nome_do_executavel);
+  log_info(self->console, "SO: carga de '%s'", nome_do_executavel);
 
   programa_t *programa = prog_cria(nome_do_executavel);
   if (programa == NULL) {
-    console_printf("Erro na leitura do programa '%s'\n", nome_do_executavel);
+    log_erro(self->console, "Erro na leitura do programa '%s'\n", nome_do_executavel);
     return -1;
   }
 
   int end_carga;
   if (processo == NENHUM_PROCESSO) {
-    end_carga = so_carrega_programa_na_memoria_fisica(self, programa);
+    end_carga = so_carrega_programa_na_memoria_fisica(self, programa,
+                                                      nome_do_executavel);
   } else {
-    end_carga = so_carrega_programa_na_memoria_virtual(self, programa, processo);
+    end_carga = so_carrega_programa_na_memoria_virtual(self, programa, processo,
+                                                       nome_do_executavel);
   }
 
   prog_destroi(programa);
   return end_carga;
 }
 
-static int so_carrega_programa_na_memoria_fisica(so_t *self, programa_t *programa)
+static int so_carrega_programa_na_memoria_fisica(so_t *self, programa_t *programa,
+                                                 char *nome)
 {
   int end_ini = prog_end_carga(programa);
   int end_fim = end_ini + prog_tamanho(programa);
 
   for (int end = end_ini; end < end_fim; end++) {
     if (mem_escreve(self->mem, end, prog_dado(programa, end)) != ERR_OK) {
-      console_printf("Erro na carga da memória, endereco %d\n", end);
+      log_erro(self->console, "Erro na carga da memória, endereco %d\n", end);
       return -1;
     }
   }
-  console_printf("carregado na memória física, %d-%d", end_ini, end_fim);
+  log_info(self->console, "carregado na memória física, %d-%d", end_ini, end_fim);
+  perfil_t *perfil = cpu_perfil(self->cpu);
+  if (perfil != NULL) {
+    perfil_carga(perfil, NENHUM_PROCESSO, nome, end_ini, end_ini, end_fim - end_ini);
+  }
   return end_ini;
 }
 
 static int so_carrega_programa_na_memoria_virtual(so_t *self,
                                                   programa_t *programa,
-                                                  processo_t processo)
+                                                  processo_t processo,
+                                                  char *nome)
 {
   // t2: isto tá furado...
   // está simplesmente lendo para o próximo quadro que nunca foi ocupado,
@@ -542,7 +623,11 @@ static int so_carrega_programa_na_memoria_virtual(so_t *self,
   // mapeia as páginas nos quadros
   int quadro = quadro_ini;
   for (int pagina = pagina_ini; pagina <= pagina_fim; pagina++) {
-    //tabpag_define_quadro(self->tabpag_global, pagina, quadro);
+    tabpag_define_quadro(self->tabpag_global, pagina, quadro);
+    // com a tabela invertida, o mapeamento que vale é o dela
+    // t2: com processos, a página é identificada pelo ASID do processo (e
+    //     não por 0)
+    if (self->tabinv != NULL) tabinv_define_quadro(self->tabinv, 0, pagina, quadro);
     quadro++;
   }
   self->quadro_livre = quadro;
@@ -552,14 +637,19 @@ static int so_carrega_programa_na_memoria_virtual(so_t *self,
   int end_fis = end_fis_ini;
   for (int end_virt = end_virt_ini; end_virt <= end_virt_fim; end_virt++) {
     if (mem_escreve(self->mem, end_fis, prog_dado(programa, end_virt)) != ERR_OK) {
-      console_printf("Erro na carga da memória, end virt %d fís %d\n", end_virt,
+      log_erro(self->console, "Erro na carga da memória, end virt %d fís %d\n", end_virt,
                      end_fis);
       return -1;
     }
     end_fis++;
   }
-  console_printf("carregado na memória virtual V%d-%d F%d-%d",
+  log_info(self->console, "carregado na memória virtual V%d-%d F%d-%d",
                  end_virt_ini, end_virt_fim, end_fis_ini, end_fis - 1);
+  perfil_t *perfil = cpu_perfil(self->cpu);
+  if (perfil != NULL) {
+    perfil_carga(perfil, processo, nome, end_virt_ini, end_fis_ini,
+                 end_fis - end_fis_ini);
+  }
   return end_virt_ini;
 }
 
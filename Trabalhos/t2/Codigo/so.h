@@ -18,6 +18,25 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu,
               es_t *es, console_t *console);
 void so_destroi(so_t *self);
 
+// define o nome do arquivo com o programa que o SO executa ao iniciar
+//   (o padrão é "init.maq"); deve ser chamada antes da simulação iniciar
+void so_define_programa_inicial(so_t *self, char *nome);
+
+// faz o SO usar uma tabela de páginas invertida (tabinv.h), comum a todos os
+//   processos, no lugar da tabela de páginas (tabpag.h), para comparar o
+//   custo da tradução nos dois casos; deve ser chamada antes da simulação
+//   iniciar
+void so_usa_tabela_invertida(so_t *self);
+
+// retorna true se o SO não tem mais o que executar (não tem mais processos)
+bool so_terminou(so_t *self);
+
+// salva e restaura o estado do SO (incluindo a tabela de páginas) em um
+//   checkpoint
+// so_restaura retorna false se não for possível
+void so_salva(so_t *self, ckpt_t *ckpt);
+bool so_restaura(so_t *self, ckpt_t *ckpt);
+
 // Chamadas de sistema
 // Uma chamada de sistema é realizada colocando a identificação da
 //   chamada (um dos valores abaixo) no registrador A e executando a
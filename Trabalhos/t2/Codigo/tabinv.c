@@ -0,0 +1,277 @@
+// tabinv.c
+// tabela de páginas invertida para a MMU
+// simulador de computador
+// so24b
+
+#include "tabinv.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+// a entrada de um quadro
+typedef struct {
+  // o quadro tem uma página ou não
+  bool valida;
+  // a página foi acessada ou não
+  bool acessada;
+  // a página foi alterada ou não
+  bool alterada;
+  // qual página, de qual espaço, está no quadro
+  int asid;
+  int pagina;
+  // próximo quadro na mesma lista de colisão, ou -1
+  int prox;
+} entrada_t;
+
+struct tabinv_t {
+  // uma entrada por quadro
+  int n_quadros;
+  entrada_t *entradas;
+  // primeiro quadro de cada lista de colisão, ou -1
+  // o número de listas é uma potência de 2
+  int n_listas;
+  int *listas;
+  // quem é avisado das alterações nas traduções
+  tabinv_f_alteracao_t observador;
+  void *arg_observador;
+  tabinv_estatisticas_t estat;
+};
+
+tabinv_t *tabinv_cria(int n_quadros)
+{
+  assert(n_quadros > 0);
+  tabinv_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->n_quadros = n_quadros;
+  self->entradas = malloc(n_quadros * sizeof(entrada_t));
+  assert(self->entradas != NULL);
+  memset(self->entradas, 0, n_quadros * sizeof(entrada_t));
+  self->n_listas = 1;
+  while (self->n_listas < n_quadros) self->n_listas *= 2;
+  self->listas = malloc(self->n_listas * sizeof(int));
+  assert(self->listas != NULL);
+  for (int i = 0; i < self->n_listas; i++) self->listas[i] = -1;
+  self->observador = NULL;
+  memset(&self->estat, 0, sizeof(self->estat));
+  return self;
+}
+
+// avisa o observador da alteração na página
+static void tabinv__avisa(tabinv_t *self, int asid, int pagina)
+{
+  if (self->observador != NULL) {
+    self->observador(self->arg_observador, asid, pagina);
+  }
+}
+
+void tabinv_destroi(tabinv_t *self)
+{
+  if (self != NULL) {
+    tabinv__avisa(self, -1, -1);
+    free(self->entradas);
+    free(self->listas);
+    free(self);
+  }
+}
+
+void tabinv_define_observador(tabinv_t *self, tabinv_f_alteracao_t func,
+                              void *arg)
+{
+  self->observador = func;
+  self->arg_observador = arg;
+}
+
+// TABELA HASH {{{1
+
+// retorna a lista de colisão do par (asid, pagina)
+static int tabinv__lista(tabinv_t *self, int asid, int pagina)
+{
+  uint32_t h = (uint32_t)asid * 0x9E3779B1u ^ (uint32_t)pagina * 0x85EBCA77u;
+  h ^= h >> 15;
+  return h & (self->n_listas - 1);
+}
+
+// retorna o quadro que contém a página do espaço 'asid', ou -1
+static int tabinv__busca(tabinv_t *self, int asid, int pagina)
+{
+  self->estat.buscas++;
+  if (asid < 0 || pagina < 0) return -1;
+  int quadro = self->listas[tabinv__lista(self, asid, pagina)];
+  while (quadro != -1) {
+    self->estat.comparacoes++;
+    entrada_t *e = &self->entradas[quadro];
+    if (e->pagina == pagina && e->asid == asid) break;
+    quadro = e->prox;
+  }
+  return quadro;
+}
+
+// retorna a entrada da página do espaço 'asid', ou NULL se não estiver mapeada
+static entrada_t *tabinv__entrada(tabinv_t *self, int asid, int pagina)
+{
+  int quadro = tabinv__busca(self, asid, pagina);
+  if (quadro == -1) return NULL;
+  return &self->entradas[quadro];
+}
+
+// tira o quadro (que deve ter uma página) da lista de colisão, e invalida a
+//   entrada dele
+// não avisa o observador
+static void tabinv__retira(tabinv_t *self, int quadro)
+{
+  entrada_t *e = &self->entradas[quadro];
+  int *pq = &self->listas[tabinv__lista(self, e->asid, e->pagina)];
+  while (*pq != quadro) {
+    assert(*pq != -1);
+    pq = &self->entradas[*pq].prox;
+  }
+  *pq = e->prox;
+  e->valida = false;
+}
+
+// OPERAÇÕES {{{1
+
+void tabinv_define_quadro(tabinv_t *self, int asid, int pagina, int quadro)
+{
+  assert(asid >= 0 && pagina >= 0);
+  assert(quadro >= 0 && quadro < self->n_quadros);
+  // a página sai do quadro antigo
+  int antigo = tabinv__busca(self, asid, pagina);
+  if (antigo != -1) tabinv__retira(self, antigo);
+  // a página que estava no quadro deixa de estar mapeada
+  entrada_t *e = &self->entradas[quadro];
+  if (e->valida) {
+    tabinv__retira(self, quadro);
+    tabinv__avisa(self, e->asid, e->pagina);
+  }
+  int *plista = &self->listas[tabinv__lista(self, asid, pagina)];
+  e->valida = true;
+  e->acessada = false;
+  e->alterada = false;
+  e->asid = asid;
+  e->pagina = pagina;
+  e->prox = *plista;
+  *plista = quadro;
+  tabinv__avisa(self, asid, pagina);
+}
+
+void tabinv_invalida_pagina(tabinv_t *self, int asid, int pagina)
+{
+  int quadro = tabinv__busca(self, asid, pagina);
+  if (quadro == -1) return;
+  tabinv__retira(self, quadro);
+  tabinv__avisa(self, asid, pagina);
+}
+
+void tabinv_invalida_asid(tabinv_t *self, int asid)
+{
+  for (int quadro = 0; quadro < self->n_quadros; quadro++) {
+    entrada_t *e = &self->entradas[quadro];
+    if (e->valida && e->asid == asid) tabinv__retira(self, quadro);
+  }
+  tabinv__avisa(self, asid, -1);
+}
+
+bool tabinv_pagina_do_quadro(tabinv_t *self, int quadro,
+                             int *pasid, int *ppagina)
+{
+  if (quadro < 0 || quadro >= self->n_quadros) return false;
+  entrada_t *e = &self->entradas[quadro];
+  if (!e->valida) return false;
+  *pasid = e->asid;
+  *ppagina = e->pagina;
+  return true;
+}
+
+void tabinv_marca_bit_acesso(tabinv_t *self, int asid, int pagina,
+                             bool alteracao)
+{
+  entrada_t *e = tabinv__entrada(self, asid, pagina);
+  if (e == NULL) return;
+  e->acessada = true;
+  if (alteracao) {
+    e->alterada = true;
+  }
+}
+
+void tabinv_zera_bit_acesso(tabinv_t *self, int asid, int pagina)
+{
+  entrada_t *e = tabinv__entrada(self, asid, pagina);
+  if (e == NULL) return;
+  e->acessada = false;
+  tabinv__avisa(self, asid, pagina);
+}
+
+bool tabinv_bit_acesso(tabinv_t *self, int asid, int pagina)
+{
+  entrada_t *e = tabinv__entrada(self, asid, pagina);
+  if (e == NULL) return false;
+  return e->acessada;
+}
+
+bool tabinv_bit_alteracao(tabinv_t *self, int asid, int pagina)
+{
+  entrada_t *e = tabinv__entrada(self, asid, pagina);
+  if (e == NULL) return false;
+  return e->alterada;
+}
+
+err_t tabinv_traduz(tabinv_t *self, int asid, int pagina, int *pquadro)
+{
+  int quadro = tabinv__busca(self, asid, pagina);
+  if (quadro == -1) return ERR_PAG_AUSENTE;
+  *pquadro = quadro;
+  return ERR_OK;
+}
+
+tabinv_estatisticas_t tabinv_estatisticas(tabinv_t *self)
+{
+  return self->estat;
+}
+
+// CHECKPOINT {{{1
+
+void tabinv_salva(tabinv_t *self, ckpt_t *ckpt)
+{
+  ckpt_escreve(ckpt, &self->n_quadros, sizeof(self->n_quadros));
+  ckpt_escreve(ckpt, self->entradas, self->n_quadros * sizeof(entrada_t));
+  ckpt_escreve(ckpt, self->listas, self->n_listas * sizeof(int));
+  ckpt_escreve(ckpt, &self->estat, sizeof(self->estat));
+}
+
+bool tabinv_restaura(tabinv_t *self, ckpt_t *ckpt)
+{
+  int n_quadros;
+  if (!ckpt_le(ckpt, &n_quadros, sizeof(n_quadros))
+      || n_quadros != self->n_quadros) {
+    return false;
+  }
+  entrada_t *entradas = malloc(n_quadros * sizeof(entrada_t));
+  int *listas = malloc(self->n_listas * sizeof(int));
+  assert(entradas != NULL && listas != NULL);
+  ckpt_le(ckpt, entradas, n_quadros * sizeof(entrada_t));
+  ckpt_le(ckpt, listas, self->n_listas * sizeof(int));
+  tabinv_estatisticas_t estat;
+  bool ok = ckpt_le(ckpt, &estat, sizeof(estat));
+  // os encadeamentos devem ser índices de quadro válidos
+  for (int i = 0; ok && i < self->n_listas; i++) {
+    ok = listas[i] >= -1 && listas[i] < n_quadros;
+  }
+  for (int i = 0; ok && i < n_quadros; i++) {
+    ok = entradas[i].prox >= -1 && entradas[i].prox < n_quadros;
+  }
+  if (!ok) {
+    free(entradas);
+    free(listas);
+    return false;
+  }
+  free(self->entradas);
+  free(self->listas);
+  self->entradas = entradas;
+  self->listas = listas;
+  self->estat = estat;
+  return true;
+}
+
+// vim: foldmethod=marker
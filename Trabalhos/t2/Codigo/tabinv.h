@@ -0,0 +1,91 @@
+// tabinv.h
+// tabela de páginas invertida para a MMU
+// simulador de computador
+// so24b
+
+#ifndef TABINV_H
+#define TABINV_H
+
+// alternativa a ter uma tabela de páginas (tabpag.h) por processo: uma só
+//   tabela para todos os processos, com uma entrada por quadro da memória
+//   principal, que diz qual página de qual espaço de endereçamento (ASID)
+//   está no quadro
+// a memória ocupada pela tabela depende só do tamanho da memória principal,
+//   não do número de processos nem do tamanho dos espaços de endereçamento
+// para traduzir, a entrada com o par (ASID, página) é procurada em uma tabela
+//   hash (com listas de colisão), com tantas listas quanto quadros (arredondado
+//   para cima para uma potência de 2)
+// mantém para cada página mapeada um bit de acesso e um bit de alteração
+
+#include "err.h"
+#include "checkpoint.h"
+#include <stdbool.h>
+
+// tipo opaco que representa a tabela invertida
+typedef struct tabinv_t tabinv_t;
+
+// contadores de uso da tabela, para comparar com a tabela por processo
+typedef struct {
+  long buscas;       // procuras de um par (ASID, página)
+  long comparacoes;  // entradas examinadas nessas procuras
+} tabinv_estatisticas_t;
+
+// cria uma tabela invertida para uma memória com 'n_quadros' quadros, sem
+//   nenhuma página mapeada
+// mata o programa em caso de erro (malloc)
+tabinv_t *tabinv_cria(int n_quadros);
+
+// destrói a tabela
+// o observador, se houver, é chamado com ASID -1
+void tabinv_destroi(tabinv_t *self);
+
+// tipo da função chamada quando a tradução de uma página muda (ou o bit de
+//   acesso é zerado), com o ASID e a página alterada
+// a página é -1 quando todas as páginas do ASID são alteradas, e o ASID é -1
+//   quando a tabela deixa de existir
+typedef void (*tabinv_f_alteracao_t)(void *arg, int asid, int pagina);
+
+// define a função a chamar após alterações nas traduções, e o argumento a
+//   passar para ela (para quem mantém cópias das traduções, como a TLB)
+// se 'func' for NULL, não chama nada
+void tabinv_define_observador(tabinv_t *self, tabinv_f_alteracao_t func,
+                              void *arg);
+
+// define que a página 'pagina' do espaço 'asid' está no quadro 'quadro'
+// os bits de acesso e alteração dessa página são zerados
+// se a página estava em outro quadro, ou se o quadro tinha outra página,
+//   essas traduções deixam de existir
+void tabinv_define_quadro(tabinv_t *self, int asid, int pagina, int quadro);
+
+// marca a página 'pagina' do espaço 'asid' como inválida
+void tabinv_invalida_pagina(tabinv_t *self, int asid, int pagina);
+
+// marca como inválidas todas as páginas do espaço 'asid' (quando o processo
+//   termina, por exemplo)
+void tabinv_invalida_asid(tabinv_t *self, int asid);
+
+// retorna em '*pasid' e '*ppagina' qual página está no quadro 'quadro'
+// retorna false se o quadro não tiver página
+bool tabinv_pagina_do_quadro(tabinv_t *self, int quadro,
+                             int *pasid, int *ppagina);
+
+// as funções abaixo são como as de mesmo nome em tabpag.h, para a página
+//   'pagina' do espaço 'asid'
+void tabinv_marca_bit_acesso(tabinv_t *self, int asid, int pagina,
+                             bool alteracao);
+void tabinv_zera_bit_acesso(tabinv_t *self, int asid, int pagina);
+bool tabinv_bit_acesso(tabinv_t *self, int asid, int pagina);
+bool tabinv_bit_alteracao(tabinv_t *self, int asid, int pagina);
+err_t tabinv_traduz(tabinv_t *self, int asid, int pagina, int *pquadro);
+
+// retorna os contadores de uso da tabela
+tabinv_estatisticas_t tabinv_estatisticas(tabinv_t *self);
+
+// salva e restaura a tabela em um checkpoint
+// a tabela restaurada deve ter o mesmo número de quadros da salva
+// tabinv_restaura retorna false se não for possível
+// quem tem cópia das traduções não é avisado (o observador não é chamado)
+void tabinv_salva(tabinv_t *self, ckpt_t *ckpt);
+bool tabinv_restaura(tabinv_t *self, ckpt_t *ckpt);
+
+#endif // TABINV_H
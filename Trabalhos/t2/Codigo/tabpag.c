@@ -5,133 +5,396 @@
 
 #include "tabpag.h"
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <stdint.h>
 
-// estrutura auxiliar, contém informação sobre uma página
+// a tabela é uma árvore (radix) de NIVEIS níveis, em que cada nó tem TAM_NO
+//   posições; o número da página é dividido em NIVEIS grupos de BITS_NIVEL
+//   bits, o mais significativo escolhe a posição na raiz, o seguinte no nível
+//   abaixo etc.
+// só existem os nós necessários para as páginas válidas: a memória ocupada é
+//   proporcional ao número de páginas mapeadas (e não ao maior número de
+//   página), e a tradução consulta no máximo NIVEIS nós
+// NIVEIS * BITS_NIVEL deve cobrir todos os números de página não negativos
+#define BITS_NIVEL 8
+#define NIVEIS 4
+#define TAM_NO (1 << BITS_NIVEL)
+
+// descritor de uma página, em uma palavra de 32 bits
+// os bits menos significativos dizem se a página está mapeada, se foi
+//   acessada e se foi alterada; os bits 3 a 7 estão reservados (para bits de
+//   proteção, por exemplo); o quadro da memória principal correspondente à
+//   página fica nos 24 bits mais significativos
+typedef uint32_t descritor_t;
+#define BIT_VALIDA   0  // deve ser o bit 0 (ver tabpag__junta_bits)
+#define BIT_ACESSADA 1
+#define BIT_ALTERADA 2
+#define VALIDA   (1u << BIT_VALIDA)
+#define ACESSADA (1u << BIT_ACESSADA)
+#define ALTERADA (1u << BIT_ALTERADA)
+#define DESLOC_QUADRO 8
+#define QUADRO_MAX ((1 << (32 - DESLOC_QUADRO)) - 1)
+
+// um nó interno da árvore, que aponta para os nós do nível de baixo (que
+//   são folhas, se o nó estiver no penúltimo nível)
 typedef struct {
-  // quadro da memória principal correspondente à página
-  int quadro;
-  // a página está mapeada ou não
-  bool valida;
-  // a página foi acessada ou não
-  bool acessada;
-  // a página foi alterada ou não
-  bool alterada;
-} descritor_t;
+  // número de filhos não NULL
+  // um nó que fica sem posições em uso é liberado
+  int em_uso;
+  void *filhos[TAM_NO];
+} no_t;
+
+// um nó do último nível da árvore, que contém os descritores
+typedef struct {
+  // número de descritores válidos
+  int em_uso;
+  descritor_t descritores[TAM_NO];
+} folha_t;
 
 struct tabpag_t {
-  // número de descritores na tabela (pode ser 0)
-  int tam_tab;
-  // vetor com os descritores
-  // o último descritor do vetor sempre contém uma página válida
-  // pode ser NULL (se tam_tab == 0)
-  descritor_t *tabela;
+  // raiz da árvore (NULL se não tem página válida)
+  void *raiz;
+  // número de páginas válidas
+  int n_validas;
+  // quem é avisado das alterações nas traduções
+  tabpag_f_alteracao_t observador;
+  void *arg_observador;
 };
 
 tabpag_t *tabpag_cria(void)
 {
   tabpag_t *self = malloc(sizeof(*self));
   assert(self != NULL);
-  self->tam_tab = 0;
-  self->tabela = NULL;
+  self->raiz = NULL;
+  self->n_validas = 0;
+  self->observador = NULL;
   return self;
 }
 
+// libera o nó e os nós abaixo dele
+static void tabpag__libera(void *no, int nivel)
+{
+  if (no == NULL) return;
+  if (nivel < NIVEIS - 1) {
+    for (int i = 0; i < TAM_NO; i++) {
+      tabpag__libera(((no_t *)no)->filhos[i], nivel + 1);
+    }
+  }
+  free(no);
+}
+
+// avisa o observador da alteração na página
+static void tabpag__avisa(tabpag_t *self, int pagina)
+{
+  if (self->observador != NULL) {
+    self->observador(self->arg_observador, self, pagina);
+  }
+}
+
 void tabpag_destroi(tabpag_t *self)
 {
   if (self != NULL) {
-    if (self->tabela != NULL) free(self->tabela);
+    tabpag__avisa(self, -1);
+    tabpag__libera(self->raiz, 0);
     free(self);
   }
 }
 
-// retorna true se a página for válida (pode ser traduzida em um quadro)
-static bool tabpag__pagina_valida(tabpag_t *self, int pagina)
+// ÁRVORE {{{1
+
+// retorna a posição da página em um nó do nível 'nivel'
+static int tabpag__indice(int pagina, int nivel)
 {
-  if (pagina < 0 || pagina >= self->tam_tab) return false;
-  return self->tabela[pagina].valida;
+  unsigned int deslocamento = BITS_NIVEL * (NIVEIS - 1 - nivel);
+  return ((unsigned int)pagina >> deslocamento) & (TAM_NO - 1);
 }
 
-void tabpag_invalida_pagina(tabpag_t *self, int pagina)
+// retorna a folha que contém a página, ou NULL se ela não existe
+static folha_t *tabpag__folha(tabpag_t *self, int pagina)
 {
-  // página já é inválida -- não faz nada
-  if (!tabpag__pagina_valida(self, pagina)) return;
-  // página não é a última da tabela -- marca como inválida
-  if (pagina < self->tam_tab - 1) {
-    self->tabela[pagina].valida = false;
-    return;
+  if (pagina < 0) return NULL;
+  void *no = self->raiz;
+  for (int nivel = 0; no != NULL && nivel < NIVEIS - 1; nivel++) {
+    no = ((no_t *)no)->filhos[tabpag__indice(pagina, nivel)];
   }
-  // última página na tabela -- reduz a tabela até que a última seja válida
-  do {
-    self->tam_tab--;
-  } while (self->tam_tab > 0 && !self->tabela[self->tam_tab - 1].valida);
-  if (self->tam_tab == 0) {
-    free(self->tabela);
-    self->tabela = NULL;
-  } else {
-    self->tabela = realloc(self->tabela, self->tam_tab * sizeof(descritor_t));
-    assert(self->tabela != NULL);
+  return no;
+}
+
+// retorna o descritor da página, se a página for válida, ou NULL
+static descritor_t *tabpag__descritor(tabpag_t *self, int pagina)
+{
+  folha_t *folha = tabpag__folha(self, pagina);
+  if (folha == NULL) return NULL;
+  descritor_t *descritor = &folha->descritores[tabpag__indice(pagina, NIVEIS - 1)];
+  if ((*descritor & VALIDA) == 0) return NULL;
+  return descritor;
+}
+
+// cria um nó (interno ou folha) de 'tam' bytes, sem posições em uso
+static void *tabpag__cria_no(size_t tam)
+{
+  void *no = malloc(tam);
+  assert(no != NULL);
+  memset(no, 0, tam);
+  return no;
+}
+
+// cria um nó do nível 'nivel'
+static void *tabpag__cria_no_nivel(int nivel)
+{
+  if (nivel == NIVEIS - 1) return tabpag__cria_no(sizeof(folha_t));
+  return tabpag__cria_no(sizeof(no_t));
+}
+
+// cria, se necessário, os nós do caminho até a página, e retorna o
+//   descritor dela, que passa a ser contado como válido
+static descritor_t *tabpag__insere_pagina(tabpag_t *self, int pagina)
+{
+  if (self->raiz == NULL) self->raiz = tabpag__cria_no_nivel(0);
+  void *no = self->raiz;
+  for (int nivel = 0; nivel < NIVEIS - 1; nivel++) {
+    no_t *interno = no;
+    void **pfilho = &interno->filhos[tabpag__indice(pagina, nivel)];
+    if (*pfilho == NULL) {
+      *pfilho = tabpag__cria_no_nivel(nivel + 1);
+      interno->em_uso++;
+    }
+    no = *pfilho;
+  }
+  folha_t *folha = no;
+  descritor_t *descritor = &folha->descritores[tabpag__indice(pagina, NIVEIS - 1)];
+  if ((*descritor & VALIDA) == 0) {
+    *descritor = VALIDA;
+    folha->em_uso++;
+    self->n_validas++;
   }
+  return descritor;
 }
 
-// aumenta a tabela, se necessário, para que contenha 'pagina'
-static void tabpag__insere_pagina(tabpag_t *self, int pagina)
+// invalida a página (que deve ser válida) na subárvore de 'no', que está no
+//   nível 'nivel', liberando os nós que ficarem vazios
+// retorna true se o próprio 'no' foi liberado
+static bool tabpag__retira_pagina(void *no, int nivel, int pagina)
 {
-  if (pagina < self->tam_tab) return;
-  int novo_tam = pagina + 1;
-  if (self->tam_tab == 0) {
-    self->tabela = malloc(novo_tam * sizeof(descritor_t));
+  int i = tabpag__indice(pagina, nivel);
+  int *pem_uso;
+  if (nivel == NIVEIS - 1) {
+    folha_t *folha = no;
+    folha->descritores[i] = 0;
+    pem_uso = &folha->em_uso;
   } else {
-    self->tabela = realloc(self->tabela, novo_tam * sizeof(descritor_t));
+    no_t *interno = no;
+    if (!tabpag__retira_pagina(interno->filhos[i], nivel + 1, pagina)) {
+      return false;
+    }
+    interno->filhos[i] = NULL;
+    pem_uso = &interno->em_uso;
   }
-  assert(self->tabela != NULL);
-  // marca as páginas inseridas como não válidas
-  while (self->tam_tab < novo_tam) {
-    self->tabela[self->tam_tab].valida = false;
-    self->tam_tab++;
+  (*pem_uso)--;
+  if (*pem_uso > 0) return false;
+  free(no);
+  return true;
+}
+
+// OPERAÇÕES {{{1
+
+void tabpag_invalida_pagina(tabpag_t *self, int pagina)
+{
+  // página já é inválida -- não faz nada
+  if (tabpag__descritor(self, pagina) == NULL) return;
+  tabpag__avisa(self, pagina);
+  if (tabpag__retira_pagina(self->raiz, 0, pagina)) {
+    self->raiz = NULL;
   }
+  self->n_validas--;
 }
 
 void tabpag_define_quadro(tabpag_t *self, int pagina, int quadro)
 {
   assert(pagina >= 0);
-  tabpag__insere_pagina(self, pagina);
-  self->tabela[pagina].quadro = quadro;
-  self->tabela[pagina].valida = true;
-  self->tabela[pagina].acessada = false;
-  self->tabela[pagina].alterada = false;
+  assert(quadro >= 0 && quadro <= QUADRO_MAX);
+  descritor_t *descritor = tabpag__insere_pagina(self, pagina);
+  *descritor = ((descritor_t)quadro << DESLOC_QUADRO) | VALIDA;
+  tabpag__avisa(self, pagina);
 }
 
 void tabpag_marca_bit_acesso(tabpag_t *self, int pagina, bool alteracao)
 {
-  if (!tabpag__pagina_valida(self, pagina)) return;
-  self->tabela[pagina].acessada = true;
+  descritor_t *descritor = tabpag__descritor(self, pagina);
+  if (descritor == NULL) return;
+  *descritor |= ACESSADA;
   if (alteracao) {
-    self->tabela[pagina].alterada = true;
+    *descritor |= ALTERADA;
   }
 }
 
 void tabpag_zera_bit_acesso(tabpag_t *self, int pagina)
 {
-  if (!tabpag__pagina_valida(self, pagina)) return;
-  self->tabela[pagina].acessada = false;
+  descritor_t *descritor = tabpag__descritor(self, pagina);
+  if (descritor == NULL) return;
+  *descritor &= ~ACESSADA;
+  tabpag__avisa(self, pagina);
 }
 
 bool tabpag_bit_acesso(tabpag_t *self, int pagina)
 {
-  if (!tabpag__pagina_valida(self, pagina)) return false;
-  return self->tabela[pagina].acessada;
+  descritor_t *descritor = tabpag__descritor(self, pagina);
+  if (descritor == NULL) return false;
+  return (*descritor & ACESSADA) != 0;
 }
 
 bool tabpag_bit_alteracao(tabpag_t *self, int pagina)
 {
-  if (!tabpag__pagina_valida(self, pagina)) return false;
-  return self->tabela[pagina].alterada;
+  descritor_t *descritor = tabpag__descritor(self, pagina);
+  if (descritor == NULL) return false;
+  return (*descritor & ALTERADA) != 0;
+}
+
+void tabpag_define_observador(tabpag_t *self, tabpag_f_alteracao_t func,
+                              void *arg)
+{
+  self->observador = func;
+  self->arg_observador = arg;
 }
 
 err_t tabpag_traduz(tabpag_t *self, int pagina, int *pquadro)
 {
-  if (!tabpag__pagina_valida(self, pagina)) return ERR_PAG_AUSENTE;
-  *pquadro = self->tabela[pagina].quadro;
+  descritor_t *descritor = tabpag__descritor(self, pagina);
+  if (descritor == NULL) return ERR_PAG_AUSENTE;
+  *pquadro = *descritor >> DESLOC_QUADRO;
   return ERR_OK;
 }
+
+// OPERAÇÕES EM BLOCO {{{1
+
+// as operações em bloco percorrem o intervalo de páginas folha a folha,
+//   pulando as partes da árvore que não existem, e tratam até 64 descritores
+//   consecutivos de cada vez, juntando os bits deles em uma palavra do mapa
+
+// retorna uma palavra com o bit i em 1 se o descritor descr[i] for de página
+//   válida e tiver o bit 'bit' em 1, para i de 0 a n-1 (n <= 64)
+static uint64_t tabpag__junta_bits(descritor_t *descr, int n, int bit)
+{
+  uint64_t bits = 0;
+  for (int i = 0; i < n; i++) {
+    // sem desvios: o bit de validade é o bit 0
+    uint64_t d = descr[i];
+    bits |= ((d >> bit) & d & 1) << i;
+  }
+  return bits;
+}
+
+// percorre o intervalo de páginas em trechos de até 64 descritores
+//   consecutivos dentro de uma mesma folha existente, colocando no mapa os
+//   bits 'bit' deles
+// se 'zera' for true, zera também esse bit nos descritores, avisando o
+//   observador das páginas que tinham o bit em 1
+static void tabpag__mapa(tabpag_t *self, int pagina_ini, int n, uint64_t mapa[],
+                         int bit, bool zera)
+{
+  assert(pagina_ini >= 0 && n >= 0 && pagina_ini <= INT32_MAX - n);
+  memset(mapa, 0, ((n + 63) / 64) * sizeof(uint64_t));
+  int i = 0;
+  while (i < n) {
+    int pagina = pagina_ini + i;
+    int pos = tabpag__indice(pagina, NIVEIS - 1);
+    // o trecho não passa do fim da folha, do fim da palavra do mapa nem do
+    //   fim do intervalo
+    int tam = TAM_NO - pos;
+    if (tam > 64 - i % 64) tam = 64 - i % 64;
+    if (tam > n - i) tam = n - i;
+    folha_t *folha = tabpag__folha(self, pagina);
+    if (folha != NULL) {
+      descritor_t *descr = &folha->descritores[pos];
+      uint64_t bits = tabpag__junta_bits(descr, tam, bit);
+      mapa[i / 64] |= bits << (i % 64);
+      if (zera && bits != 0) {
+        for (int j = 0; j < tam; j++) {
+          descr[j] &= ~(1u << bit);
+        }
+        for (uint64_t b = bits; b != 0 && self->observador != NULL; b &= b - 1) {
+          tabpag__avisa(self, pagina + __builtin_ctzll(b));
+        }
+      }
+    }
+    i += tam;
+  }
+}
+
+void tabpag_mapa_acesso(tabpag_t *self, int pagina_ini, int n, uint64_t mapa[])
+{
+  tabpag__mapa(self, pagina_ini, n, mapa, BIT_ACESSADA, false);
+}
+
+void tabpag_mapa_alteracao(tabpag_t *self, int pagina_ini, int n,
+                           uint64_t mapa[])
+{
+  tabpag__mapa(self, pagina_ini, n, mapa, BIT_ALTERADA, false);
+}
+
+void tabpag_zera_bits_acesso(tabpag_t *self, int pagina_ini, int n,
+                             uint64_t mapa[])
+{
+  tabpag__mapa(self, pagina_ini, n, mapa, BIT_ACESSADA, true);
+}
+
+// CHECKPOINT {{{1
+
+// a tabela é salva como o número de páginas válidas seguido de cada página
+//   válida (número e descritor), em ordem crescente de número
+
+// salva as páginas válidas da subárvore de 'no', que está no nível 'nivel'
+//   e contém as páginas que começam com os bits em 'prefixo'
+static void tabpag__salva_no(void *no, int nivel, unsigned int prefixo,
+                             ckpt_t *ckpt)
+{
+  for (int i = 0; i < TAM_NO; i++) {
+    unsigned int bits = (prefixo << BITS_NIVEL) | i;
+    if (nivel < NIVEIS - 1) {
+      no_t *interno = no;
+      if (interno->filhos[i] != NULL) {
+        tabpag__salva_no(interno->filhos[i], nivel + 1, bits, ckpt);
+      }
+    } else {
+      folha_t *folha = no;
+      if ((folha->descritores[i] & VALIDA) == 0) continue;
+      int pagina = bits;
+      ckpt_escreve(ckpt, &pagina, sizeof(pagina));
+      ckpt_escreve(ckpt, &folha->descritores[i], sizeof(descritor_t));
+    }
+  }
+}
+
+void tabpag_salva(tabpag_t *self, ckpt_t *ckpt)
+{
+  ckpt_escreve(ckpt, &self->n_validas, sizeof(self->n_validas));
+  if (self->raiz != NULL) tabpag__salva_no(self->raiz, 0, 0, ckpt);
+}
+
+bool tabpag_restaura(tabpag_t *self, ckpt_t *ckpt)
+{
+  int n_validas;
+  if (!ckpt_le(ckpt, &n_validas, sizeof(n_validas)) || n_validas < 0) {
+    return false;
+  }
+  // monta a árvore nova à parte, a antiga só é substituída se der tudo certo
+  tabpag_t nova = { .raiz = NULL, .n_validas = 0 };
+  for (int i = 0; i < n_validas; i++) {
+    int pagina;
+    descritor_t lido;
+    ckpt_le(ckpt, &pagina, sizeof(pagina));
+    if (!ckpt_le(ckpt, &lido, sizeof(lido)) || pagina < 0
+        || (lido & VALIDA) == 0) {
+      tabpag__libera(nova.raiz, 0);
+      return false;
+    }
+    *tabpag__insere_pagina(&nova, pagina) = lido;
+  }
+  tabpag__libera(self->raiz, 0);
+  self->raiz = nova.raiz;
+  self->n_validas = nova.n_validas;
+  return true;
+}
+
+// vim: foldmethod=marker
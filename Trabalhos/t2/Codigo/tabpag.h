@@ -11,9 +11,14 @@
 //   de um processo em números de quadros da memória principal onde essas
 //   páginas estão mapeadas
 // mantém para cada página mapeada um bit de acesso e um bit de alteração
+// a memória ocupada é proporcional ao número de páginas mapeadas, não ao
+//   maior número de página (um processo pode ter páginas esparsas, como
+//   código no início e pilha no fim do espaço de endereçamento)
 
 #include "err.h"
+#include "checkpoint.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 // tipo opaco que representa a tabela de páginas
 typedef struct tabpag_t tabpag_t;
@@ -27,8 +32,21 @@ tabpag_t *tabpag_cria(void);
 // destrói uma tabela de páginas
 // libera a memória ocupara pela tabela
 // nenhuma outra operação pode ser realizada na tabela após esta chamada
+// o observador, se houver, é chamado com a página -1
 void tabpag_destroi(tabpag_t *self);
 
+// tipo da função chamada quando a tradução de uma página da tabela muda
+//   (ou o bit de acesso é zerado), com a tabela e a página alterada
+// a página é -1 quando a tabela toda deixa de existir
+typedef void (*tabpag_f_alteracao_t)(void *arg, tabpag_t *tabpag, int pagina);
+
+// define a função a chamar após alterações em tabpag_define_quadro,
+//   tabpag_invalida_pagina e tabpag_zera_bit_acesso, e o argumento a passar
+//   para ela (para quem mantém cópias das traduções, como a TLB da MMU)
+// se 'func' for NULL, não chama nada
+void tabpag_define_observador(tabpag_t *self, tabpag_f_alteracao_t func,
+                              void *arg);
+
 // define que a tradução da página 'pagina' deve resultar no quadro 'quadro'
 // essa página é marcada como válida, e os bits de acesso e alteração para essa
 //   página são zerados
@@ -56,9 +74,35 @@ bool tabpag_bit_acesso(tabpag_t *self, int pagina);
 // retorna false se a página for inválida
 bool tabpag_bit_alteracao(tabpag_t *self, int pagina);
 
+// operações em bloco, para os algoritmos de substituição de páginas que
+//   examinam os bits de muitas páginas (relógio, envelhecimento)
+// tratam as páginas de 'pagina_ini' a 'pagina_ini + n - 1', e colocam o
+//   resultado em 'mapa', que deve ter pelo menos (n + 63) / 64 palavras: o
+//   bit i % 64 de mapa[i / 64] corresponde à página 'pagina_ini + i'
+// páginas inválidas têm o bit em 0 no mapa
+
+// coloca no mapa o bit de acesso das páginas
+void tabpag_mapa_acesso(tabpag_t *self, int pagina_ini, int n, uint64_t mapa[]);
+
+// coloca no mapa o bit de alteração das páginas
+void tabpag_mapa_alteracao(tabpag_t *self, int pagina_ini, int n,
+                           uint64_t mapa[]);
+
+// coloca no mapa o bit de acesso das páginas, e zera esse bit nelas, como
+//   tabpag_zera_bit_acesso (o observador é avisado das páginas que tinham o
+//   bit em 1)
+void tabpag_zera_bits_acesso(tabpag_t *self, int pagina_ini, int n,
+                             uint64_t mapa[]);
+
 // traduz a página 'pagina'; coloca o quadro correspondente na posição apontada
 //   por 'pquadro'
 // retorna ERR_PAG_AUSENTE (e não altera '*pquadro') se a página for inválida
 err_t tabpag_traduz(tabpag_t *self, int pagina, int *pquadro);
 
+// salva e restaura a tabela em um checkpoint
+// tabpag_restaura retorna false se não for possível
+// quem tem cópia das traduções não é avisado (o observador não é chamado)
+void tabpag_salva(tabpag_t *self, ckpt_t *ckpt);
+bool tabpag_restaura(tabpag_t *self, ckpt_t *ckpt);
+
 #endif // TABPAG_H
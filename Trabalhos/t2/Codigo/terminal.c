@@ -32,6 +32,24 @@ struct terminal_t {
   enum { normal, rolando, limpando } estado_saida;
   // posicao do caractere que está sendo movido durante uma rolagem
   int pos_rolagem;
+  // relógio de onde vem o tempo do terminal, e o instante até onde a rolagem
+  //   ou limpeza já foi feita na string de saída
+  // o fim da rolagem ou limpeza é um evento na agenda do relógio; a string de
+  //   saída só é atualizada quando alguém vai vê-la
+  relogio_t *relogio;
+  int instante_saida;
+  // cópia da saída: arquivo, prefixo de cada linha e linha sendo impressa
+  FILE *copia_saida;
+  char *prefixo_copia;
+  char *linha_copia;
+  // arquivo de onde vem a entrada, além do que é inserido pela console
+  // cada caractere lido do arquivo é um evento na agenda do relógio
+  FILE *arquivo_entrada;
+  bool entrada_agendada;
+  int instante_entrada;
+  // gravação ou reprodução da entrada (ou NULL), e o id do terminal nela
+  gravacao_t *gravacao;
+  char id_gravacao;
 };
 
 
@@ -42,28 +60,83 @@ terminal_t *terminal_cria(int tam_linha)
 
   self->saida = malloc(tam_linha + 1);
   self->entrada = malloc(tam_linha + 1);
+  self->linha_copia = malloc(tam_linha + 1);
   assert(self->saida != NULL && self->entrada != NULL);
+  assert(self->linha_copia != NULL);
 
   self->tam_linha = tam_linha;
   strcpy(self->entrada, "");
   strcpy(self->saida, "");
   self->estado_saida = normal;
+  self->relogio = NULL;
+  self->instante_saida = 0;
+  self->copia_saida = NULL;
+  self->prefixo_copia = "";
+  strcpy(self->linha_copia, "");
+  self->arquivo_entrada = NULL;
+  self->entrada_agendada = false;
+  self->gravacao = NULL;
+  self->id_gravacao = '\0';
 
   return self;
 }
 
+static void terminal_copia_linha(terminal_t *self);
+
 void terminal_destroi(terminal_t *self)
 {
+  // a última linha pode não ter terminado
+  if (self->linha_copia[0] != '\0') terminal_copia_linha(self);
   free(self->entrada);
   free(self->saida);
+  free(self->linha_copia);
   free(self);
 }
 
+void terminal_define_copia_saida(terminal_t *self, FILE *arquivo, char *prefixo)
+{
+  self->copia_saida = arquivo;
+  self->prefixo_copia = prefixo;
+}
+
+static void terminal_agenda_entrada(terminal_t *self, int instante);
+
+void terminal_define_arquivo_entrada(terminal_t *self, FILE *arquivo)
+{
+  self->arquivo_entrada = arquivo;
+  if (self->relogio != NULL) {
+    terminal_agenda_entrada(self, relogio_agora(self->relogio) + 1);
+  }
+}
+
+void terminal_define_relogio(terminal_t *self, relogio_t *relogio)
+{
+  self->relogio = relogio;
+  self->instante_saida = relogio_agora(relogio);
+  terminal_agenda_entrada(self, self->instante_saida + 1);
+}
+
+void terminal_define_gravacao(terminal_t *self, gravacao_t *gravacao, char id)
+{
+  self->gravacao = gravacao;
+  self->id_gravacao = id;
+}
+
+static bool terminal_reproduzindo(terminal_t *self)
+{
+  return self->gravacao != NULL && gravacao_reproduzindo(self->gravacao);
+}
+
 static bool terminal_entrada_vazia(terminal_t *self)
 {
   return self->entrada[0] == '\0';
 }
 
+static bool terminal_entrada_cheia(terminal_t *self)
+{
+  return strlen(self->entrada) >= self->tam_linha-2;
+}
+
 static char terminal_le_char(terminal_t *self)
 {
   char *p = self->entrada;
@@ -74,16 +147,113 @@ static char terminal_le_char(terminal_t *self)
   return ch;
 }
 
-void terminal_insere_char(terminal_t *self, char ch)
+static void terminal_insere_char_na_entrada(terminal_t *self, char ch)
 {
+  // se não cabe, ignora silenciosamente
+  if (terminal_entrada_cheia(self)) return;
   char *p = self->entrada;
   int tam = strlen(p);
-  // se não cabe, ignora silenciosamente
-  if (tam >= self->tam_linha-2) return;
   p[tam] = ch;
   p[tam+1] = '\0';
 }
 
+static void terminal_agenda_saida(terminal_t *self);
+
+static void terminal_esvazia_saida(terminal_t *self)
+{
+  self->saida[0] = '\0';
+  self->estado_saida = normal;
+  terminal_agenda_saida(self);
+}
+
+void terminal_insere_char(terminal_t *self, char ch)
+{
+  if (self->gravacao != NULL) {
+    // na reprodução, a entrada só vem da gravação
+    if (gravacao_reproduzindo(self->gravacao)) return;
+    gravacao_registra_entrada(self->gravacao, self->id_gravacao, ch);
+  }
+  terminal_insere_char_na_entrada(self, ch);
+}
+
+// CÓPIA DA SAÍDA E ENTRADA DE ARQUIVO
+
+// escreve a linha de cópia da saída no arquivo, e esvazia ela
+static void terminal_copia_linha(terminal_t *self)
+{
+  if (self->copia_saida != NULL) {
+    fprintf(self->copia_saida, "%s%s\n", self->prefixo_copia, self->linha_copia);
+  }
+  self->linha_copia[0] = '\0';
+}
+
+static void terminal_copia_char(terminal_t *self, char ch)
+{
+  if (self->copia_saida == NULL) return;
+  if (ch == '\n') {
+    terminal_copia_linha(self);
+    return;
+  }
+  int tam = strlen(self->linha_copia);
+  self->linha_copia[tam] = ch;
+  self->linha_copia[tam+1] = '\0';
+  if (tam + 1 >= self->tam_linha) terminal_copia_linha(self);
+}
+
+// na reprodução, insere na entrada os caracteres gravados para este momento,
+//   e limpa a saída se o operador limpou neste momento
+static void terminal_reproduz_entrada(terminal_t *self)
+{
+  int ch;
+  while ((ch = gravacao_entrada(self->gravacao, self->id_gravacao)) != -1) {
+    terminal_insere_char_na_entrada(self, ch);
+  }
+  while (gravacao_limpeza(self->gravacao, self->id_gravacao)) {
+    terminal_esvazia_saida(self);
+  }
+}
+
+// o arquivo de entrada faz parte da configuração da máquina (como os
+//   programas), então o que vem dele não é gravado: na reprodução ele é lido
+//   de novo, do mesmo jeito
+static void terminal_le_arquivo_entrada(terminal_t *self)
+{
+  if (self->arquivo_entrada == NULL) return;
+  // só lê se couber, para não perder o caractere
+  if (terminal_entrada_cheia(self)) return;
+  int ch = fgetc(self->arquivo_entrada);
+  if (ch == EOF) {
+    self->arquivo_entrada = NULL;
+    return;
+  }
+  if (ch == '\n') ch = ' ';
+  terminal_insere_char_na_entrada(self, ch);
+}
+
+// evento da agenda, quando chega um caractere do arquivo de entrada
+static void terminal_chega_entrada(void *arg)
+{
+  terminal_t *self = arg;
+  self->entrada_agendada = false;
+  terminal_le_arquivo_entrada(self);
+  terminal_agenda_entrada(self, self->instante_entrada + 1);
+}
+
+// programa a chegada do próximo caractere do arquivo de entrada para o
+//   instante 'instante', se tem arquivo, espaço na entrada e ainda não está
+//   programada
+// chega um caractere por tic enquanto tiver espaço; quando a CPU lê um
+//   caractere, a chegada é programada de novo
+static void terminal_agenda_entrada(terminal_t *self, int instante)
+{
+  if (self->relogio == NULL || self->entrada_agendada) return;
+  if (self->arquivo_entrada == NULL || terminal_entrada_cheia(self)) return;
+  self->entrada_agendada = true;
+  self->instante_entrada = instante;
+  agenda_insere(relogio_agenda(self->relogio), instante,
+                terminal_chega_entrada, self);
+}
+
 static bool terminal_pode_imprimir(terminal_t *self)
 {
   return self->estado_saida == normal;
@@ -92,25 +262,34 @@ static bool terminal_pode_imprimir(terminal_t *self)
 static void terminal_imprime(terminal_t *self, char ch)
 {
   if (terminal_pode_imprimir(self)) {
+    terminal_copia_char(self, ch);
     if (ch == '\n') {
       self->estado_saida = limpando;
-      return;
+    } else {
+      int tam = strlen(self->saida);
+      self->saida[tam] = ch;
+      tam++;
+      self->saida[tam] = '\0';
+      if (tam >= self->tam_linha - 1) {
+        self->estado_saida = rolando;
+        self->pos_rolagem = 0;
+      }
     }
-    int tam = strlen(self->saida);
-    self->saida[tam] = ch;
-    tam++;
-    self->saida[tam] = '\0';
-    if (tam >= self->tam_linha - 1) {
-      self->estado_saida = rolando;
-      self->pos_rolagem = 0;
+    if (self->estado_saida != normal) {
+      self->instante_saida = relogio_agora(self->relogio);
+      terminal_agenda_saida(self);
     }
   }
 }
 
 void terminal_limpa_saida(terminal_t *self)
 {
-  self->saida[0] = '\0';
-  self->estado_saida = normal;
+  if (self->gravacao != NULL) {
+    // na reprodução, a limpeza só vem da gravação
+    if (gravacao_reproduzindo(self->gravacao)) return;
+    gravacao_registra_limpeza(self->gravacao, self->id_gravacao);
+  }
+  terminal_esvazia_saida(self);
 }
 
 static void terminal_atualiza_rolagem(terminal_t *self)
@@ -139,7 +318,7 @@ static void terminal_atualiza_limpeza(terminal_t *self)
 }
 
 // altera a string de saída em 1 caractere, se estiver rolando ou limpando
-void terminal_tictac(terminal_t *self)
+static void terminal_atualiza_saida_1(terminal_t *self)
 {
   switch (self->estado_saida) {
     case normal: 
@@ -153,6 +332,69 @@ void terminal_tictac(terminal_t *self)
   }
 }
 
+// quantos tics faltam para terminar a rolagem ou a limpeza, a partir do
+//   estado atual da string de saída
+static int terminal_tics_restantes(terminal_t *self)
+{
+  int tam = strlen(self->saida);
+  switch (self->estado_saida) {
+    case rolando:
+      return tam - self->pos_rolagem;
+    case limpando:
+      return tam > 1 ? tam : 1;
+    default:
+      return 0;
+  }
+}
+
+// faz na string de saída os tics de rolagem ou limpeza que passaram desde
+//   'instante_saida' até agora
+static void terminal_alcanca_relogio(terminal_t *self)
+{
+  if (self->relogio == NULL) return;
+  int agora = relogio_agora(self->relogio);
+  while (self->estado_saida != normal && self->instante_saida < agora) {
+    terminal_atualiza_saida_1(self);
+    self->instante_saida++;
+  }
+  self->instante_saida = agora;
+}
+
+// evento da agenda, quando termina a rolagem ou a limpeza
+static void terminal_fim_saida(void *arg)
+{
+  terminal_t *self = arg;
+  terminal_alcanca_relogio(self);
+}
+
+// (re)programa o evento de fim da rolagem ou limpeza, a partir do estado da
+//   string de saída em 'instante_saida'
+static void terminal_agenda_saida(terminal_t *self)
+{
+  if (self->relogio == NULL) return;
+  agenda_t *agenda = relogio_agenda(self->relogio);
+  agenda_remove(agenda, terminal_fim_saida, self);
+  if (self->estado_saida == normal) return;
+  agenda_insere(agenda, self->instante_saida + terminal_tics_restantes(self),
+                terminal_fim_saida, self);
+}
+
+void terminal_atualiza(terminal_t *self)
+{
+  if (terminal_reproduzindo(self)) {
+    terminal_reproduz_entrada(self);
+  }
+}
+
+void terminal_tictac(terminal_t *self)
+{
+  terminal_atualiza(self);
+  terminal_le_arquivo_entrada(self);
+  terminal_alcanca_relogio(self);
+  terminal_atualiza_saida_1(self);
+  terminal_agenda_saida(self);
+}
+
 char *terminal_txt_entrada(terminal_t *self)
 {
   return self->entrada;
@@ -160,6 +402,7 @@ char *terminal_txt_entrada(terminal_t *self)
 
 char *terminal_txt_saida(terminal_t *self)
 {
+  terminal_alcanca_relogio(self);
   return self->saida;
 }
 
@@ -174,6 +417,10 @@ err_t terminal_leitura(void *disp, int id, int *pvalor)
     case 0: // leitura do teclado
       if (terminal_entrada_vazia(self)) return ERR_OCUP;
       *pvalor = terminal_le_char(self);
+      // abriu espaço para mais um caractere do arquivo de entrada
+      if (self->relogio != NULL) {
+        terminal_agenda_entrada(self, relogio_agora(self->relogio) + 1);
+      }
       break;
     case 1: // estado do teclado
       if (terminal_entrada_vazia(self)) {
@@ -216,3 +463,46 @@ err_t terminal_escrita(void *disp, int id, int valor)
   }
   return ERR_OK;
 }
+
+// salvamento e restauração em checkpoint
+// a saída é salva como está no instante do checkpoint; na restauração, o fim
+//   da rolagem ou limpeza e a chegada da entrada são reprogramados
+
+void terminal_salva(terminal_t *self, ckpt_t *ckpt)
+{
+  terminal_alcanca_relogio(self);
+  int estado = self->estado_saida;
+  ckpt_escreve(ckpt, &self->tam_linha, sizeof(self->tam_linha));
+  ckpt_escreve(ckpt, self->entrada, self->tam_linha + 1);
+  ckpt_escreve(ckpt, self->saida, self->tam_linha + 1);
+  ckpt_escreve(ckpt, self->linha_copia, self->tam_linha + 1);
+  ckpt_escreve(ckpt, &estado, sizeof(estado));
+  ckpt_escreve(ckpt, &self->pos_rolagem, sizeof(self->pos_rolagem));
+}
+
+bool terminal_restaura(terminal_t *self, ckpt_t *ckpt)
+{
+  int tam_linha, estado;
+  if (!ckpt_le(ckpt, &tam_linha, sizeof(tam_linha))
+      || tam_linha != self->tam_linha) {
+    return false;
+  }
+  ckpt_le(ckpt, self->entrada, self->tam_linha + 1);
+  ckpt_le(ckpt, self->saida, self->tam_linha + 1);
+  ckpt_le(ckpt, self->linha_copia, self->tam_linha + 1);
+  ckpt_le(ckpt, &estado, sizeof(estado));
+  ckpt_le(ckpt, &self->pos_rolagem, sizeof(self->pos_rolagem));
+  self->entrada[self->tam_linha] = '\0';
+  self->saida[self->tam_linha] = '\0';
+  self->linha_copia[self->tam_linha] = '\0';
+  self->estado_saida = estado;
+  if (estado < normal || estado > limpando) return false;
+  if (self->relogio != NULL) {
+    self->instante_saida = relogio_agora(self->relogio);
+    terminal_agenda_saida(self);
+    agenda_remove(relogio_agenda(self->relogio), terminal_chega_entrada, self);
+    self->entrada_agendada = false;
+    terminal_agenda_entrada(self, self->instante_saida + 1);
+  }
+  return true;
+}
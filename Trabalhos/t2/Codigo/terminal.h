@@ -24,7 +24,10 @@
 //   adicional causa a "rolagem", que remove o primeiro caractere da linha para
 //   gerar espaço para o novo. a impressão de um \n causa a "limpeza" da linha.
 // a escrita não é possível se a saída estiver rolando ou sendo limpa, o que é
-//   feito um caractere por vez (a cada chamada a tictac).
+//   feito um caractere por tic do relógio. o fim da rolagem ou limpeza é um
+//   evento na agenda do relógio (ver agenda.h), assim como a chegada de cada
+//   caractere do arquivo de entrada; o terminal não precisa ser chamado a
+//   cada instrução.
 //
 // a E/S efetiva é realizada pela console. ela obtém acesso às linhas de entrada e
 //   saída chamando terminal_txt_entrada ou terminal_txt_saida. a console insere
@@ -32,10 +35,15 @@
 //   linha de saída com terminal_limpa_saida.
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "es.h"
+#include "checkpoint.h"
 
 typedef struct terminal_t terminal_t;
 
+#include "gravacao.h"
+#include "relogio.h"
+
 // aloca e inicializa um novo terminal
 terminal_t *terminal_cria(int tam_linha);
 // libera a memória ocupada por um terminal
@@ -49,18 +57,60 @@ char *terminal_txt_saida(terminal_t *self);
 
 // insere um novo caractere na entrada do terminal
 // (para uso pela console, para simular um caractere digitado no teclado)
+// se o terminal estiver reproduzindo uma gravação, o caractere é ignorado
 void terminal_insere_char(terminal_t *self, char ch);
 
+// define a gravação onde são registrados os caracteres inseridos na entrada
+//   do terminal, ou de onde eles são reproduzidos (NULL para nenhuma), e a
+//   identificação do terminal na gravação ('A' a 'D')
+// na reprodução, a entrada digitada vem só da gravação, não da console (o
+//   arquivo de entrada não é gravado, é lido de novo)
+void terminal_define_gravacao(terminal_t *self, gravacao_t *gravacao, char id);
+
+// define o relógio que dá o tempo do terminal, em cuja agenda são colocados
+//   os eventos do terminal
+// deve ser chamada antes de o terminal ser usado pela CPU
+void terminal_define_relogio(terminal_t *self, relogio_t *relogio);
+
 // limpa a linha de saída (para uso pela console)
+// a limpeza é registrada na gravação, se houver; se o terminal estiver
+//   reproduzindo uma gravação, é ignorada (a limpeza vem da gravação)
 void terminal_limpa_saida(terminal_t *self);
 
-// esta função deve ser chamada periodicamente
+// esta função deve ser chamada a cada iteração do controlador
+// na reprodução de uma gravação, entrega a entrada e as limpezas gravadas
+//   para a iteração
+void terminal_atualiza(terminal_t *self);
+
+// como terminal_atualiza, e ainda passa um tic no terminal fora do relógio
+//   (avança a rolagem ou limpeza e lê um caractere do arquivo de entrada)
+// é usada quando o SO fica em espera ocupada, sem o relógio avançar
 void terminal_tictac(terminal_t *self);
 
+// define um arquivo para onde é copiado o que for impresso na saída do
+//   terminal, uma linha por vez, cada linha precedida por 'prefixo'
+//   (usado quando não tem tela); NULL para não copiar
+// o terminal não fecha o arquivo
+void terminal_define_copia_saida(terminal_t *self, FILE *arquivo, char *prefixo);
+
+// define um arquivo de onde vêm caracteres para a entrada do terminal, como se
+//   fossem digitados: um caractere a cada tic do relógio, se tiver espaço na
+//   entrada
+// um fim de linha no arquivo é inserido como espaço, como no comando de entrada
+//   de texto da console
+// o terminal não fecha o arquivo
+void terminal_define_arquivo_entrada(terminal_t *self, FILE *arquivo);
+
 // Funções para implementar o protocolo de acesso a um dispositivo pelo
 //   controlador de E/S
 // Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h
 err_t terminal_leitura(void *disp, int id, int *pvalor);
 err_t terminal_escrita(void *disp, int id, int valor);
 
+// salva e restaura o estado do terminal (o texto de entrada e de saída, e a
+//   linha incompleta da cópia da saída) em um checkpoint
+// terminal_restaura retorna false se não for possível
+void terminal_salva(terminal_t *self, ckpt_t *ckpt);
+bool terminal_restaura(terminal_t *self, ckpt_t *ckpt);
+
 #endif // TERMINAL_H
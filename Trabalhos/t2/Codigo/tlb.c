@@ -0,0 +1,234 @@
+// tlb.c
+// memória associativa de traduções da MMU (TLB)
+// simulador de computador
+// so24b
+
+#include "tlb.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// uma entrada da TLB
+typedef struct {
+  bool valida;
+  int asid;
+  int pagina;
+  int quadro;
+  // bits já marcados na tabela de páginas
+  bool acessada;
+  bool alterada;
+  // quando a entrada foi usada pela última vez e quando foi inserida (para
+  //   as políticas LRU e FIFO)
+  unsigned long uso;
+  unsigned long carga;
+} entrada_t;
+
+struct tlb_t {
+  int n_entradas;
+  int associatividade;
+  int n_conjuntos;
+  tlb_politica_t politica;
+  // as entradas do conjunto c estão em entradas[c * associatividade] em diante
+  entrada_t *entradas;
+  // relógio lógico, avança a cada uso ou inserção
+  unsigned long agora;
+  // estado do gerador de números da política aleatória
+  unsigned int semente;
+  tlb_estatisticas_t estat;
+};
+
+tlb_t *tlb_cria(int entradas, int associatividade, tlb_politica_t politica)
+{
+  assert(entradas > 0 && associatividade > 0);
+  assert(entradas % associatividade == 0);
+  assert(politica >= 0 && politica < N_TLB_POLITICA);
+  tlb_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->n_entradas = entradas;
+  self->associatividade = associatividade;
+  self->n_conjuntos = entradas / associatividade;
+  self->politica = politica;
+  self->entradas = malloc(entradas * sizeof(entrada_t));
+  assert(self->entradas != NULL);
+  memset(self->entradas, 0, entradas * sizeof(entrada_t));
+  self->agora = 0;
+  self->semente = 1;
+  memset(&self->estat, 0, sizeof(self->estat));
+  return self;
+}
+
+void tlb_destroi(tlb_t *self)
+{
+  free(self->entradas);
+  free(self);
+}
+
+// ENTRADAS {{{1
+
+// retorna a primeira entrada do conjunto onde a página pode estar
+static entrada_t *tlb__conjunto(tlb_t *self, int pagina)
+{
+  return &self->entradas[(pagina % self->n_conjuntos) * self->associatividade];
+}
+
+// retorna a entrada que contém a página do espaço 'asid', ou NULL
+static entrada_t *tlb__busca(tlb_t *self, int asid, int pagina)
+{
+  if (pagina < 0) return NULL;
+  entrada_t *conjunto = tlb__conjunto(self, pagina);
+  for (int i = 0; i < self->associatividade; i++) {
+    entrada_t *e = &conjunto[i];
+    if (e->valida && e->pagina == pagina && e->asid == asid) return e;
+  }
+  return NULL;
+}
+
+// gera um número pseudo-aleatório (xorshift), sempre na mesma sequência
+static unsigned int tlb__aleatorio(tlb_t *self)
+{
+  unsigned int x = self->semente;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  self->semente = x;
+  return x;
+}
+
+// escolhe a entrada do conjunto que vai receber uma nova tradução
+static entrada_t *tlb__vitima(tlb_t *self, entrada_t *conjunto)
+{
+  for (int i = 0; i < self->associatividade; i++) {
+    if (!conjunto[i].valida) return &conjunto[i];
+  }
+  if (self->politica == TLB_ALEATORIA) {
+    return &conjunto[tlb__aleatorio(self) % self->associatividade];
+  }
+  entrada_t *vitima = &conjunto[0];
+  for (int i = 1; i < self->associatividade; i++) {
+    entrada_t *e = &conjunto[i];
+    if (self->politica == TLB_LRU ? e->uso < vitima->uso
+                                  : e->carga < vitima->carga) {
+      vitima = e;
+    }
+  }
+  return vitima;
+}
+
+// OPERAÇÕES {{{1
+
+bool tlb_traduz(tlb_t *self, int asid, int pagina, int *pquadro)
+{
+  entrada_t *entrada = tlb__busca(self, asid, pagina);
+  if (entrada == NULL) {
+    self->estat.faltas++;
+    return false;
+  }
+  self->estat.acertos++;
+  entrada->uso = ++self->agora;
+  *pquadro = entrada->quadro;
+  return true;
+}
+
+void tlb_insere(tlb_t *self, int asid, int pagina, int quadro)
+{
+  if (pagina < 0) return;
+  entrada_t *entrada = tlb__busca(self, asid, pagina);
+  if (entrada == NULL) {
+    entrada = tlb__vitima(self, tlb__conjunto(self, pagina));
+  }
+  entrada->valida = true;
+  entrada->asid = asid;
+  entrada->pagina = pagina;
+  entrada->quadro = quadro;
+  entrada->acessada = false;
+  entrada->alterada = false;
+  entrada->uso = entrada->carga = ++self->agora;
+}
+
+bool tlb_marca_bit_acesso(tlb_t *self, int asid, int pagina, bool alteracao)
+{
+  entrada_t *entrada = tlb__busca(self, asid, pagina);
+  if (entrada == NULL) return true;
+  if (entrada->acessada && (entrada->alterada || !alteracao)) return false;
+  entrada->acessada = true;
+  if (alteracao) entrada->alterada = true;
+  return true;
+}
+
+void tlb_invalida_pagina(tlb_t *self, int asid, int pagina)
+{
+  entrada_t *entrada = tlb__busca(self, asid, pagina);
+  if (entrada != NULL) entrada->valida = false;
+}
+
+void tlb_invalida_asid(tlb_t *self, int asid)
+{
+  for (int i = 0; i < self->n_entradas; i++) {
+    if (self->entradas[i].asid == asid) self->entradas[i].valida = false;
+  }
+}
+
+void tlb_esvazia(tlb_t *self)
+{
+  for (int i = 0; i < self->n_entradas; i++) {
+    self->entradas[i].valida = false;
+  }
+  self->estat.esvaziamentos++;
+}
+
+tlb_estatisticas_t tlb_estatisticas(tlb_t *self)
+{
+  return self->estat;
+}
+
+tlb_politica_t tlb_politica_do_nome(char *nome)
+{
+  static char *nomes[N_TLB_POLITICA] = {
+    [TLB_LRU]       = "lru",
+    [TLB_FIFO]      = "fifo",
+    [TLB_ALEATORIA] = "aleatoria",
+  };
+  for (tlb_politica_t politica = 0; politica < N_TLB_POLITICA; politica++) {
+    if (strcmp(nome, nomes[politica]) == 0) return politica;
+  }
+  return -1;
+}
+
+// CHECKPOINT {{{1
+
+void tlb_salva(tlb_t *self, ckpt_t *ckpt)
+{
+  int politica = self->politica;
+  ckpt_escreve(ckpt, &self->n_entradas, sizeof(self->n_entradas));
+  ckpt_escreve(ckpt, &self->associatividade, sizeof(self->associatividade));
+  ckpt_escreve(ckpt, &politica, sizeof(politica));
+  ckpt_escreve(ckpt, self->entradas, self->n_entradas * sizeof(entrada_t));
+  ckpt_escreve(ckpt, &self->agora, sizeof(self->agora));
+  ckpt_escreve(ckpt, &self->semente, sizeof(self->semente));
+  ckpt_escreve(ckpt, &self->estat, sizeof(self->estat));
+}
+
+tlb_t *tlb_restaura(ckpt_t *ckpt)
+{
+  int entradas, associatividade, politica;
+  ckpt_le(ckpt, &entradas, sizeof(entradas));
+  ckpt_le(ckpt, &associatividade, sizeof(associatividade));
+  if (!ckpt_le(ckpt, &politica, sizeof(politica))
+      || entradas <= 0 || associatividade <= 0
+      || entradas % associatividade != 0
+      || politica < 0 || politica >= N_TLB_POLITICA) {
+    return NULL;
+  }
+  tlb_t *self = tlb_cria(entradas, associatividade, politica);
+  ckpt_le(ckpt, self->entradas, entradas * sizeof(entrada_t));
+  ckpt_le(ckpt, &self->agora, sizeof(self->agora));
+  ckpt_le(ckpt, &self->semente, sizeof(self->semente));
+  if (!ckpt_le(ckpt, &self->estat, sizeof(self->estat))) {
+    tlb_destroi(self);
+    return NULL;
+  }
+  return self;
+}
+
+// vim: foldmethod=marker
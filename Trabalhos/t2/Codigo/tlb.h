@@ -0,0 +1,92 @@
+// tlb.h
+// memória associativa de traduções da MMU (TLB)
+// simulador de computador
+// so24b
+
+#ifndef TLB_H
+#define TLB_H
+
+// simulação de uma TLB ("translation lookaside buffer")
+// guarda as traduções de página para quadro usadas mais recentemente, para
+//   que a MMU não precise consultar a tabela de páginas a cada acesso
+// as entradas são organizadas em conjuntos de 'associatividade' entradas; a
+//   página p só pode estar no conjunto p % (entradas / associatividade)
+//   (com associatividade igual ao número de entradas, é totalmente
+//   associativa; com associatividade 1, tem mapeamento direto)
+// cada entrada é marcada com o identificador do espaço de endereçamento
+//   (ASID) a que pertence, e só é usada em traduções desse ASID; assim, a
+//   TLB pode ter ao mesmo tempo traduções de vários processos, e não precisa
+//   ser esvaziada a cada troca de processo
+// cada entrada lembra se os bits de acesso e alteração da página já foram
+//   marcados na tabela de páginas, para que só o primeiro acesso (e a
+//   primeira alteração) depois da carga da entrada precise ir à tabela
+// a TLB não percebe alterações na tabela de páginas; quem altera a tabela
+//   (inclusive zerando o bit de acesso) deve invalidar as entradas afetadas
+
+#include "checkpoint.h"
+
+#include <stdbool.h>
+
+typedef struct tlb_t tlb_t;
+
+// política de escolha da entrada a substituir, quando o conjunto está cheio
+typedef enum {
+  TLB_LRU,        // a usada há mais tempo
+  TLB_FIFO,       // a que está há mais tempo na TLB
+  TLB_ALEATORIA,  // uma qualquer (a sequência é sempre a mesma)
+  N_TLB_POLITICA
+} tlb_politica_t;
+
+// contadores de uso da TLB
+typedef struct {
+  long acertos;        // traduções encontradas na TLB
+  long faltas;         // traduções que não estavam na TLB
+  long esvaziamentos;  // vezes que a TLB foi esvaziada
+} tlb_estatisticas_t;
+
+// cria uma TLB vazia com 'entradas' entradas, em conjuntos de
+//   'associatividade' entradas (que deve dividir 'entradas')
+// mata o programa em caso de erro (malloc)
+tlb_t *tlb_cria(int entradas, int associatividade, tlb_politica_t politica);
+
+// destrói a TLB
+void tlb_destroi(tlb_t *self);
+
+// procura a tradução da página 'pagina' do espaço 'asid'; se encontrar,
+//   coloca o quadro em '*pquadro' e retorna true
+// conta um acerto ou uma falta
+bool tlb_traduz(tlb_t *self, int asid, int pagina, int *pquadro);
+
+// insere a tradução de 'pagina' do espaço 'asid' para 'quadro', sem bits
+//   marcados
+void tlb_insere(tlb_t *self, int asid, int pagina, int quadro);
+
+// registra na entrada da página o acesso (e a alteração, se 'alteracao' for
+//   true)
+// retorna true se o acesso também deve ser marcado na tabela de páginas (a
+//   página não está na TLB, ou o bit ainda não tinha sido marcado)
+bool tlb_marca_bit_acesso(tlb_t *self, int asid, int pagina, bool alteracao);
+
+// retira da TLB a página 'pagina' do espaço 'asid'
+void tlb_invalida_pagina(tlb_t *self, int asid, int pagina);
+
+// retira da TLB todas as páginas do espaço 'asid'
+void tlb_invalida_asid(tlb_t *self, int asid);
+
+// retira todas as entradas da TLB
+// conta um esvaziamento
+void tlb_esvazia(tlb_t *self);
+
+// retorna os contadores de uso da TLB
+tlb_estatisticas_t tlb_estatisticas(tlb_t *self);
+
+// retorna a política do nome ("lru", "fifo" ou "aleatoria"), ou -1
+tlb_politica_t tlb_politica_do_nome(char *nome);
+
+// salva o conteúdo (configuração, entradas e contadores) da TLB em um
+//   checkpoint, ou cria uma TLB com o conteúdo salvo (NULL se não for
+//   possível)
+void tlb_salva(tlb_t *self, ckpt_t *ckpt);
+tlb_t *tlb_restaura(ckpt_t *ckpt);
+
+#endif // TLB_H
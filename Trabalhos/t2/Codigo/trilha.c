@@ -0,0 +1,153 @@
+// trilha.c
+// trilha das instruções executadas, em formato binário
+// simulador de computador
+// so24b
+
+#include "trilha.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <assert.h>
+
+// tempo que a gravadora dorme quando o anel está vazio, em µs
+#define ESPERA_VAZIO 2000
+// tempo que trilha_registra dorme esperando espaço no anel cheio, em µs
+#define ESPERA_CHEIO 100
+
+struct trilha_t {
+  FILE *arquivo;
+  bool continua;
+  // anel de registros
+  // 'gravados' e 'fim' só crescem; a posição no anel é o resto da divisão por
+  //   'tam' (potência de 2). 'fim' só é alterado por quem registra, 'gravados'
+  //   por quem grava (a thread gravadora, na gravação contínua)
+  int tam;
+  trilha_reg_t *anel;
+  atomic_uint_fast64_t gravados;
+  atomic_uint_fast64_t fim;
+  atomic_bool terminar;
+  pthread_t gravadora;
+};
+
+static void *trilha_gravadora(void *arg);
+
+static void dorme(int us)
+{
+  struct timespec ts = { .tv_sec = 0, .tv_nsec = us * 1000L };
+  nanosleep(&ts, NULL);
+}
+
+static void grava_cabecalho(FILE *arquivo)
+{
+  char assinatura[8];
+  memcpy(assinatura, TRILHA_ASSINATURA, 8);
+  uint64_t versao = TRILHA_VERSAO;
+  uint64_t tam_reg = sizeof(trilha_reg_t);
+  fwrite(assinatura, 1, sizeof(assinatura), arquivo);
+  fwrite(&versao, sizeof(versao), 1, arquivo);
+  fwrite(&tam_reg, sizeof(tam_reg), 1, arquivo);
+}
+
+trilha_t *trilha_cria(char *nome, int tam, bool continua)
+{
+  FILE *arquivo = fopen(nome, "wb");
+  if (arquivo == NULL) return NULL;
+  grava_cabecalho(arquivo);
+
+  trilha_t *self = malloc(sizeof(*self));
+  assert(self != NULL);
+  self->arquivo = arquivo;
+  self->continua = continua;
+  self->tam = 1;
+  while (self->tam < tam) self->tam *= 2;
+  self->anel = malloc(self->tam * sizeof(trilha_reg_t));
+  assert(self->anel != NULL);
+  atomic_init(&self->gravados, 0);
+  atomic_init(&self->fim, 0);
+  atomic_init(&self->terminar, false);
+  if (continua) {
+    int r = pthread_create(&self->gravadora, NULL, trilha_gravadora, self);
+    assert(r == 0);
+  }
+  return self;
+}
+
+void trilha_destroi(trilha_t *self)
+{
+  if (self->continua) {
+    atomic_store(&self->terminar, true);
+    pthread_join(self->gravadora, NULL);
+  }
+  fclose(self->arquivo);
+  free(self->anel);
+  free(self);
+}
+
+// grava os registros de 'inicio' até antes de 'fim', em no máximo dois pedaços
+static void grava_registros(trilha_t *self, uint64_t inicio, uint64_t fim)
+{
+  size_t p = inicio % self->tam;
+  size_t n = fim - inicio;
+  size_t n1 = n < self->tam - p ? n : self->tam - p;
+  fwrite(&self->anel[p], sizeof(trilha_reg_t), n1, self->arquivo);
+  fwrite(&self->anel[0], sizeof(trilha_reg_t), n - n1, self->arquivo);
+}
+
+// REGISTRO {{{1
+
+void trilha_registra(trilha_t *self, trilha_reg_t *reg)
+{
+  uint64_t fim = atomic_load_explicit(&self->fim, memory_order_relaxed);
+  if (self->continua) {
+    while (fim - atomic_load_explicit(&self->gravados, memory_order_acquire)
+           >= self->tam) {
+      // anel cheio, espera a gravadora
+      dorme(ESPERA_CHEIO);
+    }
+  }
+  // sob demanda, o registro mais antigo é sobrescrito
+  reg->num = fim;
+  self->anel[fim % self->tam] = *reg;
+  atomic_store_explicit(&self->fim, fim + 1, memory_order_release);
+}
+
+void trilha_grava(trilha_t *self)
+{
+  if (self->continua) return;
+  uint64_t fim = atomic_load(&self->fim);
+  uint64_t inicio = atomic_load(&self->gravados);
+  // os registros anteriores aos últimos 'tam' já foram sobrescritos
+  if (fim - inicio > self->tam) inicio = fim - self->tam;
+  grava_registros(self, inicio, fim);
+  fflush(self->arquivo);
+  atomic_store(&self->gravados, fim);
+}
+
+// GRAVAÇÃO CONTÍNUA {{{1
+
+static void *trilha_gravadora(void *arg)
+{
+  trilha_t *self = arg;
+  for (;;) {
+    // lê 'terminar' antes de 'fim', para não perder o que foi registrado
+    //   antes do pedido de término
+    bool terminar = atomic_load(&self->terminar);
+    uint64_t inicio = atomic_load_explicit(&self->gravados, memory_order_relaxed);
+    uint64_t fim = atomic_load_explicit(&self->fim, memory_order_acquire);
+    if (inicio == fim) {
+      if (terminar) break;
+      fflush(self->arquivo);
+      dorme(ESPERA_VAZIO);
+      continue;
+    }
+    grava_registros(self, inicio, fim);
+    atomic_store_explicit(&self->gravados, fim, memory_order_release);
+  }
+  return NULL;
+}
+
+// vim: foldmethod=marker
@@ -0,0 +1,61 @@
+// trilha.h
+// trilha das instruções executadas, em formato binário
+// simulador de computador
+// so24b
+
+#ifndef TRILHA_H
+#define TRILHA_H
+
+// A trilha guarda um registro de tamanho fixo para cada instrução executada
+//   pela CPU, em um anel na memória com espaço para os últimos registros.
+// O anel é gravado em um arquivo binário de duas formas:
+// - sob demanda: os registros do anel que ainda não foram gravados só vão para
+//   o arquivo quando for pedido (trilha_grava), como quando a CPU entra em
+//   erro ou o operador pede; os mais antigos podem ter sido perdidos
+// - contínua: uma thread grava o anel no arquivo enquanto ele é preenchido; se
+//   o anel encher, a CPU espera, nenhum registro é perdido
+// O arquivo tem um cabeçalho (TRILHA_ASSINATURA, a versão e o tamanho de um
+//   registro, cada um em 8 bytes), seguido dos registros. O programa
+//   'letrilha' mostra o conteúdo do arquivo.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct trilha_t trilha_t;
+
+#define TRILHA_ASSINATURA "so24btrl"
+#define TRILHA_VERSAO     1
+
+// o registro de uma instrução
+// 'PC', 'opcode' e 'A1' identificam a instrução (opcode é -1 se não foi
+//   possível ler, A1 é 0 se a instrução não tem argumento); 'A', 'X' e 'erro'
+//   são os valores depois da execução; 'modo' é o modo em que ela foi executada
+typedef struct {
+  uint64_t num;      // número de ordem da instrução na trilha
+  int32_t PC;
+  int32_t opcode;
+  int32_t A1;
+  int32_t A;
+  int32_t X;
+  int8_t modo;
+  int8_t erro;
+  int16_t reservado;
+} trilha_reg_t;
+
+// cria uma trilha que grava no arquivo 'nome', com um anel de pelo menos
+//   'tam' registros (arredondado para potência de 2)
+// se 'continua', grava continuamente, senão só sob demanda
+// retorna NULL se não conseguir criar o arquivo
+trilha_t *trilha_cria(char *nome, int tam, bool continua);
+
+// destrói a trilha; na gravação contínua, grava antes o que falta
+void trilha_destroi(trilha_t *self);
+
+// acrescenta o registro de uma instrução (o campo 'num' é preenchido aqui)
+void trilha_registra(trilha_t *self, trilha_reg_t *reg);
+
+// grava no arquivo os registros do anel que ainda não foram gravados
+// na gravação contínua, não faz nada (a thread já está gravando)
+void trilha_grava(trilha_t *self);
+
+#endif // TRILHA_H